@@ -1,4 +1,50 @@
-importScripts('apriltag_wasm.js');
+/**
+ * Check if the browser supports WASM SIMD; validates a tiny module with a 128-bit SIMD instruction
+ * (same check as https://github.com/GoogleChromeLabs/wasm-feature-detect)
+ */
+function wasmSimdSupported() {
+    try {
+        return WebAssembly.validate(new Uint8Array([0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11]));
+    } catch (err) {
+        return false;
+    }
+}
+
+/**
+ * Check if we can run the pthreads build; needs SharedArrayBuffer, which browsers only enable in cross-origin isolated pages
+ * (served with Cross-Origin-Opener-Policy: same-origin and Cross-Origin-Embedder-Policy: require-corp)
+ */
+function wasmThreadsSupported() {
+    return typeof SharedArrayBuffer !== 'undefined' && self.crossOriginIsolated !== false;
+}
+
+// the fixed-heap build (heap preallocated, never grows) is loaded when the worker is created as apriltag.js?fixed
+const apriltagWasmFixedHeap = new URLSearchParams(self.location.search).has('fixed');
+
+// load the best detector build supported (and available): fixed heap (if requested; SIMD or scalar), pthreads (+SIMD),
+// SIMD, or scalar. When a fixed heap is requested, only the fixed-heap builds are loaded
+var apriltagWasmBuild = 'scalar';
+const apriltagWasmBuilds = [
+    { name: 'fixed heap', file: 'apriltag_wasm_fixed.js', supported: () => apriltagWasmFixedHeap && wasmSimdSupported() },
+    { name: 'fixed heap scalar', file: 'apriltag_wasm_fixed_scalar.js', supported: () => apriltagWasmFixedHeap },
+    { name: 'threads', file: 'apriltag_wasm_mt.js', supported: () => !apriltagWasmFixedHeap && wasmSimdSupported() && wasmThreadsSupported() },
+    { name: 'SIMD', file: 'apriltag_wasm_simd.js', supported: () => !apriltagWasmFixedHeap && wasmSimdSupported() }
+];
+for (const build of apriltagWasmBuilds) {
+    if (!build.supported()) continue;
+    try {
+        importScripts(build.file);
+        apriltagWasmBuild = build.name;
+        break;
+    } catch (err) {
+        console.log("Apriltag WASM " + build.name + " build not available.");
+    }
+}
+if (apriltagWasmBuild == 'scalar') {
+    // a growable heap would break what apriltag.js?fixed promises (views over the WASM memory staying valid)
+    if (apriltagWasmFixedHeap) throw new Error("Apriltag WASM fixed heap build not available (apriltag_wasm_fixed.js, apriltag_wasm_fixed_scalar.js).");
+    importScripts('apriltag_wasm.js');
+}
 importScripts("https://unpkg.com/comlink/dist/umd/comlink.js");
 
 /**
@@ -25,7 +71,7 @@ class Apriltag {
           quad_decimate: 2.0,
           // What Gaussian blur should be applied to the segmented image; standard deviation in pixels
           quad_sigma: 0.0,
-           // Use this many CPU threads (no effect)
+          // Use this many CPU threads (only with the threads build; limited to max_threads())
           nthreads: 1,
           // Spend more time trying to align edges of tags
           refine_edges: 1,
@@ -34,12 +80,14 @@ class Apriltag {
           // Return pose (requires camera parameters)
           return_pose: 1,
           // Return pose solutions details
-          return_solutions: 1
+          return_solutions: 1,
+          // Read detections from binary records instead of parsing a json string
+          binary_output: 0
         }
 
         let _this = this;
         AprilTagWasm().then(function (Module) {
-            console.log("Apriltag WASM module loaded.");
+            console.log("Apriltag WASM module loaded (" + apriltagWasmBuild + " build).");
             _this.onWasmInit(Module);
         });
     }
@@ -57,15 +105,59 @@ class Apriltag {
         this._destroy = Module.cwrap('atagjs_destroy', 'number', []);
         //int atagjs_set_detector_options(float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions); Sets the given detector options
         this._set_detector_options = Module.cwrap('atagjs_set_detector_options', 'number', ['number', 'number', 'number', 'number', 'number', 'number', 'number']);
+        //int atagjs_max_threads(); Maximum number of detector threads of the loaded build (1 unless the threads build is loaded)
+        this._max_threads = Module.cwrap('atagjs_max_threads', 'number', []);
         //int atagjs_set_pose_info(double fx, double fy, double cx, double cy); Sets the tag size (meters) and camera intrinsics (in pixels) for tag pose estimation
         this._set_pose_info = Module.cwrap('atagjs_set_pose_info', 'number', ['number', 'number', 'number', 'number']);
         //uint8_t* atagjs_set_img_buffer(int width, int height, int stride); Creates/changes size of the image buffer where we receive the images to process
         this._set_img_buffer = Module.cwrap('atagjs_set_img_buffer', 'number', ['number', 'number', 'number']);
+        //uint8_t* atagjs_set_rgba_buffer(int width, int height, int stride); Creates/changes size of the RGBA image buffer (converted to grayscale by the detector)
+        this._set_rgba_buffer = Module.cwrap('atagjs_set_rgba_buffer', 'number', ['number', 'number', 'number']);
+        //int atagjs_reserve(int width, int height); Preallocate the input buffers for frames up to this size, and grow the heap for the detector intermediates
+        this._reserve = Module.cwrap('atagjs_reserve', 'number', ['number', 'number']);
         //void *atagjs_set_tag_size(int tagid, double size)
         this._atagjs_set_tag_size = Module.cwrap('atagjs_set_tag_size', null, ['number', 'number']);
+        //int atagjs_set_family_tag_size(int family, int tagid, double size); Set the size of a known tag of a family
+        this._set_family_tag_size = Module.cwrap('atagjs_set_family_tag_size', 'number', ['number', 'number', 'number']);
+        //int atagjs_set_families(int families, int bits_corrected); Set the tag families to detect (ATAGJS_FAMILY_* bits)
+        this._set_families = Module.cwrap('atagjs_set_families', 'number', ['number', 'number']);
         //t_str_json* atagjs_detect(); Detect tags in image previously stored in the buffer.
         //returns pointer to buffer starting with an int32 indicating the size of the remaining buffer (a string of chars with the json describing the detections)
         this._detect = Module.cwrap('atagjs_detect', 'number', []);
+        //t_atagjs_det_bin* atagjs_detect_bin(); Detect tags in image previously stored in the buffer.
+        //returns pointer to a header (version, len, record_size, flags, *records) of fixed-layout detection records
+        this._detect_bin = Module.cwrap('atagjs_detect_bin', 'number', []);
+        //uint8_t* atagjs_set_batch_buffer(int nframes); Creates/changes size of the buffer where we receive a batch of frames (of the image buffer size)
+        this._set_batch_buffer = Module.cwrap('atagjs_set_batch_buffer', 'number', ['number']);
+        //t_atagjs_det_batch* atagjs_detect_batch(const uint8_t *frames, int nframes); Detect tags in a batch of frames.
+        //returns pointer to a header (version, nframes, record_size, len, *offsets, *records) of the fixed-layout detection records of all frames
+        this._detect_batch = Module.cwrap('atagjs_detect_batch', 'number', ['number', 'number']);
+        //int atagjs_ring_acquire(int width, int height, int stride, int rgba); Acquire a frame ring slot; returns the slot (-1 if none is free)
+        this._ring_acquire = Module.cwrap('atagjs_ring_acquire', 'number', ['number', 'number', 'number', 'number']);
+        //uint8_t* atagjs_ring_buffer(int slot); Buffer of an acquired frame ring slot
+        this._ring_buffer = Module.cwrap('atagjs_ring_buffer', 'number', ['number']);
+        //int atagjs_ring_commit(int slot); Mark a frame ring slot as filled
+        this._ring_commit = Module.cwrap('atagjs_ring_commit', 'number', ['number']);
+        //t_atagjs_det_bin* atagjs_ring_detect(int slot); Detect tags in a committed frame ring slot (binary records) and release it
+        this._ring_detect = Module.cwrap('atagjs_ring_detect', 'number', ['number']);
+        //int atagjs_ring_release(int slot); Release a frame ring slot without detecting
+        this._ring_release = Module.cwrap('atagjs_ring_release', 'number', ['number']);
+        //int atagjs_set_tracking(int enable, int keyframe_interval, float roi_padding); Enable/disable tracking mode
+        this._set_tracking = Module.cwrap('atagjs_set_tracking', 'number', ['number', 'number', 'number']);
+        //int atagjs_set_fused_input(int enable); Enable/disable fused conversion and decimation of the RGBA input
+        this._set_fused_input = Module.cwrap('atagjs_set_fused_input', 'number', ['number']);
+        //int atagjs_set_auto_decimate(double target_ms, float min_decimate, float max_decimate, int adapt_refine); Adapt decimation to a frame time budget
+        this._set_auto_decimate = Module.cwrap('atagjs_set_auto_decimate', 'number', ['number', 'number', 'number', 'number']);
+        //int atagjs_set_deadline(double deadline_ms); Time budget of each detect call (partial results once it expires)
+        this._set_deadline = Module.cwrap('atagjs_set_deadline', 'number', ['number']);
+        //int atagjs_set_heap_budget(int max_width, int max_height, int max_tags); Largest frame and most tags; preallocates for them and refuses frames that do not fit the heap
+        this._set_heap_budget = Module.cwrap('atagjs_set_heap_budget', 'number', ['number', 'number', 'number']);
+        //int atagjs_set_motion_gate(int enable, int threshold, int refresh_interval); Reuse the results of the last frame detected while the scene is static
+        this._set_motion_gate = Module.cwrap('atagjs_set_motion_gate', 'number', ['number', 'number', 'number']);
+        //int atagjs_set_frame_stats(int enable); Enable/disable the detector stage breakdown and pipeline counters in the frame stats
+        this._set_frame_stats = Module.cwrap('atagjs_set_frame_stats', 'number', ['number']);
+        //t_atagjs_frame_stats* atagjs_get_frame_stats(); Timing and counters of the last frame processed
+        this._get_frame_stats = Module.cwrap('atagjs_get_frame_stats', 'number', []);
 
         // inits detector
         this._init();
@@ -97,6 +189,32 @@ class Apriltag {
         let imgBuffer = this._set_img_buffer(imgWidth, imgHeight, imgWidth);
         if (imgWidth * imgHeight < grayscaleImg.length) return { result: "Image data too large." };
         this._Module.HEAPU8.set(grayscaleImg, imgBuffer); // copy grayscale image data
+        return this._detectBuffer();
+    }
+
+      /**
+       * **public** detect method for color images; pass canvas pixels (ImageData.data) as they are, the detector
+       * converts them to grayscale
+       * @param {Uint8ClampedArray} rgbaImg RGBA image buffer (4 bytes per pixel)
+       * @param {Number} imgWidth image with
+       * @param {Number} imgHeight image height
+       * @return {detection} detection object
+       */
+    detect_rgba(rgbaImg, imgWidth, imgHeight) {
+        // set_rgba_buffer allocates the buffer for image and returns it; just returns the previously allocated buffer if size has not changed
+        let imgBuffer = this._set_rgba_buffer(imgWidth, imgHeight, imgWidth);
+        if (imgBuffer == 0) return { result: "Could not allocate image buffer." };
+        if (imgWidth * imgHeight * 4 < rgbaImg.length) return { result: "Image data too large." };
+        this._Module.HEAPU8.set(rgbaImg, imgBuffer); // copy RGBA image data
+        return this._detectBuffer();
+    }
+
+    /**
+     * Detect tags in the image previously copied to the detector buffer
+     * @return {detection} detection object
+     */
+    _detectBuffer() {
+        if (this._opt.binary_output) return this._detectBin();
         let strJsonPtr = this._detect();
         /* detect returns a pointer to a t_str_json c struct as follows
             size_t len; // string length
@@ -114,10 +232,319 @@ class Apriltag {
         }
         //console.log(detectionsJson);
         let detections = JSON.parse(detectionsJson);
+        if (!Array.isArray(detections)) return detections; // error result
 
+        // the frame flags are in the frame stats (the json is an array of detections)
+        const statsPtr = this._get_frame_stats();
+        const c = new Int32Array(this._Module.HEAP8.buffer, statsPtr + 17 * 8, 15);
+        return this._setFrameFlags(detections, (c[10] ? Apriltag.DET_BIN_TRUNCATED : 0) | (c[13] ? Apriltag.DET_BIN_REUSED : 0));
+    }
+
+    /**
+     * Set the flags of the frame on its detection array: *reused* (the frame was unchanged and the detections are those
+     * of the last frame detected; see set_motion_gate()) and *truncated* (the deadline expired before the frame was done;
+     * see set_deadline()). They are properties of the array, which stays an array of detections; postMessage keeps them
+     * @param {Array} detections detection objects of the frame
+     * @param {Number} flags ATAGJS_DET_BIN_* flags of the frame
+     * @return {detection} the detections
+     */
+    _setFrameFlags(detections, flags) {
+        detections.reused = (flags & Apriltag.DET_BIN_REUSED) != 0;
+        detections.truncated = (flags & Apriltag.DET_BIN_TRUNCATED) != 0;
         return detections;
     }
 
+    /**
+     * Detect using the binary output and build detection objects (same as the json output) directly from the records
+     * @return {detection} detection object
+     */
+    _detectBin() {
+        let binPtr = this._detect_bin();
+        if (binPtr == 0) return { result: "Detector error." };
+        /* detect_bin returns a pointer to a t_atagjs_det_bin c struct as follows
+            int32_t version;
+            int32_t len; // number of records
+            int32_t record_size; // bytes
+            int32_t flags;
+            t_atagjs_det_record *records; */
+        const header = new Int32Array(this._Module.HEAP8.buffer, binPtr, 5);
+        if (header[0] != Apriltag.DET_BIN_VERSION) return { result: "Unexpected binary output version." };
+        return this._setFrameFlags(this._readRecords(header[4], header[1], header[2]), header[3]);
+    }
+
+    /**
+     * **public** detect tags in a batch of grayscale frames of the same size (e.g. a recorded session) with a single call
+     * into the detector; with the threads build, set_nthreads(n) processes n frames in parallel
+     * @param {Uint8Array} grayscaleFrames the frames, one after the other (imgWidth*imgHeight bytes each)
+     * @param {Number} nframes number of frames
+     * @param {Number} imgWidth image with
+     * @param {Number} imgHeight image height
+     * @return {Array} detections of each frame (detection objects, as returned by detect())
+     */
+    detect_batch(grayscaleFrames, nframes, imgWidth, imgHeight) {
+        if (imgWidth * imgHeight * nframes < grayscaleFrames.length) return { result: "Image data too large." };
+        this._set_img_buffer(imgWidth, imgHeight, imgWidth); // sets the frame size
+        let batchBuffer = this._set_batch_buffer(nframes);
+        if (batchBuffer == 0) return { result: "Could not allocate batch buffer." };
+        this._Module.HEAPU8.set(grayscaleFrames, batchBuffer); // copy all frames
+        let batchPtr = this._detect_batch(batchBuffer, nframes);
+        if (batchPtr == 0) return { result: "Detector error." };
+        /* detect_batch returns a pointer to a t_atagjs_det_batch c struct as follows
+            int32_t version;
+            int32_t nframes;
+            int32_t record_size; // bytes
+            int32_t len; // number of records (all frames)
+            int32_t *offsets; // nframes+1 offsets of the records of each frame
+            t_atagjs_det_record *records; */
+        const header = new Int32Array(this._Module.HEAP8.buffer, batchPtr, 6);
+        if (header[0] != Apriltag.DET_BIN_VERSION) return { result: "Unexpected binary output version." };
+        const recordSize = header[2];
+        const offsets = new Int32Array(this._Module.HEAP8.buffer, header[4], header[1] + 1);
+        let frames = [];
+        for (let f = 0; f < header[1]; f++) {
+            frames.push(this._readRecords(header[5] + offsets[f] * recordSize, offsets[f + 1] - offsets[f], recordSize));
+        }
+        return frames;
+    }
+
+    /**
+     * Build detection objects (same as the json output) from fixed-layout binary records
+     * @param {Number} recordsPtr pointer to the first record
+     * @param {Number} len number of records
+     * @param {Number} recordSize size of each record, in bytes
+     * @return {detection} detection object
+     */
+    _readRecords(recordsPtr, len, recordSize) {
+        if (len == 0) return [];
+        // views over the records; no copy
+        const ints = new Int32Array(this._Module.HEAP8.buffer, recordsPtr, len * recordSize / 4);
+        const doubles = new Float64Array(this._Module.HEAP8.buffer, recordsPtr, len * recordSize / 8);
+        const r3 = (d, o) => [[d[o], d[o+1], d[o+2]], [d[o+3], d[o+4], d[o+5]], [d[o+6], d[o+7], d[o+8]]]; // column major R
+        let detections = [];
+        for (let i = 0; i < len; i++) {
+            const ri = i * recordSize / 4; // int32 offset of the record
+            const rd = i * recordSize / 8 + 3; // float64 offset of the record (after the six int32 fields)
+            const flags = ints[ri + 2];
+            let det = {
+                id: ints[ri],
+                family: Apriltag.FAMILY_NAMES[31 - Math.clz32(ints[ri + 4])],
+                hamming: ints[ri + 1],
+                decision_margin: doubles[rd],
+                corners: [
+                    { x: doubles[rd + 1], y: doubles[rd + 2] },
+                    { x: doubles[rd + 3], y: doubles[rd + 4] },
+                    { x: doubles[rd + 5], y: doubles[rd + 6] },
+                    { x: doubles[rd + 7], y: doubles[rd + 8] }],
+                center: { x: doubles[rd + 9], y: doubles[rd + 10] }
+            };
+            if (flags & Apriltag.DET_REC_POSE) {
+                det.pose = {
+                    size: doubles[rd + 11],
+                    R: r3(doubles, rd + 12),
+                    t: [doubles[rd + 21], doubles[rd + 22], doubles[rd + 23]],
+                    e: doubles[rd + 24],
+                    method: (ints[ri + 3] == Apriltag.POSE_FAST) ? "fast" : "full"
+                };
+                if (flags & Apriltag.DET_REC_ASOL) {
+                    det.pose.asol = {
+                        R: r3(doubles, rd + 25),
+                        t: [doubles[rd + 34], doubles[rd + 35], doubles[rd + 36]],
+                        e: doubles[rd + 37],
+                        uniquesol: (flags & Apriltag.DET_REC_ASOL_DISTINCT) != 0
+                    };
+                }
+            }
+            detections.push(det);
+        }
+        return detections;
+    }
+
+    /**
+     * **public** acquire a frame ring slot to fill with the next frame while the detector works on the previous one
+     * (see ring_detect()). With the threads build, the WASM memory is a SharedArrayBuffer: it is returned as *buffer*,
+     * and the page can write the frame directly at *offset* (e.g. new Uint8Array(buffer, offset, size).set(pixels)) and
+     * then call ring_commit(), with no copy of the frame between page and worker; otherwise *buffer* is null, and the
+     * frame is given with ring_put()
+     * @param {Number} imgWidth image with
+     * @param {Number} imgHeight image height
+     * @param {Number} rgba 0=grayscale frame; 1=RGBA frame (as ImageData.data)
+     * @return {Object} { slot, offset, buffer }; slot is -1 if all slots are in use
+     */
+    ring_acquire(imgWidth, imgHeight, rgba = 1) {
+        let slot = this._ring_acquire(imgWidth, imgHeight, imgWidth, rgba);
+        if (slot < 0) return { slot: -1, offset: 0, buffer: null };
+        const heap = this._Module.HEAPU8.buffer;
+        return {
+            slot: slot,
+            offset: this._ring_buffer(slot),
+            buffer: (typeof SharedArrayBuffer !== 'undefined' && heap instanceof SharedArrayBuffer) ? heap : null
+        };
+    }
+
+    /**
+     * **public** copy a frame into an acquired frame ring slot and commit it
+     * @param {Number} slot the slot
+     * @param {Uint8Array} pixels the frame pixels (as given to ring_acquire())
+     * @return {Number} 0=success; -1 on failure
+     */
+    ring_put(slot, pixels) {
+        let ptr = this._ring_buffer(slot);
+        if (ptr == 0) return -1;
+        this._Module.HEAPU8.set(pixels, ptr);
+        return this._ring_commit(slot);
+    }
+
+    /**
+     * **public** mark a frame ring slot, filled through the shared buffer, as ready for detection
+     * @param {Number} slot the slot
+     * @return {Number} 0=success; -1 on failure
+     */
+    ring_commit(slot) {
+        return this._ring_commit(slot);
+    }
+
+    /**
+     * **public** detect tags in a committed frame ring slot, and release the slot
+     * @param {Number} slot the slot
+     * @return {detection} detection object (as detect() with binary output, with the *reused* and *truncated* flags)
+     */
+    ring_detect(slot) {
+        let binPtr = this._ring_detect(slot);
+        if (binPtr == 0) return { result: "Detector error." };
+        const header = new Int32Array(this._Module.HEAP8.buffer, binPtr, 5);
+        if (header[0] != Apriltag.DET_BIN_VERSION) return { result: "Unexpected binary output version." };
+        return this._setFrameFlags(this._readRecords(header[4], header[1], header[2]), header[3]);
+    }
+
+    /**
+     * **public** release a frame ring slot without detecting (e.g. to drop a frame)
+     * @param {Number} slot the slot
+     */
+    ring_release(slot) {
+        this._ring_release(slot);
+    }
+
+    /**
+     * **public** enable/disable tracking mode; search regions around the tags detected in previous frames before scanning the full frame
+     * @param {Number} enable 0=disable; 1=enable
+     * @param {Number} keyframeInterval scan the full frame at least every keyframeInterval frames (new tags are found on full-frame scans)
+     * @param {Number} roiPadding padding around the predicted tag corners, as a fraction of the tag size
+     */
+    set_tracking(enable, keyframeInterval = 10, roiPadding = 0.5) {
+        this._set_tracking(enable, keyframeInterval, roiPadding);
+    }
+
+    /**
+     * **public** enable/disable fused conversion of the RGBA input of detect_rgba(); the input is converted and decimated in one pass and
+     * converted at full resolution only around candidate tags (requires quad_decimate >= 2 and quad_sigma = 0)
+     * @param {Number} enable 0=disable; 1=enable
+     */
+    set_fused_input(enable) {
+        this._set_fused_input(enable);
+    }
+
+    /**
+     * **public** adapt decimation (and optionally edge refinement) frame by frame to keep each detect call within a time budget;
+     * the settings each frame was detected with are in get_frame_stats() (quad_decimate, refine_edges)
+     * @param {Number} targetMs frame time budget, in milliseconds; 0 disables (back to the decimation set in the options)
+     * @param {Number} minDecimate smallest decimation (default 1)
+     * @param {Number} maxDecimate largest decimation (default 4)
+     * @param {Boolean} adaptRefine also turn edge refinement off when decimation cannot go up (default true)
+     * @return {Boolean} false on invalid arguments
+     */
+    set_auto_decimate(targetMs, minDecimate = 1, maxDecimate = 4, adaptRefine = true) {
+        return this._set_auto_decimate(targetMs, minDecimate, maxDecimate, adaptRefine ? 1 : 0) == 0;
+    }
+
+    /**
+     * **public** set a deadline for each detect call; once it expires, candidates left (decoded by rank: size and contrast) and
+     * poses left are skipped, and the detections found so far are returned; the result's *truncated* flag (and
+     * get_frame_stats().truncated) tells if it expired
+     * @param {Number} deadlineMs time budget of each detect call, in milliseconds; 0 for no deadline
+     */
+    set_deadline(deadlineMs) {
+        this._set_deadline(deadlineMs);
+    }
+
+    /**
+     * **public** set a heap budget: preallocate for the largest frame and most tags expected, so detect calls do not grow
+     * the WASM heap (growing it invalidates every view over it); frames that do not fit are refused (detect returns an
+     * error result, and get_frame_stats().over_budget is set). The fixed-heap build sets the budget it was built for
+     * @param {Number} maxWidth width of the largest frame; 0 to remove the budget
+     * @param {Number} maxHeight height of the largest frame; 0 to remove the budget
+     * @param {Number} maxTags most tags returned per frame
+     * @return {Boolean} false if the heap is too small for the budget
+     */
+    set_heap_budget(maxWidth, maxHeight, maxTags) {
+        return this._set_heap_budget(maxWidth, maxHeight, maxTags) == 0;
+    }
+
+    /**
+     * **public** enable/disable motion gating: a frame unchanged from the last frame detected (compared over a downsampled
+     * grid) returns the detections of that frame without running the detector; the result's *reused* flag (and
+     * get_frame_stats().reused) tells if it did
+     * @param {Boolean} enable
+     * @param {Number} threshold largest mean absolute difference of a grid cell (gray levels) of an unchanged frame (default 6)
+     * @param {Number} refreshInterval most frames reused in a row before one is detected anyway; 0 for no limit (default 30)
+     */
+    set_motion_gate(enable, threshold = 6, refreshInterval = 30) {
+        this._set_motion_gate(enable ? 1 : 0, threshold, refreshInterval);
+    }
+
+    /**
+     * **public** enable/disable the detector stage breakdown and pipeline counters in the frame stats (0=disable; 1=enable)
+     * @param {Number} enable
+     */
+    set_frame_stats(enable) {
+        this._set_frame_stats(enable);
+    }
+
+    /**
+     * **public** get timing (microseconds) and counters of the last frame processed
+     * @return {Object} frame stats; stage breakdown, counters, heap_used and heap_peak are zero unless enabled with set_frame_stats(1)
+     */
+    get_frame_stats() {
+        let statsPtr = this._get_frame_stats();
+        if (statsPtr == 0) return {};
+        /* t_atagjs_frame_stats c struct: 17 doubles followed by 15 int32 */
+        const d = new Float64Array(this._Module.HEAP8.buffer, statsPtr, 17);
+        const c = new Int32Array(this._Module.HEAP8.buffer, statsPtr + 17 * 8, 15);
+        return {
+            detect_us: d[0],
+            decimate_us: d[1],
+            blur_us: d[2],
+            threshold_us: d[3],
+            unionfind_us: d[4],
+            clusters_us: d[5],
+            quad_fit_us: d[6],
+            decode_us: d[7],
+            other_us: d[8],
+            pose_us: d[9],
+            json_us: d[10],
+            convert_us: d[11],
+            quad_decimate: d[12],
+            heap_used: d[13],
+            heap_peak: d[14],
+            heap_size: d[15],
+            gate_us: d[16],
+            nedges: c[0],
+            nsegments: c[1],
+            nquads: c[2],
+            ndecode_attempts: c[3],
+            nrejected: c[4],
+            ndetections: c[5],
+            nrois: c[6],
+            npose_iters: c[7],
+            nallocs: c[8],
+            refine_edges: c[9],
+            truncated: c[10],
+            heap_grew: c[11],
+            over_budget: c[12],
+            reused: c[13],
+            gate_change: c[14]
+        };
+    }
+
     /**
      * **public** set camera parameters
      * @param {Number} fx camera focal length
@@ -129,13 +556,43 @@ class Apriltag {
         this._set_pose_info(fx, fy, cx, cy);
     }
 
+    /**
+     * **public** preallocate the input buffers for frames up to the given size, and allocate (and release) the heap the
+     * detector intermediates of such a frame need, so the first frames do not grow the WASM heap; call once the camera
+     * resolution is known. The detector still allocates its intermediates on each frame, from the heap reserved
+     * @param {Number} imgWidth width of the largest frame expected
+     * @param {Number} imgHeight height of the largest frame expected
+     * @return {Boolean} false if the buffers could not be allocated
+     */
+    reserve(imgWidth, imgHeight) {
+        return this._reserve(imgWidth, imgHeight) == 0;
+    }
+
     /**
      * **public** set size of known tag (size in meters)
      * @param {Number} tagid the tag id
      * @param {Number} size the size of the tag in meters
+     * @param {String} family the family of the tag (e.g. "tag16h5"); the size applies to the id in any family if not given
+     */
+    set_tag_size(tagid, size, family) {
+        if (family === undefined) this._atagjs_set_tag_size(tagid, size);
+        else this._set_family_tag_size(1 << Apriltag.FAMILY_NAMES.indexOf(family), tagid, size);
+    }
+
+    /**
+     * **public** set the tag families to detect; all are detected in the same detector pass
+     * @param {Array} families family names (see Apriltag.FAMILY_NAMES; e.g. ["tag36h11", "tag16h5"])
+     * @param {Number} bitsCorrected number of bits corrected when decoding (default 1)
+     * @return {Boolean} false if the families could not be set
      */
-    set_tag_size(tagid, size) {
-        this._atagjs_set_tag_size(tagid, size);
+    set_families(families, bitsCorrected = 1) {
+        let mask = 0;
+        for (const name of families) {
+            const f = Apriltag.FAMILY_NAMES.indexOf(name);
+            if (f < 0) return false;
+            mask |= 1 << f;
+        }
+        return this._set_families(mask, bitsCorrected) == 0;
     }
 
     /**
@@ -155,7 +612,33 @@ class Apriltag {
     }
 
     /**
-     * **public** set return pose estimate (0=do not return; 1=return)
+     * **public** set number of detector threads; only the threads build (loaded in cross-origin isolated pages) runs in parallel,
+     * other builds run single-threaded
+     * @param {Number} nthreads number of threads (limited to max_threads())
+     */
+    set_nthreads(nthreads) {
+        this._opt.nthreads = Math.max(1, Math.min(nthreads, this._max_threads()));
+        this._set_detector_options(
+          this._opt.quad_decimate,
+          this._opt.quad_sigma,
+          this._opt.nthreads,
+          this._opt.refine_edges,
+          this._opt.max_detections,
+          this._opt.return_pose,
+          this._opt.return_solutions);
+    }
+
+    /**
+     * **public** maximum number of detector threads of the loaded build (1 unless the threads build is loaded)
+     * @return {Number}
+     */
+    max_threads() {
+        return this._max_threads();
+    }
+
+    /**
+     * **public** set return pose estimate: Apriltag.POSE_NONE (0, do not return), Apriltag.POSE_FULL (1, orthogonal iteration) or
+     * Apriltag.POSE_FAST (2, closed-form homography pose; cheaper, less accurate and without alternative solution)
      * @param {Number} returnPose
      */
     set_return_pose(returnPose) {
@@ -170,6 +653,14 @@ class Apriltag {
           this._opt.return_solutions);
     }
 
+    /**
+     * **public** set binary output (0=parse the json string; 1=read fixed-layout binary records)
+     * @param {Number} binaryOutput
+     */
+    set_binary_output(binaryOutput) {
+        this._opt.binary_output = binaryOutput;
+    }
+
     /**
      * **public** set return pose estimate alternative solution details (0=do not return; 1=return)
      * @param {Number} returnSolutions
@@ -188,4 +679,16 @@ class Apriltag {
 
 }
 
+// must match ATAGJS_DET_BIN_VERSION, the ATAGJS_DET_BIN_* and ATAGJS_DET_REC_* flags, the ATAGJS_POSE_* modes and the ATAGJS_FAMILY_* bits in apriltag_js.h
+Apriltag.DET_BIN_VERSION = 3;
+Apriltag.DET_BIN_TRUNCATED = 0x1;
+Apriltag.DET_BIN_REUSED = 0x2;
+Apriltag.POSE_NONE = 0;
+Apriltag.POSE_FULL = 1;
+Apriltag.POSE_FAST = 2;
+Apriltag.DET_REC_POSE = 0x1;
+Apriltag.DET_REC_ASOL = 0x2;
+Apriltag.DET_REC_ASOL_DISTINCT = 0x4;
+Apriltag.FAMILY_NAMES = ["tag36h11", "tag25h9", "tag16h5", "tagCircle21h7", "tagStandard41h12"]; // in ATAGJS_FAMILY_* bit order
+
 Comlink.expose(Apriltag);
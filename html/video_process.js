@@ -5,6 +5,12 @@ import * as Base64 from "./base64.js";
 var detections=[];
 var imgSaveRequested=0;
 
+// frame ring pipeline: the slot we fill with the next frame, and the detection of the previous frame (in flight while we fill)
+var ringSlot=null;
+var inFlight=null;
+// pixels of the frame in flight, kept (copied before they go to the worker) only when a save is requested
+var inFlightPixels=null;
+
 window.onload = (event) => {
   init();
 
@@ -43,47 +49,52 @@ async function process_frame() {
     setTimeout(process_frame, 500); // try again in 0.5 s
     return;
   }
-  let imageDataPixels = imageData.data;
-  let grayscalePixels = new Uint8Array(ctx.canvas.width * ctx.canvas.height); // this is the grayscale image we will pass to the detector
-
-  for (var i = 0, j = 0; i < imageDataPixels.length; i += 4, j++) {
-    let grayscale = Math.round((imageDataPixels[i] + imageDataPixels[i + 1] + imageDataPixels[i + 2]) / 3);
-    grayscalePixels[j] = grayscale; // single grayscale value
-    imageDataPixels[i] = grayscale;
-    imageDataPixels[i + 1] = grayscale;
-    imageDataPixels[i + 2] = grayscale;
-  }
-  ctx.putImageData(imageData, 0, 0);
+  let imageDataPixels = imageData.data; // RGBA pixels; the detector converts them to grayscale
 
   // draw previous detection
-  detections.forEach(det => {
-    // draw tag borders
-    ctx.beginPath();
-      ctx.lineWidth = "5";
-      ctx.strokeStyle = "blue";
-      ctx.moveTo(det.corners[0].x, det.corners[0].y);
-      ctx.lineTo(det.corners[1].x, det.corners[1].y);
-      ctx.lineTo(det.corners[2].x, det.corners[2].y);
-      ctx.lineTo(det.corners[3].x, det.corners[3].y);
-      ctx.lineTo(det.corners[0].x, det.corners[0].y);
-      ctx.font = "bold 20px Arial";
-      var txt = ""+det.id;
-      ctx.fillStyle = "blue";
-      ctx.textAlign = "center";
-      ctx.fillText(txt, det.center.x, det.center.y+5);
-    ctx.stroke();
-  });
-
-  // detect aprilTag in the grayscale image given by grayscalePixels
-  detections = await apriltag.detect(grayscalePixels, ctx.canvas.width, ctx.canvas.height);
-
-  if (imgSaveRequested && detections.length > 0) {
-      let savep = Base64.bytesToBase64(ctx.getImageData(0, 0, ctx.canvas.width, ctx.canvas.height).data);
+  detections.forEach(det => drawDetection(ctx, det));
+
+  // fill a ring slot with this frame while the worker detects the previous one; detections shown are one frame behind
+  let width = ctx.canvas.width, height = ctx.canvas.height;
+  if (ringSlot == null || ringSlot.width != width || ringSlot.height != height) {
+    if (ringSlot != null) apriltag.ring_release(ringSlot.slot);
+    ringSlot = await acquireSlot(width, height);
+  }
+  if (ringSlot.slot < 0) {
+    ringSlot = null;
+    window.requestAnimationFrame(process_frame);
+    return;
+  }
+  // the detections of this frame arrive with the next one; keep its pixels to save them with their detections
+  let filledPixels = imgSaveRequested ? { data: imageDataPixels.slice(), width: width, height: height } : null;
+  if (ringSlot.buffer) {
+    // threads build: the WASM memory is shared with the page; write the frame straight into the slot
+    new Uint8Array(ringSlot.buffer, ringSlot.offset, imageDataPixels.length).set(imageDataPixels);
+    apriltag.ring_commit(ringSlot.slot);
+  } else {
+    // transfer (not copy) the pixels to the worker, we do not use them after this
+    apriltag.ring_put(ringSlot.slot, Comlink.transfer(imageDataPixels, [imageDataPixels.buffer]));
+  }
+  let filled = ringSlot.slot;
+  // the worker handles calls in order: the next slot is acquired before this frame is detected, so it is ready while it runs
+  let nextSlot = acquireSlot(width, height);
+  let detectedPixels = inFlightPixels; // the frame the detections awaited below belong to
+  if (inFlight != null) {
+    let result = await inFlight;
+    if (!Array.isArray(result)) console.log("Detection failed: " + result.result); // error result object
+    detections = Array.isArray(result) ? result : [];
+  }
+  inFlight = apriltag.ring_detect(filled);
+  inFlightPixels = filledPixels;
+  ringSlot = await nextSlot;
+
+  if (imgSaveRequested && detectedPixels != null && detections.length > 0) {
+      let savep = Base64.bytesToBase64(detectedPixels.data);
       var det = JSON.stringify({
         det_data: detections[0],
         img_data: LZString.compressToUTF16(savep),
-        img_width:  ctx.canvas.width,
-        img_height: ctx.canvas.height
+        img_width:  detectedPixels.width,
+        img_height: detectedPixels.height
       });
 
       //console.log("Saving detection data.");
@@ -95,6 +106,31 @@ async function process_frame() {
   window.requestAnimationFrame(process_frame);
 }
 
+function drawDetection(ctx, det) {
+  // draw tag borders
+  ctx.beginPath();
+    ctx.lineWidth = "5";
+    ctx.strokeStyle = "blue";
+    ctx.moveTo(det.corners[0].x, det.corners[0].y);
+    ctx.lineTo(det.corners[1].x, det.corners[1].y);
+    ctx.lineTo(det.corners[2].x, det.corners[2].y);
+    ctx.lineTo(det.corners[3].x, det.corners[3].y);
+    ctx.lineTo(det.corners[0].x, det.corners[0].y);
+    ctx.font = "bold 20px Arial";
+    var txt = ""+det.id;
+    ctx.fillStyle = "blue";
+    ctx.textAlign = "center";
+    ctx.fillText(txt, det.center.x, det.center.y+5);
+  ctx.stroke();
+}
+
+async function acquireSlot(width, height) {
+  let slot = await apriltag.ring_acquire(width, height, 1);
+  slot.width = width;
+  slot.height = height;
+  return slot;
+}
+
 async function loadImg(targetHtmlElemId) {
   var detectData = localStorage.getItem('detectData');
   if (detectData) {
@@ -109,6 +145,7 @@ async function loadImg(targetHtmlElemId) {
      let imageData = ctx.getImageData(0, 0, ctx.canvas.width, ctx.canvas.height);
      imageData.data.set(savedPixels);
      ctx.putImageData(imageData, 0, 0);
+     drawDetection(ctx, detectDataObj.det_data); // the pixels saved are those of the frame it was detected in
 
      //console.log(detectDataObj.det_data);
      let detDataSaved = document.getElementById(targetHtmlElemId+"_data");
@@ -10,6 +10,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <ctype.h>
@@ -27,6 +29,7 @@
 #include "common/image_u8x4.h"
 #include "common/pjpeg.h"
 #include "common/zarray.h"
+#include "common/time_util.h"
 #ifdef __EMSCRIPTEN__
 #include "emscripten.h"
 #else
@@ -35,299 +38,2338 @@
 
 #include "apriltag_js.h"
 #include "str_json.h"
+#include "tag_track.h"
+#include "tag_pose.h"
+#include "frame_arena.h"
+#include "img_convert.h"
+#include "tag_decode_table.h"
+#include "tag_size.h"
+#include "decimate_ctl.h"
+#include "quad_rank.h"
+#include "heap_stats.h"
+#include "motion_gate.h"
 
-// global pointers to the tag family and detector
-static apriltag_family_t *g_tf = NULL;
-static apriltag_detector_t *g_td;
+// maximum candidate quads for which the fused input runs the detector on regions; with more, it converts the full frame
+#define FUSED_MAX_ROIS 64
 
-// size and stride f the image to process
-static int g_width;
-static int g_height;
-static int g_stride;
+// padding around candidate quads, as a fraction of the quad size (the detector needs to see the white border around the tag)
+#define FUSED_ROI_PADDING 0.5
 
-// return structure for a json string we reuse in each detect() call
-static t_str_json g_det_json = STR_JSON_INITIALIZER;
+// maximum detector threads: WASM builds without pthreads run single-threaded; pthreads builds can only use the threads of
+// the preallocated worker pool (ATAGJS_MAX_THREADS is set to the pool size by the Makefile)
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#undef ATAGJS_MAX_THREADS
+#define ATAGJS_MAX_THREADS 1
+#elif !defined(ATAGJS_MAX_THREADS)
+#define ATAGJS_MAX_THREADS 64
+#endif
+
+// heap a frame needs for the detector intermediates, per pixel of the decimated frame (threshold, union-find, clusters
+// and the blurred copy, for a cluttered frame) and per tag returned (quad, decode, pose, record and json); estimates,
+// checked against the heap before detecting with a heap budget. The fixed-heap build is sized with the same values
+// (set by the Makefile)
+#ifndef ATAGJS_HEAP_BYTES_PER_PIXEL
+#define ATAGJS_HEAP_BYTES_PER_PIXEL 40
+#endif
+#ifndef ATAGJS_HEAP_BYTES_PER_TAG
+#define ATAGJS_HEAP_BYTES_PER_TAG 16384
+#endif
+
+// batches are processed by several threads, except in WASM builds without pthreads
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <pthread.h>
+#define ATAGJS_BATCH_THREADS
+#endif
+
+// size of tags without a size set (meters)
+#define DEFAULT_TAG_SIZE 0.15
+
+// decimal places of the json output: corners, center and tag size; pose (R, t, e)
+#define JSON_PIXEL_DECIMALS 2
+#define JSON_POSE_DECIMALS 6
+
+// candidate quads from the thresholding stage of the apriltag detector; implemented in apriltag_quad_thresh.c (not declared in apriltag.h)
+extern zarray_t *apriltag_quad_thresh(apriltag_detector_t *td, image_u8_t *im);
+
+/**
+ * @brief A tag family the detector can decode
+ */
+typedef struct {
+    const char *name;
+    apriltag_family_t *(*create)(void);
+    void (*destroy)(apriltag_family_t *tf);
+} t_family_desc;
+
+// tag families, in ATAGJS_FAMILY_* bit order
+static const t_family_desc g_family_desc[ATAGJS_NFAMILIES] = {
+    { "tag36h11", tag36h11_create, tag36h11_destroy },
+    { "tag25h9", tag25h9_create, tag25h9_destroy },
+    { "tag16h5", tag16h5_create, tag16h5_destroy },
+    { "tagCircle21h7", tagCircle21h7_create, tagCircle21h7_destroy },
+    { "tagStandard41h12", tagStandard41h12_create, tagStandard41h12_destroy }
+};
+
+/**
+ * @brief A worker processing frames of a batch; has its own detector context, with the options of the batch context
+ */
+typedef struct {
+    // detector context of the worker
+    atagjs_ctx_t *ctx;
+
+    // records of the frames processed by the worker in the current batch, one frame after the other
+    t_atagjs_det_bin out;
+
+    // stats summed over the frames processed by the worker in the current batch
+    t_atagjs_frame_stats stats;
+
+    // the batch being processed
+    struct batch_job *job;
+
+#ifdef ATAGJS_BATCH_THREADS
+    pthread_t thread;
+#endif
+} t_batch_worker;
+
+/**
+ * @brief Where the records of a frame of a batch are, before they are gathered into the batch output
+ */
+typedef struct {
+    int32_t worker;  // worker that processed the frame
+    int32_t start;   // first record of the frame in the worker output
+    int32_t len;     // number of records of the frame; < 0 on error
+} t_batch_frame;
+
+// states of a frame ring slot
+#define RING_SLOT_FREE 0       // can be acquired
+#define RING_SLOT_ACQUIRED 1   // being filled by the caller
+#define RING_SLOT_COMMITTED 2  // filled; waiting for detection
+
+/**
+ * @brief A frame ring slot: an input buffer the caller fills while the detector works on another slot
+ */
+typedef struct {
+    // the pixels (grayscale, or RGBA if rgba != 0), and the allocated size
+    uint8_t *buf;
+    size_t alloc;
+
+    // size and stride (in pixels) of the frame, and if it is RGBA (=0 grayscale; RGBA otherwise)
+    int width;
+    int height;
+    int stride;
+    int rgba;
+
+    // RING_SLOT_* state
+    int state;
+} t_ring_slot;
+
+/**
+ * @brief Detector context; everything a detector needs to process frames, so that several detectors can run side by side
+ */
+struct atagjs_ctx {
+    // tag families enabled (ATAGJS_FAMILY_* bits), their apriltag families (NULL when not enabled), bits corrected, and
+    // the detector (decodes the quads of a frame against all the families enabled)
+    int families;
+    apriltag_family_t *tf[ATAGJS_NFAMILIES];
+    int bits_corrected;
+    apriltag_detector_t *td;
+
+    // size and stride of the image to process
+    int width;
+    int height;
+    int stride;
+
+    // pointer to the image grayscale pixels, and its allocated size (only grows; see grow_buf())
+    uint8_t *img_buf;
+    size_t img_alloc;
+
+    // pointer to the image RGBA pixels, when the input is RGBA (converted into img_buf at detect), and its allocated size
+    uint8_t *rgba_buf;
+    size_t rgba_alloc;
+
+    // stride (in pixels) of the RGBA image
+    int rgba_stride;
+
+    // if the input is in rgba_buf (=0 input is grayscale in img_buf; input is RGBA otherwise)
+    int input_rgba;
+
+    // if RGBA input is converted and decimated in one pass, and converted at full resolution only around candidate quads (=0 does not; does otherwise)
+    int fused_input;
+
+    // if img_buf is converted on demand (only the regions the detector runs on) in the current frame
+    int lazy_gray;
+
+    // decimated grayscale image written by the fused conversion, and its allocated size
+    uint8_t *dec_buf;
+    size_t dec_alloc;
+
+    // regions around the candidate quads found in the decimated image
+    t_tag_roi fused_rois[FUSED_MAX_ROIS];
+
+    // return structure for a json string we reuse in each detect() call
+    t_str_json det_json;
+
+    // return structure for the binary records we reuse in each detect() and detect_bin() call
+    t_atagjs_det_bin det_bin;
+
+    // return structure for the binary records of a batch, reused in each detect_batch() call
+    t_atagjs_det_batch det_batch;
+
+    // batch workers (created on the first batch; one per thread)
+    t_batch_worker *batch_workers;
+    int batch_nworkers;
+
+    // where the records of each frame of the current batch are, and its allocated size (in frames)
+    t_batch_frame *batch_frames;
+    int batch_frames_alloc;
+
+    // batch input buffer (for callers that cannot pass a pointer, e.g. javascript), and its allocated size
+    uint8_t *batch_buf;
+    size_t batch_alloc;
+
+    // frame ring slots, and the grayscale buffer RGBA slots are converted into (and its allocated size)
+    t_ring_slot ring[ATAGJS_RING_SLOTS];
+    uint8_t *ring_gray;
+    size_t ring_gray_alloc;
+
+    // max number of detections returned (0=no max)
+    int max_detections;
+
+    // pose mode (ATAGJS_POSE_*)
+    int return_pose;
+
+    // if we are returning details about both solutions (see estimate_tag_pose_with_solution; =0 does not output; output otherwise)
+    int return_solutions;
+
+    // known tag sizes, by family and id
+    t_tag_size_table tag_sizes;
+
+    // camera intrinsics for pose estimation
+    apriltag_detection_info_t det_pose_info;
+
+    // timing and counters of the last frame
+    t_atagjs_frame_stats stats;
+
+    // if we fill the detector stage breakdown and counters in stats (=0 does not; does otherwise)
+    int frame_stats;
+
+    // if we are tracking tags across frames and searching regions around them first (=0 does not; does otherwise)
+    int tracking;
+
+    // tracker state
+    t_tag_track track;
+
+    // if decimation (and edge refinement) adapt to keep the frame time within a budget (=0 does not; does otherwise)
+    int auto_decimate;
+
+    // decimation controller; sets the detector quad_decimate and refine_edges while auto_decimate is on
+    t_decimate_ctl decimate_ctl;
+
+    // quad_decimate and refine_edges detector options (restored when auto_decimate is turned off)
+    float decimate_option;
+    int refine_edges_option;
+
+    // time budget of each detect call, in microseconds (0=no deadline), and when the current frame must be done
+    // (utime_now() time; 0=no deadline)
+    int64_t deadline_us;
+    int64_t frame_deadline;
+
+    // time of the last full-frame scan, per pixel of the decimated image (0=not measured yet); predicts if the next one
+    // fits the deadline
+    double scan_us_per_px;
+
+    // if frames unchanged since the last frame detected return its records (=0 does not; does otherwise)
+    int motion_gate;
 
-// pointer to the image grayscale pixels
-static uint8_t *g_img_buf = NULL;
+    // change detector, and the number of records of the last frame detected (its reference)
+    t_motion_gate gate;
+    int gate_len;
 
-// max number of detections returned (0=no max)
-static int g_max_detections = 0;
+    // heap budget: largest frame (width*height, 0=no budget) and most tags returned (see atagjs_set_heap_budget())
+    int64_t budget_pixels;
+    int budget_tags;
 
-// if we are returning pose (=0 does not output; output otherwise)
-static int g_return_pose = 1;
+    // heap probed (in one block) for the largest frame and tags of the budget, and if the context grew its buffers since
+    // the last probe (they might have taken part of that heap; the next frame probes it again)
+    size_t budget_heap;
+    int budget_grown;
 
-// if we are returning details about both solutions (see estimate_tag_pose_with_solution; =0 does not output; output otherwise)
-static int g_return_solutions = 0;
+    // heap usage sampled after the last call, and the WASM heap size then (to tell if it grew since)
+    t_heap_stats heap;
+    size_t heap_size;
 
-// store known tag sizes
-static double g_tag_size[MAX_TAG_ID];
+    // last pose of each tag, the starting point of the pose estimation in the next frame
+    t_tag_pose_cache pose_cache;
 
-// apriltag_detection_info
-static apriltag_detection_info_t g_det_pose_info = {.cx=636.9118, .cy=360.5100, .fx=997.2827, .fy=997.2827};
+    // temporaries of the current frame (reset at the start of each frame)
+    t_frame_arena arena;
+
+    // detections of the tracking and region scans (cleared, not destroyed, after each frame), and its allocated size
+    zarray_t *detections;
+    int detections_alloc;
+};
+
+/**
+ * @brief A batch being processed; workers take its frames in order until there are none left
+ */
+struct batch_job {
+    // the batch context (its image size is the size of the frames)
+    atagjs_ctx_t *ctx;
+
+    // the frames, and the size of each frame, in bytes
+    const uint8_t *frames;
+    size_t frame_size;
+    int nframes;
+
+    // next frame to process (taken atomically by the workers)
+    int next;
+};
+
+// default context, used by the atagjs_* calls without a context argument
+static atagjs_ctx_t *g_ctx = NULL;
+
+// json string returned when the default context does not exist
+static t_str_json g_err_json = STR_JSON_INITIALIZER;
 
 // declare static calls, implemented at the end of this file
-static double estimate_tag_pose_with_solution(apriltag_detection_info_t *info, apriltag_pose_t *pose, char *s, int ssize);
-static double tagsize_from_id(int tagid);
+static int detect_records(atagjs_ctx_t *ctx);
+static t_str_json *records_json(atagjs_ctx_t *ctx, int n);
+static double estimate_tag_pose_with_solution(atagjs_ctx_t *ctx, apriltag_detection_info_t *info, t_atagjs_det_record *rec);
+static double estimate_tag_pose_fast(apriltag_detection_info_t *info, t_atagjs_det_record *rec);
+static double tagsize_from_det(atagjs_ctx_t *ctx, apriltag_detection_t *det, int *family);
+static int set_families(atagjs_ctx_t *ctx, int families, int bits_corrected);
+static void clear_families(atagjs_ctx_t *ctx);
+static zarray_t *run_detector(atagjs_ctx_t *ctx, image_u8_t *im);
+static zarray_t *detect_tags(atagjs_ctx_t *ctx, image_u8_t *im);
+static uint8_t *alloc_img_buf(atagjs_ctx_t *ctx, int width, int height, int stride);
+static int grow_buf(uint8_t **buf, size_t *alloc, size_t size);
+static zarray_t *detect_full(atagjs_ctx_t *ctx, image_u8_t *im);
+static zarray_t *scan_frame(atagjs_ctx_t *ctx, image_u8_t *im, int ranked);
+static zarray_t *detect_ranked(atagjs_ctx_t *ctx, image_u8_t *im, const image_u8_t *dec, zarray_t *quads);
+static int quad_roi(const apriltag_detector_t *td, const struct quad *q, const image_u8_t *im, t_tag_roi *roi);
+static void destroy_quads(zarray_t *quads);
+static void convert_rgba(atagjs_ctx_t *ctx, const t_tag_roi *roi);
+static void add_stage_times(atagjs_ctx_t *ctx);
+static int detect_image_records(atagjs_ctx_t *ctx, image_u8_t *im);
+static zarray_t *ctx_detections(atagjs_ctx_t *ctx);
+static void release_detections(atagjs_ctx_t *ctx, zarray_t *detections);
+static int batch_workers_create(atagjs_ctx_t *ctx, int nworkers);
+static void *batch_worker_run(void *arg);
+static void add_frame_stats(t_atagjs_frame_stats *sum, const t_atagjs_frame_stats *stats);
+static int ring_detect_records(atagjs_ctx_t *ctx, t_ring_slot *slot);
+static void json_det_record(t_str_json *str_json, const t_atagjs_det_record *rec);
+static void auto_decimate_update(atagjs_ctx_t *ctx);
+static void start_deadline(atagjs_ctx_t *ctx);
+static int check_deadline(atagjs_ctx_t *ctx);
+static int over_budget(const atagjs_ctx_t *ctx, int width, int height);
+static size_t frame_heap_need(const atagjs_ctx_t *ctx, int width, int height, double decimate);
+static int gate_frame(atagjs_ctx_t *ctx);
+static void update_heap_stats(atagjs_ctx_t *ctx);
 
 // json format string for errors
 const char fmt_error[] = "{ \"result\": \"%s\" }";
 
-// json format string for the detection corners
-const char fmt_det_point[] = "{\"id\":%d, \"corners\": [{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f}], \"center\": {\"x\":%.2f,\"y\":%.2f} }";
-// json format string for the detection with pose
-const char fmt_det_point_pose[] = "{\"id\":%d, \"corners\": [{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f},{\"x\":%.2f,\"y\":%.2f}], \"center\": {\"x\":%.2f,\"y\":%.2f}, \"pose\": { \"size\":%.2f, \"R\": [[%f,%f,%f],[%f,%f,%f],[%f,%f,%f]], \"t\": [%f,%f,%f], \"e\": %f %s } }";
-
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-int atagjs_init()
+atagjs_ctx_t *atagjs_ctx_create()
 {
-    g_tf = tag36h11_create();
-    if (g_tf == NULL)
+    atagjs_ctx_t *ctx = calloc(1, sizeof(atagjs_ctx_t));
+    if (ctx == NULL)
     {
-        printf("Error initializing tag family.");
-        return -1;
+        printf("Error allocating detector context.");
+        return NULL;
     }
-    g_td = apriltag_detector_create();
-    if (g_td == NULL)
+    ctx->td = apriltag_detector_create();
+    if (ctx->td == NULL)
     {
         printf("Error initializing detector.");
-        return -1;
+        free(ctx);
+        return NULL;
+    }
+    if (set_families(ctx, ATAGJS_FAMILY_TAG36H11, 1) != 0)
+    {
+        printf("Error initializing tag family.");
+        apriltag_detector_destroy(ctx->td);
+        free(ctx);
+        return NULL;
     }
-    apriltag_detector_add_family_bits(g_td, g_tf, 1);
-    g_td->quad_decimate = 2.0;
-    g_td->quad_sigma = 0.0;
-    g_td->nthreads = 1;
-    g_td->debug = 0; // Enable debugging output (slow)
-    g_td->refine_edges = 1;
-    g_return_pose = 1;
+    ctx->td->quad_decimate = 2.0;
+    ctx->td->quad_sigma = 0.0;
+    ctx->td->nthreads = 1;
+    ctx->td->debug = 0; // Enable debugging output (slow)
+    ctx->td->refine_edges = 1;
+    ctx->return_pose = ATAGJS_POSE_FULL;
 
-    for (int i=0; i<MAX_TAG_ID; i++)  g_tag_size[i] = 0.15; // default tag size (0.15 meters)
+    ctx->det_json = (t_str_json) STR_JSON_INITIALIZER;
+    ctx->det_bin = (t_atagjs_det_bin) ATAGJS_DET_BIN_INITIALIZER;
+    ctx->det_batch = (t_atagjs_det_batch) ATAGJS_DET_BATCH_INITIALIZER;
+    ctx->track = (t_tag_track) TAG_TRACK_INITIALIZER;
+    ctx->gate = (t_motion_gate) MOTION_GATE_INITIALIZER;
+    ctx->decimate_ctl = (t_decimate_ctl) DECIMATE_CTL_INITIALIZER;
+    ctx->decimate_option = ctx->td->quad_decimate;
+    ctx->refine_edges_option = ctx->td->refine_edges;
+    ctx->pose_cache = (t_tag_pose_cache) TAG_POSE_CACHE_INITIALIZER;
+    ctx->arena = (t_frame_arena) FRAME_ARENA_INITIALIZER;
+    ctx->tag_sizes = (t_tag_size_table) TAG_SIZE_TABLE_INITIALIZER; // tags without a size set are DEFAULT_TAG_SIZE
+    ctx->heap = (t_heap_stats) HEAP_STATS_INITIALIZER;
+    ctx->heap_size = heap_stats_size();
 
-    return 0;
+    ctx->det_pose_info = (apriltag_detection_info_t) {.cx=636.9118, .cy=360.5100, .fx=997.2827, .fy=997.2827};
+
+    return ctx;
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-int atagjs_destroy()
+int atagjs_ctx_destroy(atagjs_ctx_t *ctx)
 {
-    apriltag_detector_destroy(g_td);
-    tag36h11_destroy(g_tf);
-    if (g_img_buf != NULL)
-        free(g_img_buf);
+    if (ctx == NULL) return -1;
+
+    clear_families(ctx);
+    apriltag_detector_destroy(ctx->td);
+    tag_size_destroy(&ctx->tag_sizes);
+    free(ctx->img_buf);
+    free(ctx->rgba_buf);
+    free(ctx->dec_buf);
+
+    str_json_destroy(&ctx->det_json);
+    free(ctx->det_bin.records);
+    frame_arena_destroy(&ctx->arena);
+    if (ctx->detections != NULL) zarray_destroy(ctx->detections);
+
+    for (int i = 0; i < ctx->batch_nworkers; i++)
+    {
+        atagjs_ctx_destroy(ctx->batch_workers[i].ctx);
+        free(ctx->batch_workers[i].out.records);
+    }
+    free(ctx->batch_workers);
+    free(ctx->batch_frames);
+    free(ctx->batch_buf);
+    free(ctx->det_batch.offsets);
+    free(ctx->det_batch.records);
 
-    str_json_destroy(&g_det_json);
+    for (int i = 0; i < ATAGJS_RING_SLOTS; i++) free(ctx->ring[i].buf);
+    free(ctx->ring_gray);
+
+    free(ctx);
 
     return 0;
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-int atagjs_set_detector_options(float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions)
+int atagjs_ctx_set_detector_options(atagjs_ctx_t *ctx, float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions)
 {
-    g_td->quad_decimate = decimate;
-    g_td->quad_sigma = sigma;
-    g_td->nthreads = nthreads;
-    g_td->refine_edges = refine_edges;
-    g_max_detections = max_detections;
-    g_return_pose = return_pose;
-    g_return_solutions = return_solutions;
+    if (ctx == NULL) return -1;
+    ctx->td->quad_decimate = decimate;
+    ctx->td->quad_sigma = sigma;
+    ctx->td->nthreads = (nthreads < 1) ? 1 : (nthreads > ATAGJS_MAX_THREADS) ? ATAGJS_MAX_THREADS : nthreads;
+    ctx->td->refine_edges = refine_edges;
+    ctx->decimate_option = decimate;
+    ctx->refine_edges_option = refine_edges;
+    if (ctx->auto_decimate)
+    {
+        // the controller restarts from the new options
+        decimate_ctl_start(&ctx->decimate_ctl, decimate, refine_edges);
+        ctx->td->quad_decimate = ctx->decimate_ctl.decimate;
+    }
+    ctx->max_detections = max_detections;
+    ctx->return_pose = (return_pose == ATAGJS_POSE_NONE || return_pose == ATAGJS_POSE_FAST) ? return_pose : ATAGJS_POSE_FULL;
+    ctx->return_solutions = return_solutions;
+    motion_gate_invalidate(&ctx->gate); // results of the last frame detected might differ with the new options
     return 0;
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-int atagjs_set_pose_info(double fx, double fy, double cx, double cy)
+int atagjs_ctx_set_pose_info(atagjs_ctx_t *ctx, double fx, double fy, double cx, double cy)
 {
-    g_det_pose_info.fx = fx;
-    g_det_pose_info.fy = fy;
-    g_det_pose_info.cx = cx;
-    g_det_pose_info.cy = cy;
+    if (ctx == NULL) return -1;
+    ctx->det_pose_info.fx = fx;
+    ctx->det_pose_info.fy = fy;
+    ctx->det_pose_info.cx = cx;
+    ctx->det_pose_info.cy = cy;
+    tag_pose_cache_reset(&ctx->pose_cache); // cached poses were estimated with the old intrinsics
+    motion_gate_invalidate(&ctx->gate);
     return 0;
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-uint8_t *atagjs_set_img_buffer(int width, int height, int stride)
+uint8_t *atagjs_ctx_set_img_buffer(atagjs_ctx_t *ctx, int width, int height, int stride)
+{
+    if (ctx == NULL) return NULL;
+    // grayscale input; the RGBA buffer is kept for when the input switches back
+    ctx->input_rgba = 0;
+    return alloc_img_buf(ctx, width, height, stride);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_ctx_set_rgba_buffer(atagjs_ctx_t *ctx, int width, int height, int stride)
 {
+    if (ctx == NULL) return NULL;
     int w = (stride < width) ? width : stride; // stride should always be >= width...
-    if (g_img_buf != NULL)
-    {
-        if (g_width == width && g_height == height && g_stride == stride)
-            return g_img_buf;
-        free(g_img_buf);
-        g_width = width;
-        g_height = height;
-        g_stride = stride;
-        g_img_buf = (uint8_t *)calloc(height*w, sizeof(uint8_t));
 
-    }
-    else
+    // grayscale buffer the RGBA pixels are converted into
+    if (alloc_img_buf(ctx, width, height, width) == NULL) return NULL;
+
+    ctx->rgba_stride = stride;
+    ctx->input_rgba = (grow_buf(&ctx->rgba_buf, &ctx->rgba_alloc, (size_t)height * w * 4) >= 0);
+    return ctx->input_rgba ? ctx->rgba_buf : NULL;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_reserve(atagjs_ctx_t *ctx, int width, int height)
+{
+    if (ctx == NULL || width < 1 || height < 1 || over_budget(ctx, width, height)) return -1;
+    size_t size = (size_t)width * height;
+
+    // input buffers; the current image size is kept (the buffers might move, so set_*_buffer() must be called again)
+    if (grow_buf(&ctx->img_buf, &ctx->img_alloc, size) < 0) return -1;
+    if (ctx->input_rgba && grow_buf(&ctx->rgba_buf, &ctx->rgba_alloc, size * 4) < 0) return -1;
+
+    // decimated image of the fused RGBA conversion, at the current decimation (the smallest one the fused conversion
+    // runs at, with auto decimation)
+    int factor = (int)ctx->td->quad_decimate;
+    if (ctx->auto_decimate) factor = ((int)ctx->decimate_ctl.min_decimate < 2) ? 2 : (int)ctx->decimate_ctl.min_decimate;
+    if (ctx->input_rgba && ctx->fused_input && factor >= 2)
     {
-        g_width = width;
-        g_height = height;
-        g_stride = stride;
-        g_img_buf = (uint8_t *)calloc(height*w, sizeof(uint8_t));
+        size_t dec_size = (size_t)IMG_DECIMATED_SIZE(width, factor) * IMG_DECIMATED_SIZE(height, factor);
+        if (grow_buf(&ctx->dec_buf, &ctx->dec_alloc, dec_size) < 0) return -1;
     }
-    return g_img_buf;
+
+    // heap for the detector intermediates of a frame this size, not decimated (and the output of the most tags of the
+    // heap budget, when setting it): allocated and released, so a heap that can grow does it now instead of during the
+    // first frames. The detector allocates its intermediates again on each frame
+    if (heap_stats_probe(frame_heap_need(ctx, width, height, 1)) != 0) return -1;
+    return 0;
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-int atagjs_set_tag_size(int tagid, double size)
+int atagjs_ctx_set_tag_size(atagjs_ctx_t *ctx, int tagid, double size)
 {
-  if (tagid >= MAX_TAG_ID) return -1;
-  g_tag_size[tagid] = size;
-  return 0;
+  if (ctx == NULL) return -1;
+  motion_gate_invalidate(&ctx->gate); // poses of the last frame detected used the old size
+  return tag_size_set(&ctx->tag_sizes, TAG_SIZE_ANY_FAMILY, tagid, size);
 }
 
 // see documentation in .h
 EMSCRIPTEN_KEEPALIVE
-t_str_json *atagjs_detect()
+int atagjs_ctx_set_family_tag_size(atagjs_ctx_t *ctx, int family, int tagid, double size)
 {
-    char str_tmp_det[STR_DET_LEN+1];
+  if (ctx == NULL || family <= 0 || family > ATAGJS_FAMILY_ALL || (family & (family - 1)) != 0) return -1;
+  motion_gate_invalidate(&ctx->gate);
+  return tag_size_set(&ctx->tag_sizes, __builtin_ctz(family), tagid, size);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_families(atagjs_ctx_t *ctx, int families, int bits_corrected)
+{
+  if (ctx == NULL || families <= 0 || (families & ~ATAGJS_FAMILY_ALL) != 0) return -1;
+  if (bits_corrected < 0 || bits_corrected > ATAGJS_MAX_BITS_CORRECTED) return -1;
+  if (families == ctx->families && bits_corrected == ctx->bits_corrected) return 0;
+  motion_gate_invalidate(&ctx->gate);
+  return set_families(ctx, families, bits_corrected);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_str_json *atagjs_ctx_detect(atagjs_ctx_t *ctx)
+{
+    if (ctx == NULL) return NULL;
+    t_str_json *json = records_json(ctx, detect_records(ctx));
+    auto_decimate_update(ctx);
+    update_heap_stats(ctx);
+    return json;
+}
 
-    // clear the json string
-    str_json_destroy(&g_det_json); // IMPORTANT: make sure g_det_json is initialized properly with: t_str_json g_det_json = STR_JSON_INITIALIZER;
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_str_json *atagjs_ctx_detect_image(atagjs_ctx_t *ctx, const uint8_t *pixels, int width, int height, int stride)
+{
+    if (ctx == NULL) return NULL;
 
-    if (g_tf == NULL || g_td == NULL || g_img_buf == NULL)
+    int n = -1;
+    ctx->det_bin.len = 0;
+    ctx->det_bin.flags = 0;
+    memset(&ctx->stats, 0, sizeof(t_atagjs_frame_stats));
+    start_deadline(ctx);
+    motion_gate_invalidate(&ctx->gate); // the records are not those of the last frame detected anymore
+    tag_pose_cache_reset(&ctx->pose_cache); // an image of its own (e.g. a file of a dataset): poses do not start from the last one
+    if (ctx->families != 0 && ctx->td != NULL && pixels != NULL && width > 0 && height > 0 && stride >= width)
     {
-        if (str_json_create(&g_det_json, 50) == 0) { // try to allocate string to return error string
-          str_json_printf(&g_det_json, fmt_error, "Detector not initizalized. (did you call init and set_img_buffer ?)");
-        }
-        return &g_det_json;
+        // the detector does not write to its input
+        image_u8_t im = {.width = width, .height = height, .stride = stride, .buf = (uint8_t *)pixels};
+        ctx->lazy_gray = 0;
+        n = detect_image_records(ctx, &im);
     }
+    t_str_json *json = records_json(ctx, n);
+    auto_decimate_update(ctx);
+    update_heap_stats(ctx);
+    return json;
+}
 
-    image_u8_t im = {
-        .width = g_width,
-        .height = g_height,
-        .stride = g_stride,
-        .buf = g_img_buf};
-
-    zarray_t *detections = apriltag_detector_detect(g_td, &im);
+/**
+ * @brief Format the binary records of a context as its json string
+ *
+ * @param ctx detector context
+ * @param n number of records; < 0 on error (see detect_records())
+ *
+ * @return pointer to the context str_json structure
+ */
+static t_str_json *records_json(atagjs_ctx_t *ctx, int n)
+{
+    // clear the json string; it keeps its memory across frames, and grows as needed
+    if (ctx->det_json.str != NULL) str_json_clear(&ctx->det_json);
+    else if (str_json_create(&ctx->det_json, STR_DET_LEN) != 0) return &ctx->det_json; // return empty string
 
-    int n = zarray_size(detections);
+    int64_t json_start = utime_now();
 
-    if (n <= 0) {
-      if (str_json_create(&g_det_json, 50) == 0) { // try to allocate string to return error string
-        str_json_printf(&g_det_json, "[ ]");
-      }
-      apriltag_detections_destroy(detections);
-      return &g_det_json; // return empty string or string with empty array
+    if (n == -1)
+    {
+        str_json_printf(&ctx->det_json, fmt_error, "Detector not initizalized. (did you call init and set_img_buffer ?)");
+        return &ctx->det_json;
     }
 
-    // limit detections returned according to g_max_detections
-    if (g_max_detections > 0 && g_max_detections < n) n = g_max_detections;
+    if (n == -3)
+    {
+        str_json_printf(&ctx->det_json, fmt_error, "Frame does not fit the heap budget");
+        return &ctx->det_json;
+    }
 
-    // start the json array
-    if (str_json_create(&g_det_json, n*STR_DET_LEN) != 0) {
-      if (str_json_create(&g_det_json, 50) == 0) { // try to allocate string to return error string
-        str_json_printf(&g_det_json, fmt_error, "Could not allocate memory for %d detections", n);
-      }
-      apriltag_detections_destroy(detections);
-      return &g_det_json;
+    if (n < -1 || str_json_reserve(&ctx->det_json, n*STR_DET_LEN) != 0) {
+      str_json_printf(&ctx->det_json, fmt_error, "Could not allocate memory for detections");
+      return &ctx->det_json;
     }
-    str_json_concat(&g_det_json, "[ ");
 
+    // the json array
+    size_t json_alloc = ctx->det_json.alloc_size;
+    str_json_concat(&ctx->det_json, "[ ");
     for (int i = 0; i < n; i++)
     {
-        apriltag_detection_t *det;
-        zarray_get(detections, i, &det);
+        if (i > 0) str_json_concat(&ctx->det_json, ", ");
+        json_det_record(&ctx->det_json, &ctx->det_bin.records[i]);
+    }
+    str_json_concat(&ctx->det_json, " ]");
+    if (ctx->det_json.alloc_size != json_alloc) ctx->stats.nallocs++; // the json string grew
 
-        if (g_return_pose == 0)
-        {
-            snprintf(str_tmp_det, STR_DET_LEN, fmt_det_point, det->id, det->p[0][0], det->p[0][1], det->p[1][0], det->p[1][1], det->p[2][0], det->p[2][1], det->p[3][0], det->p[3][1], det->c[0], det->c[1]);
-        }
-        else
-        {
-            // return pose ..
-            double tagsize = tagsize_from_id(det->id); // size of the tag is determined from its id
-            printf("###Size:%f",tagsize);
-            apriltag_pose_t pose;
-            double pose_err;
-            g_det_pose_info.det = det;
-            g_det_pose_info.tagsize = tagsize;
-            char *s = malloc(STR_DET_LEN);
-            s[0]='\0';
-            pose_err = estimate_tag_pose_with_solution(&g_det_pose_info, &pose, s, STR_DET_LEN);
-            // column major R:
-            snprintf(str_tmp_det, STR_DET_LEN, fmt_det_point_pose, det->id, det->p[0][0], det->p[0][1], det->p[1][0], det->p[1][1], det->p[2][0], det->p[2][1], det->p[3][0], det->p[3][1], det->c[0], det->c[1], tagsize, matd_get(pose.R, 0, 0), matd_get(pose.R, 1, 0), matd_get(pose.R, 2, 0), matd_get(pose.R, 0, 1), matd_get(pose.R, 1, 1), matd_get(pose.R, 2, 1), matd_get(pose.R, 0, 2), matd_get(pose.R, 1, 2), matd_get(pose.R, 2, 2), matd_get(pose.t, 0, 0), matd_get(pose.t, 1, 0), matd_get(pose.t, 2, 0), pose_err, s);
-            matd_destroy(pose.R);
-            matd_destroy(pose.t);
-            free(s);
-        }
-        if (i > 0) str_json_concat(&g_det_json, ", ");
-        str_json_concat(&g_det_json, str_tmp_det);
+    ctx->stats.json_us = utime_now() - json_start;
+
+    return &ctx->det_json;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_bin *atagjs_ctx_detect_bin(atagjs_ctx_t *ctx)
+{
+    if (ctx == NULL) return NULL;
+    int n = detect_records(ctx);
+    update_heap_stats(ctx);
+    if (n < 0) return NULL;
+    auto_decimate_update(ctx);
+    return &ctx->det_bin;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_ctx_set_batch_buffer(atagjs_ctx_t *ctx, int nframes)
+{
+    if (ctx == NULL || ctx->img_buf == NULL || nframes < 1) return NULL;
+    size_t size = (size_t)nframes * ctx->height * ((ctx->stride < ctx->width) ? ctx->width : ctx->stride);
+    if (size > ctx->batch_alloc)
+    {
+        free(ctx->batch_buf);
+        ctx->batch_buf = (uint8_t *)calloc(size, sizeof(uint8_t));
+        ctx->batch_alloc = (ctx->batch_buf != NULL) ? size : 0;
+    }
+    return ctx->batch_buf;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_batch *atagjs_ctx_detect_batch(atagjs_ctx_t *ctx, const uint8_t *frames, int nframes)
+{
+    if (ctx == NULL || ctx->img_buf == NULL || frames == NULL || nframes < 1) return NULL;
+
+    t_atagjs_det_batch *batch = &ctx->det_batch;
+    batch->nframes = 0;
+    batch->len = 0;
+    memset(&ctx->stats, 0, sizeof(t_atagjs_frame_stats));
+
+    // one worker per thread (a frame per thread, instead of a frame on several threads)
+    int nworkers = (ctx->td->nthreads < nframes) ? ctx->td->nthreads : nframes;
+    if (batch_workers_create(ctx, nworkers) != 0) return NULL;
+
+    if (nframes + 1 > batch->alloc_frames || nframes > ctx->batch_frames_alloc)
+    {
+        int32_t *offsets = realloc(batch->offsets, (nframes + 1) * sizeof(int32_t));
+        if (offsets == NULL) return NULL;
+        batch->offsets = offsets;
+        batch->alloc_frames = nframes + 1;
+        t_batch_frame *bframes = realloc(ctx->batch_frames, nframes * sizeof(t_batch_frame));
+        if (bframes == NULL) return NULL;
+        ctx->batch_frames = bframes;
+        ctx->batch_frames_alloc = nframes;
+        ctx->stats.nallocs += 2;
     }
 
-    str_json_concat(&g_det_json, " ]");
+    struct batch_job job = {
+        .ctx = ctx,
+        .frames = frames,
+        .frame_size = (size_t)ctx->height * ((ctx->stride < ctx->width) ? ctx->width : ctx->stride),
+        .nframes = nframes,
+        .next = 0};
+    for (int i = 0; i < nworkers; i++) ctx->batch_workers[i].job = &job;
 
-    apriltag_detections_destroy(detections);
+    // the calling thread is the first worker
+#ifdef ATAGJS_BATCH_THREADS
+    int started[ATAGJS_MAX_THREADS] = {0};
+    for (int i = 1; i < nworkers; i++)
+        started[i] = (pthread_create(&ctx->batch_workers[i].thread, NULL, batch_worker_run, &ctx->batch_workers[i]) == 0);
+    batch_worker_run(&ctx->batch_workers[0]);
+    for (int i = 1; i < nworkers; i++)
+        if (started[i]) pthread_join(ctx->batch_workers[i].thread, NULL);
+#else
+    batch_worker_run(&ctx->batch_workers[0]);
+#endif
+
+    // gather the records of each frame, in frame order
+    int len = 0;
+    for (int i = 0; i < nframes; i++)
+    {
+        if (ctx->batch_frames[i].len < 0) return NULL;
+        len += ctx->batch_frames[i].len;
+    }
+    if (len > batch->alloc_len)
+    {
+        t_atagjs_det_record *records = realloc(batch->records, len * sizeof(t_atagjs_det_record));
+        if (records == NULL) return NULL;
+        batch->records = records;
+        batch->alloc_len = len;
+        ctx->stats.nallocs++;
+    }
+    batch->offsets[0] = 0;
+    for (int i = 0; i < nframes; i++)
+    {
+        const t_batch_frame *f = &ctx->batch_frames[i];
+        memcpy(batch->records + batch->offsets[i], ctx->batch_workers[f->worker].out.records + f->start, f->len * sizeof(t_atagjs_det_record));
+        batch->offsets[i + 1] = batch->offsets[i] + f->len;
+    }
+    for (int i = 0; i < nworkers; i++) add_frame_stats(&ctx->stats, &ctx->batch_workers[i].stats);
+    batch->nframes = nframes;
+    batch->len = len;
+    update_heap_stats(ctx);
 
-    return &g_det_json;
+    return batch;
 }
 
-/**
- * Our implementation of estimate tag pose to return the solution selected (1=homography method; 2=potential second local minima; see: apriltag/apriltag_pose.h)
- * Writes JSON-formatted pose solution(s) into a user supplied string
- *
- * @param info detection info
- * @param pose where to return the pose estimation
- * @param s user allocated string where to write the output json
- * @param ssize size of the given user allocated string s
- *
- * return the object-space error of the pose estimation
- */
-static double estimate_tag_pose_with_solution(apriltag_detection_info_t *info, apriltag_pose_t *pose, char *s, int ssize)
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_ring_acquire(atagjs_ctx_t *ctx, int width, int height, int stride, int rgba)
 {
-    double err1, err2;
-    apriltag_pose_t pose1, pose2;
-    estimate_tag_pose_orthogonal_iteration(info, &err1, &pose1, &err2, &pose2, 50);
+    if (ctx == NULL || width < 1 || height < 1) return -1;
+    if (stride < width) stride = width; // stride should always be >= width...
+    if (over_budget(ctx, stride, height)) return -1;
 
-    if (err1 <= err2)
+    // prefer a free slot that is already large enough
+    int slot = -1;
+    size_t size = (size_t)height * stride * (rgba ? 4 : 1);
+    for (int i = 0; i < ATAGJS_RING_SLOTS; i++)
     {
-        pose->R = pose1.R;
-        pose->t = pose1.t;
-        if (s != NULL && ssize > 100) { // string must be at least 100 characters
-            if (pose2.R != NULL && pose2.t !=  NULL) {
-                // return other alternative solution; uniquesol indicates if there are multiple solutions
-                snprintf(s, ssize, ", \"asol\": {\"R\": [[%f,%f,%f],[%f,%f,%f],[%f,%f,%f]], \"t\": [%f,%f,%f], \"e\": %f, \"uniquesol\": true }",
-                    matd_get(pose2.R, 0, 0), matd_get(pose2.R, 1, 0), matd_get(pose2.R, 2, 0), matd_get(pose2.R, 0, 1), matd_get(pose2.R, 1, 1), matd_get(pose2.R, 2, 1), matd_get(pose2.R, 0, 2), matd_get(pose2.R, 1, 2), matd_get(pose2.R, 2, 2), matd_get(pose2.t, 0, 0), matd_get(pose2.t, 1, 0), matd_get(pose2.t, 2, 0), err2);
-            } else snprintf(s, ssize, ", \"asol\": {\"R\": [[%f,%f,%f],[%f,%f,%f],[%f,%f,%f]], \"t\": [%f,%f,%f], \"e\": %f, \"uniquesol\": false }", // return the same solution
-                    matd_get(pose1.R, 0, 0), matd_get(pose1.R, 1, 0), matd_get(pose1.R, 2, 0), matd_get(pose1.R, 0, 1), matd_get(pose1.R, 1, 1), matd_get(pose1.R, 2, 1), matd_get(pose1.R, 0, 2), matd_get(pose1.R, 1, 2), matd_get(pose1.R, 2, 2), matd_get(pose1.t, 0, 0), matd_get(pose1.t, 1, 0), matd_get(pose1.t, 2, 0), err1);
-        }
-        if (pose2.R)
-        {
-            matd_destroy(pose2.t);
-        }
-        matd_destroy(pose2.R);
-        return err1;
+        if (ctx->ring[i].state != RING_SLOT_FREE) continue;
+        if (slot < 0 || (ctx->ring[i].alloc >= size && ctx->ring[slot].alloc < size)) slot = i;
     }
-    else
+    if (slot < 0) return -1;
+
+    t_ring_slot *s = &ctx->ring[slot];
+    if (size > s->alloc)
     {
-        pose->R = pose2.R;
-        pose->t = pose2.t;
-        if (s != NULL && ssize > 100) {
-            // return other alternative solution; uniquesol indicates if there are multiple solutions
-            snprintf(s, ssize, ", \"asol\": {\"R\": [[%f,%f,%f],[%f,%f,%f],[%f,%f,%f]], \"t\": [%f,%f,%f], \"e\": %f, \"uniquesol\": true }",
-                 matd_get(pose1.R, 0, 0), matd_get(pose1.R, 1, 0), matd_get(pose1.R, 2, 0), matd_get(pose1.R, 0, 1), matd_get(pose1.R, 1, 1), matd_get(pose1.R, 2, 1), matd_get(pose1.R, 0, 2), matd_get(pose1.R, 1, 2), matd_get(pose1.R, 2, 2), matd_get(pose1.t, 0, 0), matd_get(pose1.t, 1, 0), matd_get(pose1.t, 2, 0), err1);
-        }
-        matd_destroy(pose1.R);
-        matd_destroy(pose1.t);
-        return err2;
+        free(s->buf);
+        s->buf = (uint8_t *)calloc(size, sizeof(uint8_t));
+        s->alloc = (s->buf != NULL) ? size : 0;
+        if (s->buf == NULL) return -1;
     }
+    s->width = width;
+    s->height = height;
+    s->stride = stride;
+    s->rgba = rgba;
+    s->state = RING_SLOT_ACQUIRED;
+    return slot;
 }
 
-/**
- * @brief Determine size of the tag from its id
- *        if tag is known return that size, otherwise return 0.15 meters
- *
- * @param tagid tag id
- *
- * return the tag size, in meters
- */
-static double tagsize_from_id(int tagid) {
-  double size=0.15;
-  if (tagid < MAX_TAG_ID) size = g_tag_size[tagid];
-  return size;
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_ctx_ring_buffer(atagjs_ctx_t *ctx, int slot)
+{
+    if (ctx == NULL || slot < 0 || slot >= ATAGJS_RING_SLOTS || ctx->ring[slot].state == RING_SLOT_FREE) return NULL;
+    return ctx->ring[slot].buf;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_ring_commit(atagjs_ctx_t *ctx, int slot)
+{
+    if (ctx == NULL || slot < 0 || slot >= ATAGJS_RING_SLOTS || ctx->ring[slot].state != RING_SLOT_ACQUIRED) return -1;
+    ctx->ring[slot].state = RING_SLOT_COMMITTED;
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_bin *atagjs_ctx_ring_detect(atagjs_ctx_t *ctx, int slot)
+{
+    if (ctx == NULL || slot < 0 || slot >= ATAGJS_RING_SLOTS || ctx->ring[slot].state != RING_SLOT_COMMITTED) return NULL;
+    int n = ring_detect_records(ctx, &ctx->ring[slot]);
+    ctx->ring[slot].state = RING_SLOT_FREE;
+    update_heap_stats(ctx);
+    if (n < 0) return NULL;
+    auto_decimate_update(ctx);
+    return &ctx->det_bin;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_ring_release(atagjs_ctx_t *ctx, int slot)
+{
+    if (ctx == NULL || slot < 0 || slot >= ATAGJS_RING_SLOTS) return -1;
+    ctx->ring[slot].state = RING_SLOT_FREE;
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_tracking(atagjs_ctx_t *ctx, int enable, int keyframe_interval, float roi_padding)
+{
+    if (ctx == NULL) return -1;
+    ctx->tracking = enable;
+    tag_track_reset(&ctx->track, keyframe_interval, roi_padding);
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_fused_input(atagjs_ctx_t *ctx, int enable)
+{
+    if (ctx == NULL) return -1;
+    ctx->fused_input = enable;
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_auto_decimate(atagjs_ctx_t *ctx, double target_ms, float min_decimate, float max_decimate, int adapt_refine)
+{
+    if (ctx == NULL) return -1;
+    if (target_ms <= 0)
+    {
+        // back to the detector options
+        ctx->auto_decimate = 0;
+        ctx->td->quad_decimate = ctx->decimate_option;
+        ctx->td->refine_edges = ctx->refine_edges_option;
+        return 0;
+    }
+    if (min_decimate < 1 || max_decimate < min_decimate) return -1;
+    decimate_ctl_reset(&ctx->decimate_ctl, target_ms * 1000, min_decimate, max_decimate, adapt_refine);
+    decimate_ctl_start(&ctx->decimate_ctl, ctx->decimate_option, ctx->refine_edges_option);
+    ctx->td->quad_decimate = ctx->decimate_ctl.decimate;
+    ctx->td->refine_edges = ctx->decimate_ctl.refine_edges;
+    ctx->auto_decimate = 1;
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_deadline(atagjs_ctx_t *ctx, double deadline_ms)
+{
+    if (ctx == NULL) return -1;
+    ctx->deadline_us = (deadline_ms > 0) ? (int64_t)(deadline_ms * 1000) : 0;
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_motion_gate(atagjs_ctx_t *ctx, int enable, int threshold, int refresh_interval)
+{
+    if (ctx == NULL) return -1;
+    ctx->motion_gate = enable;
+    motion_gate_reset(&ctx->gate, threshold, refresh_interval);
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_heap_budget(atagjs_ctx_t *ctx, int max_width, int max_height, int max_tags)
+{
+    if (ctx == NULL || max_width < 0 || max_height < 0) return -1;
+    ctx->budget_pixels = 0;
+    ctx->budget_tags = 0;
+    ctx->budget_heap = 0;
+    ctx->budget_grown = 0;
+    if (max_width == 0 || max_height == 0) return 0;
+    if (max_tags < 1) return -1;
+
+    // records and json of the most tags, so the output does not grow either (allocated first, so they are not taken
+    // from the heap probed for the frames below)
+    t_atagjs_det_bin *bin = &ctx->det_bin;
+    if (max_tags > bin->alloc_len)
+    {
+        t_atagjs_det_record *records = realloc(bin->records, max_tags * sizeof(t_atagjs_det_record));
+        if (records == NULL) return -1;
+        bin->records = records;
+        bin->alloc_len = max_tags;
+    }
+    if (ctx->det_json.str == NULL && str_json_create(&ctx->det_json, STR_DET_LEN) != 0) return -1;
+    str_json_clear(&ctx->det_json);
+    if (str_json_reserve(&ctx->det_json, (size_t)max_tags * STR_DET_LEN) != 0) return -1;
+
+    // input buffers of the largest frame, and heap for its intermediates and the output of the most tags
+    ctx->budget_tags = max_tags;
+    int r = atagjs_ctx_reserve(ctx, max_width, max_height);
+    ctx->budget_tags = 0;
+    if (r != 0) return -1;
+
+    ctx->budget_pixels = (int64_t)max_width * max_height;
+    ctx->budget_tags = max_tags;
+    ctx->budget_heap = frame_heap_need(ctx, max_width, max_height, 1);
+    ctx->heap_size = heap_stats_size();
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ctx_set_frame_stats(atagjs_ctx_t *ctx, int enable)
+{
+    if (ctx == NULL) return -1;
+    ctx->frame_stats = enable;
+    return 0;
+}
+
+// see documentation in .h
+const t_atagjs_frame_stats *atagjs_ctx_get_frame_stats(atagjs_ctx_t *ctx)
+{
+    if (ctx == NULL) return NULL;
+    return &ctx->stats;
+}
+
+// see documentation in .h
+const t_atagjs_det_record *atagjs_det_bin_get(const t_atagjs_det_bin *bin, int i)
+{
+    if (bin == NULL || i < 0 || i >= bin->len) return NULL;
+    return &bin->records[i];
+}
+
+// see documentation in .h
+const t_atagjs_det_record *atagjs_det_batch_get(const t_atagjs_det_batch *batch, int frame, int *len)
+{
+    if (batch == NULL || frame < 0 || frame >= batch->nframes) return NULL;
+    if (len != NULL) *len = batch->offsets[frame + 1] - batch->offsets[frame];
+    return &batch->records[batch->offsets[frame]];
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_init()
+{
+    if (g_ctx != NULL) atagjs_ctx_destroy(g_ctx);
+    g_ctx = atagjs_ctx_create();
+    if (g_ctx == NULL) return -1;
+#ifdef ATAGJS_FIXED_HEAP
+    // fixed-heap build: the heap was sized for this budget (set by the Makefile)
+    if (atagjs_ctx_set_heap_budget(g_ctx, ATAGJS_MAX_WIDTH, ATAGJS_MAX_HEIGHT, ATAGJS_MAX_TAGS) != 0) return -1;
+#endif
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_destroy()
+{
+    atagjs_ctx_destroy(g_ctx);
+    g_ctx = NULL;
+    str_json_destroy(&g_err_json);
+    return 0;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_detector_options(float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions)
+{
+    return atagjs_ctx_set_detector_options(g_ctx, decimate, sigma, nthreads, refine_edges, max_detections, return_pose, return_solutions);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_max_threads()
+{
+    return ATAGJS_MAX_THREADS;
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_pose_info(double fx, double fy, double cx, double cy)
+{
+    return atagjs_ctx_set_pose_info(g_ctx, fx, fy, cx, cy);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_set_img_buffer(int width, int height, int stride)
+{
+    return atagjs_ctx_set_img_buffer(g_ctx, width, height, stride);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_set_rgba_buffer(int width, int height, int stride)
+{
+    return atagjs_ctx_set_rgba_buffer(g_ctx, width, height, stride);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_str_json *atagjs_detect_image(const uint8_t *pixels, int width, int height, int stride)
+{
+    if (g_ctx == NULL)
+    {
+        str_json_destroy(&g_err_json);
+        if (str_json_create(&g_err_json, 100) == 0) { // try to allocate string to return error string
+          str_json_printf(&g_err_json, fmt_error, "Detector not initizalized. (did you call init ?)");
+        }
+        return &g_err_json;
+    }
+    return atagjs_ctx_detect_image(g_ctx, pixels, width, height, stride);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_reserve(int width, int height)
+{
+    return atagjs_ctx_reserve(g_ctx, width, height);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_tag_size(int tagid, double size)
+{
+    return atagjs_ctx_set_tag_size(g_ctx, tagid, size);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_family_tag_size(int family, int tagid, double size)
+{
+    return atagjs_ctx_set_family_tag_size(g_ctx, family, tagid, size);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_families(int families, int bits_corrected)
+{
+    return atagjs_ctx_set_families(g_ctx, families, bits_corrected);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_str_json *atagjs_detect()
+{
+    if (g_ctx == NULL)
+    {
+        str_json_destroy(&g_err_json);
+        if (str_json_create(&g_err_json, 100) == 0) { // try to allocate string to return error string
+          str_json_printf(&g_err_json, fmt_error, "Detector not initizalized. (did you call init and set_img_buffer ?)");
+        }
+        return &g_err_json;
+    }
+    return atagjs_ctx_detect(g_ctx);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_bin *atagjs_detect_bin()
+{
+    return atagjs_ctx_detect_bin(g_ctx);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_set_batch_buffer(int nframes)
+{
+    return atagjs_ctx_set_batch_buffer(g_ctx, nframes);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_batch *atagjs_detect_batch(const uint8_t *frames, int nframes)
+{
+    return atagjs_ctx_detect_batch(g_ctx, frames, nframes);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ring_acquire(int width, int height, int stride, int rgba)
+{
+    return atagjs_ctx_ring_acquire(g_ctx, width, height, stride, rgba);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+uint8_t *atagjs_ring_buffer(int slot)
+{
+    return atagjs_ctx_ring_buffer(g_ctx, slot);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ring_commit(int slot)
+{
+    return atagjs_ctx_ring_commit(g_ctx, slot);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+t_atagjs_det_bin *atagjs_ring_detect(int slot)
+{
+    return atagjs_ctx_ring_detect(g_ctx, slot);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_ring_release(int slot)
+{
+    return atagjs_ctx_ring_release(g_ctx, slot);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_tracking(int enable, int keyframe_interval, float roi_padding)
+{
+    return atagjs_ctx_set_tracking(g_ctx, enable, keyframe_interval, roi_padding);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_fused_input(int enable)
+{
+    return atagjs_ctx_set_fused_input(g_ctx, enable);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_auto_decimate(double target_ms, float min_decimate, float max_decimate, int adapt_refine)
+{
+    return atagjs_ctx_set_auto_decimate(g_ctx, target_ms, min_decimate, max_decimate, adapt_refine);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_deadline(double deadline_ms)
+{
+    return atagjs_ctx_set_deadline(g_ctx, deadline_ms);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_motion_gate(int enable, int threshold, int refresh_interval)
+{
+    return atagjs_ctx_set_motion_gate(g_ctx, enable, threshold, refresh_interval);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_heap_budget(int max_width, int max_height, int max_tags)
+{
+    return atagjs_ctx_set_heap_budget(g_ctx, max_width, max_height, max_tags);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+int atagjs_set_frame_stats(int enable)
+{
+    return atagjs_ctx_set_frame_stats(g_ctx, enable);
+}
+
+// see documentation in .h
+EMSCRIPTEN_KEEPALIVE
+const t_atagjs_frame_stats *atagjs_get_frame_stats()
+{
+    return atagjs_ctx_get_frame_stats(g_ctx);
+}
+
+/**
+ * @brief Run the detector on the context image buffer and fill the context binary records, including pose if requested
+ *
+ * @param ctx detector context; its records are reallocated only when more are needed
+ *
+ * @return number of records; -1 if detector is not initialized; -2 on allocation failure
+ */
+static int detect_records(atagjs_ctx_t *ctx)
+{
+    t_atagjs_det_bin *bin = &ctx->det_bin;
+    bin->len = 0;
+    bin->flags = 0;
+    memset(&ctx->stats, 0, sizeof(t_atagjs_frame_stats));
+    start_deadline(ctx);
+
+    if (ctx->families == 0 || ctx->td == NULL || ctx->img_buf == NULL) return -1;
+
+    // an unchanged frame returns the records of the last frame detected (still in the context)
+    if (ctx->motion_gate && gate_frame(ctx)) return bin->len;
+
+    // with fused input, full-resolution pixels are converted only where the detector runs (needs an integer decimation
+    // the fused conversion can replicate, and no blur, which would need the whole decimated image)
+    ctx->lazy_gray = ctx->input_rgba && ctx->fused_input && ctx->td->quad_decimate >= 2 && ctx->td->quad_sigma == 0;
+    if (ctx->input_rgba && !ctx->lazy_gray) convert_rgba(ctx, NULL);
+
+    image_u8_t im = {
+        .width = ctx->width,
+        .height = ctx->height,
+        .stride = ctx->stride,
+        .buf = ctx->img_buf};
+
+    int n = detect_image_records(ctx, &im);
+    if (ctx->motion_gate)
+    {
+        // the frame is the reference of the next ones, unless its results are partial
+        if (n >= 0 && !ctx->stats.truncated) motion_gate_commit(&ctx->gate, ctx->width, ctx->height);
+        else motion_gate_invalidate(&ctx->gate);
+        ctx->gate_len = n;
+    }
+    return n;
+}
+
+/**
+ * @brief Run the detector on an image and fill the context binary records, including pose if requested; adds to the
+ *        context frame stats
+ *
+ * @param ctx detector context; its records are reallocated only when more are needed, and its arena is reset
+ * @param im the image
+ *
+ * @return number of records; -2 on allocation failure; -3 if the frame does not fit the heap budget
+ */
+static int detect_image_records(atagjs_ctx_t *ctx, image_u8_t *im)
+{
+    t_atagjs_det_bin *bin = &ctx->det_bin;
+    frame_arena_reset(&ctx->arena); // release the temporaries of the last frame
+    ctx->stats.quad_decimate = ctx->td->quad_decimate;
+    ctx->stats.refine_edges = ctx->td->refine_edges;
+
+    if (ctx->budget_pixels > 0)
+    {
+        // heap budget: refuse the frame, rather than running out of heap halfway through it. The heap of the largest
+        // frame was probed when the budget was set, and the frame needs no more than that (it is no larger); it is
+        // probed again only if the context grew its buffers since. If it no longer fits, this frame's heap is probed
+        size_t need = frame_heap_need(ctx, im->width, im->height, ctx->td->quad_decimate);
+        if (ctx->budget_grown && heap_stats_probe(ctx->budget_heap) == 0) ctx->budget_grown = 0;
+        if (over_budget(ctx, im->width, im->height) || (ctx->budget_grown && heap_stats_probe(need) != 0))
+        {
+            ctx->stats.over_budget = 1;
+            return -3;
+        }
+    }
+
+    int64_t start = utime_now();
+    zarray_t *detections = detect_tags(ctx, im);
+    ctx->stats.detect_us = utime_now() - start;
+
+    int n = zarray_size(detections);
+
+    // limit detections returned according to max_detections (and the heap budget)
+    if (ctx->max_detections > 0 && ctx->max_detections < n) n = ctx->max_detections;
+    if (ctx->budget_tags > 0 && ctx->budget_tags < n) n = ctx->budget_tags;
+
+    if (n > bin->alloc_len) {
+        t_atagjs_det_record *records = realloc(bin->records, n * sizeof(t_atagjs_det_record));
+        if (records == NULL) {
+            release_detections(ctx, detections);
+            return -2;
+        }
+        bin->records = records;
+        bin->alloc_len = n;
+        ctx->stats.nallocs++;
+    }
+
+    start = utime_now();
+    if (ctx->return_pose == ATAGJS_POSE_FULL) tag_pose_begin_frame(&ctx->pose_cache);
+    for (int i = 0; i < n; i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(detections, i, &det);
+
+        t_atagjs_det_record *rec = &bin->records[i];
+        memset(rec, 0, sizeof(t_atagjs_det_record));
+        rec->id = det->id;
+        rec->hamming = det->hamming;
+        rec->decision_margin = det->decision_margin;
+        for (int j = 0; j < 4; j++) {
+            rec->corners[j][0] = det->p[j][0];
+            rec->corners[j][1] = det->p[j][1];
+        }
+        rec->center[0] = det->c[0];
+        rec->center[1] = det->c[1];
+        rec->size = tagsize_from_det(ctx, det, &rec->family); // size of the tag is determined from its family and id
+
+        if (ctx->return_pose != ATAGJS_POSE_NONE && !check_deadline(ctx))
+        {
+            // return pose (unless the deadline expired) ..
+            apriltag_detection_info_t info = ctx->det_pose_info;
+            info.det = det;
+            info.tagsize = rec->size;
+            if (ctx->return_pose == ATAGJS_POSE_FAST) estimate_tag_pose_fast(&info, rec);
+            else estimate_tag_pose_with_solution(ctx, &info, rec);
+        }
+    }
+    bin->len = n;
+    bin->flags = ctx->stats.truncated ? ATAGJS_DET_BIN_TRUNCATED : 0;
+    ctx->stats.pose_us = (ctx->return_pose != ATAGJS_POSE_NONE) ? utime_now() - start : 0;
+    ctx->stats.ndetections = n;
+    ctx->stats.nallocs += ctx->arena.nallocs;
+
+    release_detections(ctx, detections);
+
+    return n;
+}
+
+/**
+ * @brief The detections array of a context, empty; created on first use (the array of the tracking and region scans,
+ *        so they do not create one per frame)
+ *
+ * @param ctx detector context
+ *
+ * @return the array; release with release_detections()
+ */
+static zarray_t *ctx_detections(atagjs_ctx_t *ctx)
+{
+    if (ctx->detections == NULL) ctx->detections = zarray_create(sizeof(apriltag_detection_t*));
+    return ctx->detections;
+}
+
+/**
+ * @brief Destroy the detections of a frame; the array is cleared if it is the one of the context (counted in the frame
+ *        stats when it grew), and destroyed otherwise (created by the detector)
+ *
+ * @param ctx detector context
+ * @param detections the detections
+ */
+static void release_detections(atagjs_ctx_t *ctx, zarray_t *detections)
+{
+    if (detections != ctx->detections)
+    {
+        apriltag_detections_destroy(detections);
+        return;
+    }
+    for (int i = 0; i < zarray_size(detections); i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(detections, i, &det);
+        apriltag_detection_destroy(det);
+    }
+    zarray_clear(detections);
+    if (detections->alloc != ctx->detections_alloc) ctx->stats.nallocs++;
+    ctx->detections_alloc = detections->alloc;
+}
+
+/**
+ * @brief Detect tags in a frame ring slot and fill the context binary records
+ *
+ * The slot is the input of the context for this frame: the context image buffers are set aside (not released) while
+ * the detector runs on the slot, and restored after, so set_img_buffer()/detect() keep working alongside the ring.
+ * Tracking state is shared with detect()
+ *
+ * @param ctx detector context
+ * @param slot a committed slot
+ *
+ * @return number of records; < 0 on error (see detect_records())
+ */
+static int ring_detect_records(atagjs_ctx_t *ctx, t_ring_slot *slot)
+{
+    uint8_t *img_buf = ctx->img_buf, *rgba_buf = ctx->rgba_buf;
+    int width = ctx->width, height = ctx->height, stride = ctx->stride;
+    int rgba_stride = ctx->rgba_stride, input_rgba = ctx->input_rgba;
+    int nallocs = 0;
+
+    ctx->width = slot->width;
+    ctx->height = slot->height;
+    if (slot->rgba)
+    {
+        // RGBA slots are converted into a grayscale buffer of their size
+        int grown = grow_buf(&ctx->ring_gray, &ctx->ring_gray_alloc, (size_t)slot->width * slot->height);
+        if (grown > 0) nallocs++;
+        ctx->img_buf = ctx->ring_gray;
+        ctx->stride = slot->width;
+        ctx->rgba_buf = slot->buf;
+        ctx->rgba_stride = slot->stride;
+        ctx->input_rgba = 1;
+    }
+    else
+    {
+        ctx->img_buf = slot->buf;
+        ctx->stride = slot->stride;
+        ctx->input_rgba = 0;
+    }
+
+    int n = detect_records(ctx);
+    ctx->stats.nallocs += nallocs; // detect_records() clears the stats
+
+    ctx->img_buf = img_buf;
+    ctx->rgba_buf = rgba_buf;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->stride = stride;
+    ctx->rgba_stride = rgba_stride;
+    ctx->input_rgba = input_rgba;
+    return n;
+}
+
+/**
+ * @brief Create the batch workers of a context (reusing the ones created by previous batches) and give them the options
+ *        of the context
+ *
+ * @param ctx the batch context
+ * @param nworkers number of workers needed
+ *
+ * @return 0 on success; -1 on allocation failure
+ */
+static int batch_workers_create(atagjs_ctx_t *ctx, int nworkers)
+{
+    if (nworkers > ctx->batch_nworkers)
+    {
+        t_batch_worker *workers = realloc(ctx->batch_workers, nworkers * sizeof(t_batch_worker));
+        if (workers == NULL) return -1;
+        ctx->batch_workers = workers;
+        for (int i = ctx->batch_nworkers; i < nworkers; i++)
+        {
+            memset(&workers[i], 0, sizeof(t_batch_worker));
+            workers[i].out = (t_atagjs_det_bin) ATAGJS_DET_BIN_INITIALIZER;
+            workers[i].ctx = atagjs_ctx_create();
+            if (workers[i].ctx == NULL) return -1;
+            ctx->batch_nworkers = i + 1;
+        }
+    }
+
+    for (int i = 0; i < nworkers; i++)
+    {
+        atagjs_ctx_t *w = ctx->batch_workers[i].ctx;
+        w->td->quad_decimate = ctx->td->quad_decimate;
+        w->td->quad_sigma = ctx->td->quad_sigma;
+        w->td->refine_edges = ctx->td->refine_edges;
+        w->td->nthreads = 1;
+        w->max_detections = ctx->max_detections;
+        w->return_pose = ctx->return_pose;
+        w->return_solutions = ctx->return_solutions;
+        w->frame_stats = ctx->frame_stats;
+        w->det_pose_info = ctx->det_pose_info;
+        w->budget_pixels = ctx->budget_pixels;
+        w->budget_tags = ctx->budget_tags;
+        w->budget_heap = ctx->budget_heap;
+        w->budget_grown = ctx->budget_grown;
+        if (tag_size_copy(&w->tag_sizes, &ctx->tag_sizes) != 0) return -1;
+        if (atagjs_ctx_set_families(w, ctx->families, ctx->bits_corrected) != 0) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Process frames of a batch until there are none left; appends the records of each frame to the worker output
+ *
+ * @param arg the worker (t_batch_worker*)
+ *
+ * @return NULL
+ */
+static void *batch_worker_run(void *arg)
+{
+    t_batch_worker *worker = (t_batch_worker *)arg;
+    struct batch_job *job = worker->job;
+    atagjs_ctx_t *ctx = job->ctx;
+    atagjs_ctx_t *wctx = worker->ctx;
+    t_atagjs_det_bin *out = &worker->out;
+
+    out->len = 0;
+    memset(&worker->stats, 0, sizeof(t_atagjs_frame_stats));
+
+    int i;
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->nframes)
+    {
+        image_u8_t im = {
+            .width = ctx->width,
+            .height = ctx->height,
+            .stride = ctx->stride,
+            .buf = (uint8_t *)job->frames + i * job->frame_size};
+
+        t_batch_frame *f = &ctx->batch_frames[i];
+        f->worker = worker - ctx->batch_workers;
+        f->start = out->len;
+
+        memset(&wctx->stats, 0, sizeof(t_atagjs_frame_stats));
+        tag_pose_cache_reset(&wctx->pose_cache); // workers take frames out of order: the last one is not the previous frame
+        f->len = detect_image_records(wctx, &im);
+        add_frame_stats(&worker->stats, &wctx->stats); // frames without detections (or that failed) took time too
+        if (f->len <= 0) continue;
+
+        if (out->len + f->len > out->alloc_len)
+        {
+            int alloc_len = (out->len + f->len) * 2;
+            t_atagjs_det_record *records = realloc(out->records, alloc_len * sizeof(t_atagjs_det_record));
+            if (records == NULL)
+            {
+                f->len = -2;
+                continue;
+            }
+            out->records = records;
+            out->alloc_len = alloc_len;
+            worker->stats.nallocs++;
+        }
+        memcpy(out->records + out->len, wctx->det_bin.records, f->len * sizeof(t_atagjs_det_record));
+        out->len += f->len;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add frame stats to a sum of frame stats
+ */
+static void add_frame_stats(t_atagjs_frame_stats *sum, const t_atagjs_frame_stats *stats)
+{
+    sum->detect_us += stats->detect_us;
+    sum->decimate_us += stats->decimate_us;
+    sum->blur_us += stats->blur_us;
+    sum->threshold_us += stats->threshold_us;
+    sum->unionfind_us += stats->unionfind_us;
+    sum->clusters_us += stats->clusters_us;
+    sum->quad_fit_us += stats->quad_fit_us;
+    sum->decode_us += stats->decode_us;
+    sum->other_us += stats->other_us;
+    sum->pose_us += stats->pose_us;
+    sum->json_us += stats->json_us;
+    sum->convert_us += stats->convert_us;
+    sum->nedges += stats->nedges;
+    sum->nsegments += stats->nsegments;
+    sum->nquads += stats->nquads;
+    sum->ndecode_attempts += stats->ndecode_attempts;
+    sum->nrejected += stats->nrejected;
+    sum->ndetections += stats->ndetections;
+    sum->nrois += stats->nrois;
+    sum->npose_iters += stats->npose_iters;
+    sum->nallocs += stats->nallocs;
+    sum->quad_decimate = stats->quad_decimate; // settings; the same for all frames of a batch
+    sum->refine_edges = stats->refine_edges;
+    sum->truncated |= stats->truncated;
+    sum->over_budget |= stats->over_budget;
+}
+
+/**
+ * @brief Creates/changes size of the grayscale image buffer of a context; the buffer is reused while the image fits
+ *
+ * @return the pointer to the image buffer; NULL on failure
+ */
+static uint8_t *alloc_img_buf(atagjs_ctx_t *ctx, int width, int height, int stride)
+{
+    int w = (stride < width) ? width : stride; // stride should always be >= width...
+    if (over_budget(ctx, w, height)) return NULL;
+    if (grow_buf(&ctx->img_buf, &ctx->img_alloc, (size_t)height * w) < 0) return NULL;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->stride = stride;
+    return ctx->img_buf;
+}
+
+/**
+ * @brief Make sure a buffer holds at least size bytes; buffers only grow, so frames of the same (or a smaller) size
+ *        reuse the memory of the largest one
+ *
+ * @param buf the buffer (NULL if not allocated yet)
+ * @param alloc its allocated size
+ * @param size bytes needed
+ *
+ * @return 1 if the buffer was allocated (contents are zero); 0 if it already fit (contents are kept); -1 on failure
+ *         (the buffer is released)
+ */
+static int grow_buf(uint8_t **buf, size_t *alloc, size_t size)
+{
+    if (*buf != NULL && size <= *alloc) return 0;
+    free(*buf);
+    *buf = (uint8_t *)calloc(size > 0 ? size : 1, sizeof(uint8_t));
+    *alloc = (*buf != NULL) ? size : 0;
+    return (*buf != NULL) ? 1 : -1;
+}
+
+/**
+ * @brief Run the detector on a region of an image and append its detections, in full image coordinates
+ *
+ * @param ctx detector context
+ * @param im the full image
+ * @param roi the region
+ * @param detections where to append the detections; tags already in detections are discarded
+ */
+static void detect_roi(atagjs_ctx_t *ctx, image_u8_t *im, const t_tag_roi *roi, zarray_t *detections)
+{
+    if (ctx->lazy_gray) convert_rgba(ctx, roi);
+
+    // a view of the region; no copy
+    image_u8_t im_roi = {
+        .width = roi->x1 - roi->x0,
+        .height = roi->y1 - roi->y0,
+        .stride = im->stride,
+        .buf = im->buf + roi->y0 * im->stride + roi->x0};
+
+    zarray_t *roi_detections = run_detector(ctx, &im_roi);
+
+    for (int i = 0; i < zarray_size(roi_detections); i++)
+    {
+        apriltag_detection_t *det;
+        zarray_get(roi_detections, i, &det);
+
+        int dup = 0;
+        for (int j = 0; j < zarray_size(detections) && !dup; j++)
+        {
+            apriltag_detection_t *other;
+            zarray_get(detections, j, &other);
+            dup = (other->id == det->id && other->family == det->family);
+        }
+        if (dup)
+        {
+            apriltag_detection_destroy(det);
+            continue;
+        }
+
+        // translate to full image coordinates; H maps tag coordinates to image coordinates, so H' = T*H
+        for (int j = 0; j < 4; j++)
+        {
+            det->p[j][0] += roi->x0;
+            det->p[j][1] += roi->y0;
+        }
+        det->c[0] += roi->x0;
+        det->c[1] += roi->y0;
+        for (int j = 0; j < 3; j++)
+        {
+            MATD_EL(det->H, 0, j) += roi->x0 * MATD_EL(det->H, 2, j);
+            MATD_EL(det->H, 1, j) += roi->y0 * MATD_EL(det->H, 2, j);
+        }
+        zarray_add(detections, &det);
+    }
+    zarray_destroy(roi_detections); // detections were moved or destroyed
+}
+
+/**
+ * @brief Detect tags in an image; when tracking, search the regions around the tracked tags first and fall back to a
+ *        full-frame scan on keyframes or when a tracked tag is not found
+ *
+ * @param ctx detector context
+ * @param im the image
+ *
+ * @return detections (apriltag_detection_t*); caller must release with release_detections()
+ */
+static zarray_t *detect_tags(atagjs_ctx_t *ctx, image_u8_t *im)
+{
+    if (!ctx->tracking) return detect_full(ctx, im);
+
+    t_tag_track *tt = &ctx->track;
+    if (!tag_track_begin_frame(tt))
+    {
+        t_tag_roi rois[TAG_TRACK_MAX];
+        int nrois = tag_track_rois(tt, im->width, im->height, rois);
+
+        zarray_t *detections = ctx_detections(ctx);
+        for (int i = 0; i < nrois && !check_deadline(ctx); i++) detect_roi(ctx, im, &rois[i], detections);
+
+        // with the deadline expired, what was found (a full-frame scan would take longer still)
+        if (ctx->stats.truncated || tag_track_all_found(tt, detections))
+        {
+            tag_track_update(tt, detections, 0);
+            ctx->stats.nrois = nrois;
+            return detections;
+        }
+        // a tag was lost; scan the full frame
+        release_detections(ctx, detections);
+    }
+
+    zarray_t *detections = detect_full(ctx, im);
+    tag_track_update(tt, detections, 1);
+    return detections;
+}
+
+/**
+ * @brief Convert the RGBA input of a context to grayscale, into the context image buffer
+ *
+ * @param ctx detector context
+ * @param roi region to convert; NULL converts the full frame
+ */
+static void convert_rgba(atagjs_ctx_t *ctx, const t_tag_roi *roi)
+{
+    t_tag_roi full = { .x0 = 0, .y0 = 0, .x1 = ctx->width, .y1 = ctx->height };
+    if (roi == NULL) roi = &full;
+
+    int64_t start = utime_now();
+    img_rgba_to_gray(ctx->rgba_buf + ((size_t)roi->y0 * ctx->rgba_stride + roi->x0) * 4, ctx->rgba_stride,
+                     roi->x1 - roi->x0, roi->y1 - roi->y0, ctx->img_buf + roi->y0 * ctx->stride + roi->x0, ctx->stride);
+    ctx->stats.convert_us += utime_now() - start;
+}
+
+/**
+ * @brief Detect tags in the full image
+ *
+ * The detector cannot be stopped once it runs on the full frame; with a deadline, when the scan is predicted (from the
+ * time of the last one) to overrun it, candidates are found first and decoded by rank until the deadline instead (see
+ * detect_ranked()). Needs the decimated image the detector would threshold: no blur
+ *
+ * @param ctx detector context
+ * @param im the image
+ *
+ * @return detections (apriltag_detection_t*); caller must release with release_detections()
+ */
+static zarray_t *detect_full(atagjs_ctx_t *ctx, image_u8_t *im)
+{
+    apriltag_detector_t *td = ctx->td;
+    double d = (td->quad_decimate > 1) ? td->quad_decimate : 1;
+    double pixels = (im->width / d) * (im->height / d);
+    int ranked = ctx->frame_deadline > 0 && td->quad_sigma == 0 &&
+                 utime_now() + ctx->scan_us_per_px * pixels > ctx->frame_deadline;
+
+    int64_t start = utime_now();
+    zarray_t *detections = scan_frame(ctx, im, ranked);
+
+    // a ranked scan that was not cut short took about as long as the full-frame scan would (same stages, and the
+    // detector again around each candidate): an upper bound, so the next frame goes back to the full-frame scan once
+    // the clutter is gone
+    if (!ctx->stats.truncated) ctx->scan_us_per_px = (utime_now() - start) / pixels;
+    return detections;
+}
+
+/**
+ * @brief Scan the full image for tags
+ *
+ * With fused input, the RGBA input is converted and decimated in one pass, candidate quads are found in the decimated
+ * image (as the detector does) and the detector runs only on regions around the candidates, converted to grayscale at
+ * full resolution on demand. With too many candidates (or large regions), the full frame is converted instead.
+ * When ranked, candidates are also found first, and decoded by rank until the deadline (see detect_ranked())
+ *
+ * @param ctx detector context
+ * @param im the image
+ * @param ranked 1 to decode the candidates by rank until the deadline; 0 otherwise
+ *
+ * @return detections (apriltag_detection_t*); caller must release with release_detections()
+ */
+static zarray_t *scan_frame(atagjs_ctx_t *ctx, image_u8_t *im, int ranked)
+{
+    apriltag_detector_t *td = ctx->td;
+    if (!ctx->lazy_gray && !ranked) return run_detector(ctx, im);
+
+    image_u8_t dec = *im;
+    image_u8_t *dec_im = NULL;
+    if (ctx->lazy_gray)
+    {
+        int factor = (int)td->quad_decimate;
+        dec = (image_u8_t) {
+            .width = IMG_DECIMATED_SIZE(im->width, factor),
+            .height = IMG_DECIMATED_SIZE(im->height, factor),
+            .stride = IMG_DECIMATED_SIZE(im->width, factor)};
+        int grown = grow_buf(&ctx->dec_buf, &ctx->dec_alloc, (size_t)dec.stride * dec.height);
+        if (grown < 0)
+        {
+            convert_rgba(ctx, NULL);
+            ctx->lazy_gray = 0;
+            return run_detector(ctx, im);
+        }
+        if (grown > 0) ctx->stats.nallocs++;
+        dec.buf = ctx->dec_buf;
+
+        int64_t start = utime_now();
+        img_rgba_decimate_to_gray(ctx->rgba_buf, ctx->rgba_stride, im->width, im->height, factor, dec.buf, dec.stride);
+        ctx->stats.convert_us += utime_now() - start;
+    }
+    else if (td->quad_decimate > 1)
+    {
+        // as the detector decimates
+        dec_im = image_u8_decimate(im, td->quad_decimate);
+        if (dec_im == NULL) return run_detector(ctx, im);
+        dec = *dec_im;
+    }
+
+    // the detector creates its worker pool in apriltag_detector_detect(); we might get here first
+    if (td->wp == NULL || td->nthreads != workerpool_get_nthreads(td->wp))
+    {
+        workerpool_destroy(td->wp);
+        td->wp = workerpool_create(td->nthreads);
+    }
+    timeprofile_clear(td->tp);
+    zarray_t *quads = apriltag_quad_thresh(td, &dec);
+    if (ctx->frame_stats) add_stage_times(ctx);
+
+    if (ranked)
+    {
+        zarray_t *detections = detect_ranked(ctx, im, &dec, quads);
+        if (dec_im != NULL) image_u8_destroy(dec_im);
+        return detections;
+    }
+
+    // regions around the candidates, in full image coordinates
+    int nquads = zarray_size(quads);
+    int n = 0;
+    for (int i = 0; i < nquads; i++)
+    {
+        struct quad *q;
+        zarray_get_volatile(quads, i, &q);
+        if (nquads <= FUSED_MAX_ROIS && quad_roi(td, q, im, &ctx->fused_rois[n])) n++;
+    }
+    destroy_quads(quads);
+    n = tag_track_merge_rois(ctx->fused_rois, n);
+
+    double area = 0;
+    for (int i = 0; i < n; i++)
+        area += (double)(ctx->fused_rois[i].x1 - ctx->fused_rois[i].x0) * (ctx->fused_rois[i].y1 - ctx->fused_rois[i].y0);
+    if (nquads > FUSED_MAX_ROIS || area > 0.5 * im->width * im->height)
+    {
+        // cheaper to scan the full frame
+        convert_rgba(ctx, NULL);
+        ctx->lazy_gray = 0;
+        return run_detector(ctx, im);
+    }
+
+    zarray_t *detections = ctx_detections(ctx);
+    for (int i = 0; i < n; i++) detect_roi(ctx, im, &ctx->fused_rois[i], detections);
+    ctx->stats.nrois += n;
+    return detections;
+}
+
+/**
+ * @brief Detect tags around candidate quads, highest ranked (size and edge contrast) first, until the frame deadline
+ *
+ * Each candidate gets the detector on a padded region around it (refinement and decoding, as in a full-frame scan),
+ * unless it is inside a region searched already (e.g. the quad of the inner edge of a tag border); when the deadline
+ * expires, the candidates left are dropped and the frame is flagged as truncated
+ *
+ * @param ctx detector context
+ * @param im the image
+ * @param dec the image the candidates were found in (decimated)
+ * @param quads the candidates (in dec coordinates); destroyed
+ *
+ * @return detections (apriltag_detection_t*); caller must release with release_detections()
+ */
+static zarray_t *detect_ranked(atagjs_ctx_t *ctx, image_u8_t *im, const image_u8_t *dec, zarray_t *quads)
+{
+    zarray_t *detections = ctx_detections(ctx);
+    int nquads = zarray_size(quads);
+    t_quad_rank *ranks = (nquads > 0) ? frame_arena_alloc(&ctx->arena, nquads * sizeof(t_quad_rank)) : NULL;
+    t_tag_roi *rois = (nquads > 0) ? frame_arena_alloc(&ctx->arena, nquads * sizeof(t_tag_roi)) : NULL;
+    if (ranks == NULL || rois == NULL)
+    {
+        destroy_quads(quads);
+        return detections;
+    }
+
+    for (int i = 0; i < nquads; i++)
+    {
+        struct quad *q;
+        zarray_get_volatile(quads, i, &q);
+        ranks[i] = (t_quad_rank) { .score = quad_rank_score(dec, (const float (*)[2])q->p), .index = i };
+    }
+    quad_rank_sort(ranks, nquads);
+
+    int n = 0;
+    for (int i = 0; i < nquads && !check_deadline(ctx); i++)
+    {
+        struct quad *q;
+        zarray_get_volatile(quads, ranks[i].index, &q);
+        t_tag_roi r;
+        if (!quad_roi(ctx->td, q, im, &r)) continue;
+
+        int cx = (r.x0 + r.x1) / 2, cy = (r.y0 + r.y1) / 2, covered = 0;
+        for (int j = 0; j < n && !covered; j++)
+            covered = (cx >= rois[j].x0 && cx < rois[j].x1 && cy >= rois[j].y0 && cy < rois[j].y1);
+        if (covered) continue;
+
+        detect_roi(ctx, im, &r, detections);
+        rois[n++] = r;
+    }
+    ctx->stats.nrois += n;
+    destroy_quads(quads);
+    return detections;
+}
+
+/**
+ * @brief Padded region around a candidate quad, in full image coordinates
+ *
+ * @param td the detector (its decimation)
+ * @param q the candidate, in decimated image coordinates
+ * @param im the full image (its size)
+ * @param roi where to write the region
+ *
+ * @return 1 if the region is not empty; 0 otherwise
+ */
+static int quad_roi(const apriltag_detector_t *td, const struct quad *q, const image_u8_t *im, t_tag_roi *roi)
+{
+    double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL;
+    for (int j = 0; j < 4; j++)
+    {
+        // same as the detector does to get the corners in the full image
+        double x = (td->quad_decimate > 1) ? (q->p[j][0] - 0.5) * td->quad_decimate + 0.5 : q->p[j][0];
+        double y = (td->quad_decimate > 1) ? (q->p[j][1] - 0.5) * td->quad_decimate + 0.5 : q->p[j][1];
+        xmin = fmin(xmin, x);
+        xmax = fmax(xmax, x);
+        ymin = fmin(ymin, y);
+        ymax = fmax(ymax, y);
+    }
+    double pad = fmax(fmax(xmax - xmin, ymax - ymin) * FUSED_ROI_PADDING, TAG_TRACK_MIN_PAD);
+    *roi = (t_tag_roi) {
+        .x0 = (int)fmax(floor(xmin - pad), 0), .y0 = (int)fmax(floor(ymin - pad), 0),
+        .x1 = (int)fmin(ceil(xmax + pad), im->width), .y1 = (int)fmin(ceil(ymax + pad), im->height)};
+    return roi->x1 > roi->x0 && roi->y1 > roi->y0;
+}
+
+/**
+ * @brief Destroy the candidate quads returned by apriltag_quad_thresh()
+ *
+ * @param quads the candidates
+ */
+static void destroy_quads(zarray_t *quads)
+{
+    for (int i = 0; i < zarray_size(quads); i++)
+    {
+        struct quad *q;
+        zarray_get_volatile(quads, i, &q);
+        matd_destroy(q->H);
+        matd_destroy(q->Hinv);
+    }
+    zarray_destroy(quads);
+}
+
+/**
+ * @brief Run the apriltag detector; when enabled, add its stage times (from the detector timeprofile) and pipeline
+ *        counters to the frame stats
+ *
+ * @param ctx detector context
+ * @param im the image
+ *
+ * @return detections (apriltag_detection_t*); caller must release with release_detections()
+ */
+static zarray_t *run_detector(atagjs_ctx_t *ctx, image_u8_t *im)
+{
+    zarray_t *detections = apriltag_detector_detect(ctx->td, im);
+    if (!ctx->frame_stats) return detections;
+
+    add_stage_times(ctx);
+
+    t_atagjs_frame_stats *stats = &ctx->stats;
+    int attempts = ctx->td->nquads * zarray_size(ctx->td->tag_families);
+    stats->nedges += ctx->td->nedges;
+    stats->nsegments += ctx->td->nsegments;
+    stats->nquads += ctx->td->nquads;
+    stats->ndecode_attempts += attempts;
+    stats->nrejected += attempts - zarray_size(detections);
+
+    return detections;
+}
+
+/**
+ * @brief Add the stage times of the last detector run (from the detector timeprofile) to the frame stats
+ *
+ * @param ctx detector context
+ */
+static void add_stage_times(atagjs_ctx_t *ctx)
+{
+    t_atagjs_frame_stats *stats = &ctx->stats;
+    timeprofile_t *tp = ctx->td->tp;
+
+    int64_t last = tp->utime;
+    for (int i = 0; i < zarray_size(tp->stamps); i++)
+    {
+        struct timeprofile_entry *e;
+        zarray_get_volatile(tp->stamps, i, &e);
+        double dt = e->utime - last;
+        last = e->utime;
+
+        // stage names as stamped by apriltag_detector_detect() and apriltag_quad_thresh()
+        if (strcmp(e->name, "decimate") == 0) stats->decimate_us += dt;
+        else if (strcmp(e->name, "blur/sharp") == 0) stats->blur_us += dt;
+        else if (strcmp(e->name, "threshold") == 0) stats->threshold_us += dt;
+        else if (strcmp(e->name, "unionfind") == 0) stats->unionfind_us += dt;
+        else if (strcmp(e->name, "make clusters") == 0) stats->clusters_us += dt;
+        else if (strcmp(e->name, "fit quads to clusters") == 0 || strcmp(e->name, "quads") == 0) stats->quad_fit_us += dt;
+        else if (strcmp(e->name, "decode+refinement") == 0) stats->decode_us += dt;
+        else stats->other_us += dt;
+    }
+}
+
+/**
+ * @brief Copy a pose into record arrays (column major R, as in the json output)
+ */
+static void pose_to_record(apriltag_pose_t *pose, double *R, double *t)
+{
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) R[c*3+r] = matd_get(pose->R, r, c);
+        t[c] = matd_get(pose->t, c, 0);
+    }
+}
+
+/**
+ * Our implementation of estimate tag pose to return the solution selected (1=homography method; 2=potential second local minima; see: apriltag/apriltag_pose.h)
+ * Writes the selected pose and, if return_solutions is set, the alternative solution into the detection record. Starts
+ * from the pose of the tag in the last frame, if there is one (see tag_pose.h)
+ *
+ * @param ctx detector context
+ * @param info detection info
+ * @param rec record where to write the pose (R, t, e) and alternative solution (asol_R, asol_t, asol_e)
+ *
+ * return the object-space error of the pose estimation
+ */
+static double estimate_tag_pose_with_solution(atagjs_ctx_t *ctx, apriltag_detection_info_t *info, t_atagjs_det_record *rec)
+{
+    double err1, err2;
+    apriltag_pose_t pose1, pose2; // in the context arena
+    int iters = tag_pose_estimate(&ctx->pose_cache, &ctx->arena, info, &err1, &pose1, &err2, &pose2);
+    if (iters < 0) return HUGE_VAL; // no pose
+    ctx->stats.npose_iters += iters;
+
+    rec->flags |= ATAGJS_DET_REC_POSE;
+    rec->pose_mode = ATAGJS_POSE_FULL;
+    if (err1 <= err2)
+    {
+        pose_to_record(&pose1, rec->R, rec->t);
+        rec->e = err1;
+        if (pose2.R != NULL && pose2.t !=  NULL) {
+            // return other alternative solution
+            pose_to_record(&pose2, rec->asol_R, rec->asol_t);
+            rec->asol_e = err2;
+            rec->flags |= ATAGJS_DET_REC_ASOL_DISTINCT;
+        } else { // return the same solution
+            pose_to_record(&pose1, rec->asol_R, rec->asol_t);
+            rec->asol_e = err1;
+        }
+    }
+    else
+    {
+        pose_to_record(&pose2, rec->R, rec->t);
+        rec->e = err2;
+        // return other alternative solution
+        pose_to_record(&pose1, rec->asol_R, rec->asol_t);
+        rec->asol_e = err1;
+        rec->flags |= ATAGJS_DET_REC_ASOL_DISTINCT;
+    }
+
+    if (ctx->return_solutions) rec->flags |= ATAGJS_DET_REC_ASOL; // alternative solution is returned only if requested
+    return rec->e;
+}
+
+/**
+ * Closed-form pose from the detection homography (see tag_pose_estimate_fast()); writes the pose into the detection record
+ *
+ * @param info detection info
+ * @param rec record where to write the pose (R, t, e)
+ *
+ * return the object-space error of the pose
+ */
+static double estimate_tag_pose_fast(apriltag_detection_info_t *info, t_atagjs_det_record *rec)
+{
+    apriltag_pose_t pose;
+    rec->e = tag_pose_estimate_fast(info, &pose);
+    pose_to_record(&pose, rec->R, rec->t);
+    rec->flags |= ATAGJS_DET_REC_POSE;
+    rec->pose_mode = ATAGJS_POSE_FAST;
+
+    matd_destroy(pose.R);
+    matd_destroy(pose.t);
+    return rec->e;
+}
+
+/**
+ * @brief Append a json array of doubles
+ */
+static void json_doubles(t_str_json *str_json, const double *v, int n, int decimals)
+{
+    str_json_concat(str_json, "[");
+    for (int i = 0; i < n; i++)
+    {
+        if (i > 0) str_json_concat(str_json, ",");
+        str_json_fixed(str_json, v[i], decimals);
+    }
+    str_json_concat(str_json, "]");
+}
+
+/**
+ * @brief Append a json rotation matrix (column major; an array of three columns)
+ */
+static void json_rotation(t_str_json *str_json, const double *R)
+{
+    str_json_concat(str_json, "[");
+    for (int c = 0; c < 3; c++)
+    {
+        if (c > 0) str_json_concat(str_json, ",");
+        json_doubles(str_json, &R[c*3], 3, JSON_POSE_DECIMALS);
+    }
+    str_json_concat(str_json, "]");
+}
+
+/**
+ * @brief Append a json point object ({"x":..,"y":..})
+ */
+static void json_point(t_str_json *str_json, const double *p)
+{
+    str_json_concat(str_json, "{\"x\":");
+    str_json_fixed(str_json, p[0], JSON_PIXEL_DECIMALS);
+    str_json_concat(str_json, ",\"y\":");
+    str_json_fixed(str_json, p[1], JSON_PIXEL_DECIMALS);
+    str_json_concat(str_json, "}");
+}
+
+/**
+ * @brief Append the json object of a detection record: id, corners, center and, if the record has it, the pose
+ *        and alternative solution
+ *
+ * @param str_json the json string
+ * @param rec the detection record
+ */
+static void json_det_record(t_str_json *str_json, const t_atagjs_det_record *rec)
+{
+    str_json_concat(str_json, "{\"id\":");
+    str_json_int(str_json, rec->id);
+    if (rec->family != 0)
+    {
+        str_json_concat(str_json, ", \"family\": \"");
+        str_json_concat(str_json, g_family_desc[__builtin_ctz(rec->family)].name);
+        str_json_concat(str_json, "\"");
+    }
+    str_json_concat(str_json, ", \"corners\": [");
+    for (int c = 0; c < 4; c++)
+    {
+        if (c > 0) str_json_concat(str_json, ",");
+        json_point(str_json, rec->corners[c]);
+    }
+    str_json_concat(str_json, "], \"center\": ");
+    json_point(str_json, rec->center);
+
+    if (rec->flags & ATAGJS_DET_REC_POSE)
+    {
+        // column major R:
+        str_json_concat(str_json, ", \"pose\": { \"size\":");
+        str_json_fixed(str_json, rec->size, JSON_PIXEL_DECIMALS);
+        str_json_concat(str_json, ", \"R\": ");
+        json_rotation(str_json, rec->R);
+        str_json_concat(str_json, ", \"t\": ");
+        json_doubles(str_json, rec->t, 3, JSON_POSE_DECIMALS);
+        str_json_concat(str_json, ", \"e\": ");
+        str_json_fixed(str_json, rec->e, JSON_POSE_DECIMALS);
+        str_json_concat(str_json, (rec->pose_mode == ATAGJS_POSE_FAST) ? ", \"method\": \"fast\"" : ", \"method\": \"full\"");
+        if (rec->flags & ATAGJS_DET_REC_ASOL) {
+            // return other alternative solution; uniquesol indicates if there are multiple solutions
+            str_json_concat(str_json, ", \"asol\": {\"R\": ");
+            json_rotation(str_json, rec->asol_R);
+            str_json_concat(str_json, ", \"t\": ");
+            json_doubles(str_json, rec->asol_t, 3, JSON_POSE_DECIMALS);
+            str_json_concat(str_json, ", \"e\": ");
+            str_json_fixed(str_json, rec->asol_e, JSON_POSE_DECIMALS);
+            str_json_concat(str_json, (rec->flags & ATAGJS_DET_REC_ASOL_DISTINCT) ? ", \"uniquesol\": true }" : ", \"uniquesol\": false }");
+        }
+        str_json_concat(str_json, " }");
+    }
+    str_json_concat(str_json, " }");
+}
+
+/**
+ * @brief Get the family and size of a detected tag
+ *
+ * @param ctx detector context
+ * @param det the detection
+ * @param family where to write the family of the tag (ATAGJS_FAMILY_* bit)
+ *
+ * return the tag size, in meters
+ */
+static double tagsize_from_det(atagjs_ctx_t *ctx, apriltag_detection_t *det, int *family) {
+  for (int f = 0; f < ATAGJS_NFAMILIES; f++) {
+    if (ctx->tf[f] != det->family) continue;
+    *family = 1 << f;
+    return tag_size_get(&ctx->tag_sizes, f, det->id, DEFAULT_TAG_SIZE);
+  }
+  *family = 0;
+  return tag_size_get(&ctx->tag_sizes, TAG_SIZE_ANY_FAMILY, det->id, DEFAULT_TAG_SIZE);
+}
+
+/**
+ * @brief Enable a set of tag families in the detector of a context (the families enabled before are removed)
+ *
+ * Poses cached and tracked tags refer to the families removed, so they are reset
+ *
+ * @param ctx detector context
+ * @param families ATAGJS_FAMILY_* bits
+ * @param bits_corrected number of bits corrected
+ *
+ * @return 0=success; -1 on failure (no family is enabled)
+ */
+static int set_families(atagjs_ctx_t *ctx, int families, int bits_corrected)
+{
+    clear_families(ctx);
+    tag_pose_cache_reset(&ctx->pose_cache);
+    tag_track_reset(&ctx->track, ctx->track.keyframe_interval, ctx->track.roi_padding);
+
+    for (int f = 0; f < ATAGJS_NFAMILIES; f++)
+    {
+        if (!(families & (1 << f))) continue;
+        ctx->tf[f] = g_family_desc[f].create();
+        if (ctx->tf[f] == NULL)
+        {
+            clear_families(ctx);
+            return -1;
+        }
+        tag_decode_table_attach(ctx->tf[f], bits_corrected); // use the decode table generated at build time, if there is one; the detector builds it otherwise
+        apriltag_detector_add_family_bits(ctx->td, ctx->tf[f], bits_corrected);
+    }
+    ctx->families = families;
+    ctx->bits_corrected = bits_corrected;
+    return 0;
+}
+
+/**
+ * @brief Remove the tag families of a context from its detector, and destroy them
+ *
+ * @param ctx detector context
+ */
+static void clear_families(atagjs_ctx_t *ctx)
+{
+    for (int f = 0; f < ATAGJS_NFAMILIES; f++)
+        if (ctx->tf[f] != NULL) tag_decode_table_detach(ctx->tf[f]); // the detector must not release a build-time table
+    apriltag_detector_clear_families(ctx->td);
+    for (int f = 0; f < ATAGJS_NFAMILIES; f++)
+    {
+        if (ctx->tf[f] != NULL) g_family_desc[f].destroy(ctx->tf[f]);
+        ctx->tf[f] = NULL;
+    }
+    ctx->families = 0;
+}
+
+/**
+ * @brief Feed the frame just processed to the decimation controller (when auto_decimate is on), and apply the
+ *        decimation and edge refinement it picks for the next frame
+ *
+ * The frame time is all the time spent in the detect call (conversion, detector, pose and json); the smallest tag is
+ * the shortest side of the tags detected (in the context records)
+ *
+ * @param ctx detector context
+ */
+static void auto_decimate_update(atagjs_ctx_t *ctx)
+{
+    if (!ctx->auto_decimate || ctx->stats.reused) return; // a reused frame says nothing about the detector time
+
+    const t_atagjs_frame_stats *st = &ctx->stats;
+    double frame_us = st->gate_us + st->convert_us + st->detect_us + st->pose_us + st->json_us;
+
+    double min_side = 0;
+    for (int i = 0; i < ctx->det_bin.len; i++)
+    {
+        const t_atagjs_det_record *rec = &ctx->det_bin.records[i];
+        for (int j = 0; j < 4; j++)
+        {
+            double side = hypot(rec->corners[(j + 1) % 4][0] - rec->corners[j][0], rec->corners[(j + 1) % 4][1] - rec->corners[j][1]);
+            if (min_side == 0 || side < min_side) min_side = side;
+        }
+    }
+
+    if (decimate_ctl_update(&ctx->decimate_ctl, frame_us, min_side))
+    {
+        ctx->td->quad_decimate = ctx->decimate_ctl.decimate;
+        ctx->td->refine_edges = ctx->decimate_ctl.refine_edges;
+    }
+}
+
+/**
+ * @brief Start the deadline of a frame (if the context has one)
+ *
+ * @param ctx detector context
+ */
+static void start_deadline(atagjs_ctx_t *ctx)
+{
+    ctx->frame_deadline = (ctx->deadline_us > 0) ? utime_now() + ctx->deadline_us : 0;
+}
+
+/**
+ * @brief Check the deadline of the current frame; once expired, the frame is flagged as truncated (in the frame stats)
+ *
+ * @param ctx detector context
+ *
+ * @return 1 if the deadline expired; 0 otherwise (or no deadline)
+ */
+static int check_deadline(atagjs_ctx_t *ctx)
+{
+    if (ctx->frame_deadline == 0 || (!ctx->stats.truncated && utime_now() < ctx->frame_deadline)) return 0;
+    ctx->stats.truncated = 1;
+    return 1;
+}
+
+/**
+ * @brief Check a frame size against the heap budget of a context
+ *
+ * @param ctx detector context
+ * @param width frame width (or stride)
+ * @param height frame height
+ *
+ * @return 1 if the frame is larger than the budget; 0 otherwise (or no budget)
+ */
+static int over_budget(const atagjs_ctx_t *ctx, int width, int height)
+{
+    return ctx->budget_pixels > 0 && (int64_t)width * height > ctx->budget_pixels;
+}
+
+/**
+ * @brief Heap the detector intermediates of a frame need, and the output of the most tags of the heap budget
+ *        (ATAGJS_HEAP_BYTES_PER_PIXEL per pixel of the decimated frame, ATAGJS_HEAP_BYTES_PER_TAG per tag)
+ *
+ * @param ctx detector context
+ * @param width frame width
+ * @param height frame height
+ * @param decimate decimation of the frame (quad_decimate)
+ *
+ * @return the bytes needed
+ */
+static size_t frame_heap_need(const atagjs_ctx_t *ctx, int width, int height, double decimate)
+{
+    double d = (decimate > 1) ? decimate : 1;
+    return (size_t)(ATAGJS_HEAP_BYTES_PER_PIXEL * (width / d) * (height / d) + (double)ATAGJS_HEAP_BYTES_PER_TAG * ctx->budget_tags);
+}
+
+/**
+ * @brief Fill the heap usage of the frame stats, after a call: the WASM heap size, and if it grew since the last call;
+ *        bytes allocated and the peak footprint when the frame stats are enabled. Marks the heap budget to be probed
+ *        again if the context grew its buffers
+ *
+ * @param ctx detector context
+ */
+static void update_heap_stats(atagjs_ctx_t *ctx)
+{
+    size_t size = heap_stats_size();
+    ctx->stats.heap_size = size;
+    ctx->stats.heap_grew = (size > ctx->heap_size);
+    ctx->heap_size = size;
+    if (ctx->stats.nallocs > 0) ctx->budget_grown = 1; // the heap budget is probed again before the next frame
+    if (!ctx->frame_stats) return;
+
+    heap_stats_sample(&ctx->heap);
+    ctx->stats.heap_used = ctx->heap.used;
+    ctx->stats.heap_peak = ctx->heap.peak;
+}
+
+/**
+ * @brief Compare the input frame of a context to the last frame detected; if unchanged, make its records (still in the
+ *        context) the result of this frame
+ *
+ * @param ctx detector context
+ *
+ * @return 1 if the frame was unchanged (the records are reused); 0 if it must be detected
+ */
+static int gate_frame(atagjs_ctx_t *ctx)
+{
+    int64_t start = utime_now();
+    int reuse = ctx->input_rgba ?
+        motion_gate_check(&ctx->gate, ctx->rgba_buf, ctx->width, ctx->height, ctx->rgba_stride, 4) :
+        motion_gate_check(&ctx->gate, ctx->img_buf, ctx->width, ctx->height, ctx->stride, 1);
+    ctx->stats.gate_us = utime_now() - start;
+    ctx->stats.gate_change = ctx->gate.change;
+    if (!reuse) return 0;
+
+    ctx->det_bin.len = ctx->gate_len;
+    ctx->det_bin.flags = ATAGJS_DET_BIN_REUSED;
+    ctx->stats.reused = 1;
+    ctx->stats.ndetections = ctx->gate_len;
+    ctx->stats.quad_decimate = ctx->td->quad_decimate;
+    ctx->stats.refine_edges = ctx->td->refine_edges;
+    return 1;
 }
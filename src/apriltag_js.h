@@ -15,14 +15,387 @@
 #include "apriltag_pose.h"
 #include "str_json.h"
 
-// maximum size of string for each detection
-#define STR_DET_LEN 1500
+// expected size of the json string of each detection (the json string grows as needed)
+#define STR_DET_LEN 512
 
-// max id: 36h11 tag ids are up to 586
-#define MAX_TAG_ID 600
+// tag families (atagjs_set_families); the families enabled are decoded in the same detector pass
+#define ATAGJS_FAMILY_TAG36H11 0x01
+#define ATAGJS_FAMILY_TAG25H9 0x02
+#define ATAGJS_FAMILY_TAG16H5 0x04
+#define ATAGJS_FAMILY_TAGCIRCLE21H7 0x08
+#define ATAGJS_FAMILY_TAGSTANDARD41H12 0x10
+#define ATAGJS_FAMILY_ALL 0x1f
+#define ATAGJS_NFAMILIES 5
+
+// most bits corrected when decoding (the decode table of a family grows quickly with the bits corrected)
+#define ATAGJS_MAX_BITS_CORRECTED 3
+
+// number of frame ring slots of a context (one being detected, one being filled, one spare)
+#define ATAGJS_RING_SLOTS 3
+
+// version of the binary detection output layout; bumped on any change to t_atagjs_det_bin or t_atagjs_det_record
+#define ATAGJS_DET_BIN_VERSION 3
+
+// pose modes (return_pose option of atagjs_set_detector_options); also the pose_mode of each t_atagjs_det_record
+#define ATAGJS_POSE_NONE 0  // corners only
+#define ATAGJS_POSE_FULL 1  // orthogonal iteration, best of both solutions (alternative solution available)
+#define ATAGJS_POSE_FAST 2  // closed-form pose from the detection homography; no iteration, single solution
+
+// t_atagjs_det_record flags
+#define ATAGJS_DET_REC_POSE 0x1           // record has pose (size, R, t, e)
+#define ATAGJS_DET_REC_ASOL 0x2           // record has alternative solution (asol_R, asol_t, asol_e)
+#define ATAGJS_DET_REC_ASOL_DISTINCT 0x4  // alternative solution differs from the pose (json "uniquesol")
+
+// frame-level flags of t_atagjs_det_bin
+#define ATAGJS_DET_BIN_TRUNCATED 0x1      // the deadline expired: candidates were left undecoded, or poses unestimated
+#define ATAGJS_DET_BIN_REUSED 0x2         // the frame was unchanged: the records are those of the last frame detected
+
+#define ATAGJS_DET_BIN_INITIALIZER { .version = ATAGJS_DET_BIN_VERSION, .len = 0, .record_size = sizeof(t_atagjs_det_record), .flags = 0, .records = NULL, .alloc_len = 0 }
+
+#define ATAGJS_DET_BATCH_INITIALIZER { .version = ATAGJS_DET_BIN_VERSION, .nframes = 0, .record_size = sizeof(t_atagjs_det_record), .len = 0, .offsets = NULL, .records = NULL, .alloc_frames = 0, .alloc_len = 0 }
+
+/**
+ * @typedef t_atagjs_det_record
+ * @brief Fixed-layout record of one detection, as returned by atagjs_detect_bin()
+ * @warning javascript reads this with Int32Array/Float64Array views; the six int32 fields are followed by doubles only, so
+ *          the record must remain a multiple of 8 bytes. Bump ATAGJS_DET_BIN_VERSION on any change
+ */
+typedef struct {
+  int32_t id;              // tag id
+  int32_t hamming;         // number of error bits corrected
+  int32_t flags;           // ATAGJS_DET_REC_* bits
+  int32_t pose_mode;       // ATAGJS_POSE_* mode the pose was estimated with (ATAGJS_POSE_NONE if no pose)
+  int32_t family;          // tag family (ATAGJS_FAMILY_* bit)
+  int32_t reserved;
+  double decision_margin;  // measure of the quality of the binary decoding process
+  double corners[4][2];    // x,y of the corners (fractional pixel coordinates)
+  double center[2];        // x,y of the center (fractional pixel coordinates)
+  double size;             // tag size used for pose, in meters
+  double R[9];             // rotation matrix, column major (same order as the json output)
+  double t[3];             // translation
+  double e;                // object-space error of the pose (for any pose mode)
+  double asol_R[9];        // alternative solution rotation matrix, column major
+  double asol_t[3];        // alternative solution translation
+  double asol_e;           // alternative solution object-space error
+} t_atagjs_det_record;
+
+ /**
+  * @typedef t_atagjs_det_bin
+  * @brief binary detection output structure
+  * @warning this is the structure returned to javascript; it assumes the layout of the first five 32-bit words (in WASM)
+  */
+typedef struct {
+  int32_t version;                // ATAGJS_DET_BIN_VERSION
+  int32_t len;                    // number of records
+  int32_t record_size;            // size of each record, in bytes
+  int32_t flags;                  // frame-level flags (ATAGJS_DET_BIN_*)
+  t_atagjs_det_record *records;   // the records
+  int32_t alloc_len;              // allocated records
+} t_atagjs_det_bin;
+
+/**
+ * @typedef t_atagjs_det_batch
+ * @brief binary detection output of a batch of frames: the records of all frames, one frame after the other
+ * @warning this is the structure returned to javascript; it assumes the layout of the first six 32-bit words (in WASM)
+ */
+typedef struct {
+  int32_t version;                // ATAGJS_DET_BIN_VERSION
+  int32_t nframes;                // number of frames
+  int32_t record_size;            // size of each record, in bytes
+  int32_t len;                    // number of records (all frames)
+  int32_t *offsets;               // nframes+1 offsets; the records of frame i are records[offsets[i]] .. records[offsets[i+1]-1]
+  t_atagjs_det_record *records;   // the records
+  int32_t alloc_frames;           // allocated offsets
+  int32_t alloc_len;              // allocated records
+} t_atagjs_det_batch;
+
+/**
+ * @typedef t_atagjs_frame_stats
+ * @brief Timing and counters of the last frame processed by a detector context
+ *
+ * detect_us, pose_us, json_us, convert_us, quad_decimate, heap_size, gate_us, ndetections, nrois, npose_iters, nallocs, refine_edges,
+ * truncated, heap_grew, over_budget, reused and gate_change are always filled; the detector stage breakdown, the pipeline counters and heap_used/heap_peak
+ * (which walk the allocator state) are only filled when enabled with atagjs_set_frame_stats() (zero otherwise). After a
+ * batch (atagjs_detect_batch()), times and counters are summed over the frames of the batch (settings are those of the
+ * batch); heap usage is sampled after the call
+ * @warning javascript reads this structure (Float64Array over the doubles, Int32Array over the counters); keep doubles first
+ */
+typedef struct {
+  double detect_us;        // time spent in the apriltag detector, in microseconds
+  double decimate_us;      // detector stages (from the detector timeprofile), in microseconds ..
+  double blur_us;
+  double threshold_us;
+  double unionfind_us;
+  double clusters_us;
+  double quad_fit_us;
+  double decode_us;        // decode and edge refinement (a single stage in the apriltag detector)
+  double other_us;         // remaining detector stages (init, reconcile, cleanup)
+  double pose_us;          // time spent in pose estimation, in microseconds
+  double json_us;          // time spent formatting the json output, in microseconds (0 for detect_bin)
+  double convert_us;       // time spent converting RGBA input to grayscale, in microseconds (0 for grayscale input)
+  double quad_decimate;    // decimation the frame was detected with (picked by the controller with auto decimation)
+  double heap_used;        // heap allocated after the call, in bytes
+  double heap_peak;        // highest heap footprint (allocated and free bytes the allocator holds) so far, in bytes; what
+                           // a fixed heap must hold
+  double heap_size;        // size of the WASM heap after the call, in bytes (0 when not running in WASM)
+  double gate_us;          // time spent checking if the frame changed (see atagjs_set_motion_gate()), in microseconds
+  int32_t nedges;          // pipeline counters ..
+  int32_t nsegments;
+  int32_t nquads;          // quads fitted (decode candidates)
+  int32_t ndecode_attempts;// quads x tag families
+  int32_t nrejected;       // decode attempts that did not result in a detection (includes duplicates removed by the detector)
+  int32_t ndetections;     // detections returned
+  int32_t nrois;           // regions searched when tracking or with fused input (0=full-frame scan)
+  int32_t npose_iters;     // orthogonal iteration steps of the pose estimation (all tags, both solutions)
+  int32_t nallocs;         // growth of the buffers the context owns (arena, records, detections array, output/work buffers).
+                           // the apriltag detector still allocates its images, clusters, quads and detections on each frame;
+                           // those allocations (and the cold pose of a tag, from its homography) are not counted
+  int32_t refine_edges;    // edge refinement the frame was detected with (picked by the controller with auto decimation)
+  int32_t truncated;       // 1 if the deadline expired before the frame was done (see atagjs_set_deadline()); 0 otherwise
+  int32_t heap_grew;       // 1 if the WASM heap grew since the last call (javascript views over it must be created again)
+  int32_t over_budget;     // 1 if the frame was not detected because it does not fit the heap budget (see atagjs_set_heap_budget())
+  int32_t reused;          // 1 if the frame was unchanged and the results of the last frame detected were returned; 0 otherwise
+  int32_t gate_change;     // largest change of a cell of the frame from the last frame detected (gray levels; 0 without motion gate)
+} t_atagjs_frame_stats;
+
+/**
+ * @typedef atagjs_ctx_t
+ * @brief Opaque detector context
+ *
+ * A context owns its detector, image buffer, output buffers, tag sizes and camera intrinsics. Contexts share no mutable
+ * state, so different threads can drive different contexts at the same time (one thread per context at a time).
+ * The atagjs_* calls without a context argument operate on a default context created by atagjs_init()
+ */
+typedef struct atagjs_ctx atagjs_ctx_t;
+
+/**
+ * @brief Create a detector context with the tag36h11 family and default options
+ * default options: quad_decimate=2.0; quad_sigma=0.0; nthreads=1; refine_edges=1; return_pose=1
+ * @sa atagjs_ctx_set_detector_options for meaning of options
+ *
+ * @return the new context; NULL on failure
+ */
+atagjs_ctx_t *atagjs_ctx_create();
+
+/**
+ * @brief Releases a context and all its resources
+ *
+ * @param ctx the context
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_destroy(atagjs_ctx_t *ctx);
+
+/**
+ * @brief Sets the given detector options of a context
+ * @sa atagjs_set_detector_options for meaning of options
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_detector_options(atagjs_ctx_t *ctx, float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions);
+
+/**
+ * @brief Sets camera intrinsics (in pixels) of a context
+ * @sa atagjs_set_pose_info
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_pose_info(atagjs_ctx_t *ctx, double fx, double fy, double cx, double cy);
+
+/**
+ * @brief Creates/changes size of the image buffer of a context
+ * @sa atagjs_set_img_buffer
+ *
+ * @return the pointer to the image buffer; NULL on failure
+ */
+uint8_t *atagjs_ctx_set_img_buffer(atagjs_ctx_t *ctx, int width, int height, int stride);
+
+/**
+ * @brief Creates/changes size of the RGBA image buffer of a context; detect then converts it to grayscale
+ * @sa atagjs_set_rgba_buffer
+ *
+ * @return the pointer to the RGBA image buffer; NULL on failure
+ */
+uint8_t *atagjs_ctx_set_rgba_buffer(atagjs_ctx_t *ctx, int width, int height, int stride);
+
+/**
+ * @brief Preallocate the buffers of a context for frames of a given size, and the heap for its detector
+ * @sa atagjs_reserve
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_reserve(atagjs_ctx_t *ctx, int width, int height);
+
+/**
+ * @brief Set the size of a known tag in a context
+ * @sa atagjs_set_tag_size
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_tag_size(atagjs_ctx_t *ctx, int tagid, double size);
+
+/**
+ * @brief Set the size of a known tag of a family in a context
+ * @sa atagjs_set_family_tag_size
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_family_tag_size(atagjs_ctx_t *ctx, int family, int tagid, double size);
+
+/**
+ * @brief Set the tag families a context detects
+ * @sa atagjs_set_families
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_families(atagjs_ctx_t *ctx, int families, int bits_corrected);
+
+/**
+ * @brief Detect tags in the image buffer of a context
+ * @sa atagjs_detect
+ *
+ * @return pointer to the context str_json structure; NULL if ctx is NULL
+ */
+t_str_json *atagjs_ctx_detect(atagjs_ctx_t *ctx);
+
+/**
+ * @brief Detect tags in a grayscale image owned by the caller, without copying it into the image buffer of a context
+ * @sa atagjs_detect_image
+ *
+ * @return pointer to the context str_json structure; NULL if ctx is NULL
+ */
+t_str_json *atagjs_ctx_detect_image(atagjs_ctx_t *ctx, const uint8_t *pixels, int width, int height, int stride);
+
+/**
+ * @brief Detect tags in the image buffer of a context and return them as binary records
+ * @sa atagjs_detect_bin
+ *
+ * @return pointer to the context t_atagjs_det_bin structure; NULL on error
+ */
+t_atagjs_det_bin *atagjs_ctx_detect_bin(atagjs_ctx_t *ctx);
+
+/**
+ * @brief Creates/changes size of the batch buffer of a context
+ * @sa atagjs_set_batch_buffer
+ *
+ * @return the pointer to the batch buffer; NULL on failure
+ */
+uint8_t *atagjs_ctx_set_batch_buffer(atagjs_ctx_t *ctx, int nframes);
+
+/**
+ * @brief Detect tags in a batch of frames with the options of a context; frames have the size of its image buffer
+ * @sa atagjs_detect_batch
+ *
+ * @return pointer to the context t_atagjs_det_batch structure; NULL on error
+ */
+t_atagjs_det_batch *atagjs_ctx_detect_batch(atagjs_ctx_t *ctx, const uint8_t *frames, int nframes);
 
 /**
- * @brief Init the apriltag detector with given family and default options
+ * @brief Acquire a frame ring slot of a context
+ * @sa atagjs_ring_acquire
+ *
+ * @return the slot; -1 on failure
+ */
+int atagjs_ctx_ring_acquire(atagjs_ctx_t *ctx, int width, int height, int stride, int rgba);
+
+/**
+ * @brief Get the buffer of a frame ring slot of a context
+ * @sa atagjs_ring_buffer
+ *
+ * @return the pointer to the slot buffer; NULL on failure
+ */
+uint8_t *atagjs_ctx_ring_buffer(atagjs_ctx_t *ctx, int slot);
+
+/**
+ * @brief Mark a frame ring slot of a context as filled
+ * @sa atagjs_ring_commit
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_ring_commit(atagjs_ctx_t *ctx, int slot);
+
+/**
+ * @brief Detect tags in a frame ring slot of a context, and release the slot
+ * @sa atagjs_ring_detect
+ *
+ * @return pointer to the context t_atagjs_det_bin structure; NULL on error
+ */
+t_atagjs_det_bin *atagjs_ctx_ring_detect(atagjs_ctx_t *ctx, int slot);
+
+/**
+ * @brief Release a frame ring slot of a context without detecting
+ * @sa atagjs_ring_release
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_ring_release(atagjs_ctx_t *ctx, int slot);
+
+/**
+ * @brief Enable/disable tracking in a context
+ * @sa atagjs_set_tracking
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_tracking(atagjs_ctx_t *ctx, int enable, int keyframe_interval, float roi_padding);
+
+/**
+ * @brief Enable/disable fused RGBA input conversion in a context
+ * @sa atagjs_set_fused_input
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_fused_input(atagjs_ctx_t *ctx, int enable);
+
+/**
+ * @brief Enable/disable adaptive decimation in a context
+ * @sa atagjs_set_auto_decimate
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_auto_decimate(atagjs_ctx_t *ctx, double target_ms, float min_decimate, float max_decimate, int adapt_refine);
+
+/**
+ * @brief Set the deadline of the detect calls of a context
+ * @sa atagjs_set_deadline
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_deadline(atagjs_ctx_t *ctx, double deadline_ms);
+
+/**
+ * @brief Enable/disable motion gating in a context
+ * @sa atagjs_set_motion_gate
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_motion_gate(atagjs_ctx_t *ctx, int enable, int threshold, int refresh_interval);
+
+/**
+ * @brief Set the heap budget of a context
+ * @sa atagjs_set_heap_budget
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_heap_budget(atagjs_ctx_t *ctx, int max_width, int max_height, int max_tags);
+
+/**
+ * @brief Enable/disable the detector stage breakdown and pipeline counters in the frame stats of a context
+ * @sa atagjs_set_frame_stats
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_ctx_set_frame_stats(atagjs_ctx_t *ctx, int enable);
+
+/**
+ * @brief Get the timing and counters of the last frame processed by a context
+ * @sa atagjs_get_frame_stats
+ *
+ * @return pointer to the context frame stats; NULL if ctx is NULL
+ */
+const t_atagjs_frame_stats *atagjs_ctx_get_frame_stats(atagjs_ctx_t *ctx);
+
+/**
+ * @brief Init the apriltag detector (default context) with given family and default options
  * default options: quad_decimate=2.0; quad_sigma=0.0; nthreads=1; refine_edges=1; return_pose=1
  * @sa set_detector_options for meaning of options
  *
@@ -31,7 +404,7 @@
 int atagjs_init();
 
 /**
- * @brief Releases resources
+ * @brief Releases resources (of the default context)
  *
  * @return 0=success
  */
@@ -42,16 +415,27 @@ int atagjs_destroy();
  *
  * @param decimate Decimate input image by this factor
  * @param sigma Apply low-pass blur to input; negative sharpens
- * @param nthreads Use this many CPU threads
+ * @param nthreads Use this many CPU threads (limited to atagjs_max_threads())
  * @param refine_edges Spend more time trying to align edges of tags
  * @param max_detections Maximum number of detections to return (0=no max)
- * @param return_pose Detect returns pose of detected tags (0=does not return pose; returns pose otherwise)
- * @param return_solutions Detect returns details about both solutions of the pose estimation, if available
+ * @param return_pose Pose mode: ATAGJS_POSE_NONE (0, corners only), ATAGJS_POSE_FULL (1, orthogonal iteration) or
+ *        ATAGJS_POSE_FAST (2, closed-form homography pose, cheaper and less accurate); other values are ATAGJS_POSE_FULL
+ * @param return_solutions Detect returns details about both solutions of the pose estimation, if available (ATAGJS_POSE_FULL only)
  *
  * @return 0=success
  */
 int atagjs_set_detector_options(float decimate, float sigma, int nthreads, int refine_edges, int max_detections, int return_pose, int return_solutions);
 
+/**
+ * @brief Maximum number of detector threads of this build
+ *
+ * WASM builds without pthreads run single-threaded (1); the WASM pthreads build is limited to its preallocated worker
+ * pool, which is shared by all contexts; native builds allow up to 64
+ *
+ * @return the maximum nthreads accepted by set_detector_options (larger values are clamped)
+ */
+int atagjs_max_threads();
+
 /**
  * @brief Sets camera intrinsics (in pixels) for tag pose estimation
  *
@@ -67,6 +451,9 @@ int atagjs_set_pose_info(double fx, double fy, double cx, double cy);
 /**
  * @brief Creates/changes size of the image buffer where we receive the images to process
  *
+ * The buffer only grows: a frame of the same (or a smaller) size reuses it, so changing the size back and forth does
+ * not allocate
+ *
  * @param width Width of the image
  * @param height Height of the image
  * @param stride How many pixels per row (=width typically)
@@ -77,9 +464,46 @@ int atagjs_set_pose_info(double fx, double fy, double cx, double cy);
  */
 uint8_t *atagjs_set_img_buffer(int width, int height, int stride);
 
+/**
+ * @brief Creates/changes size of an RGBA image buffer where we receive the images to process; use instead of
+ *        set_img_buffer to pass color images as they come from a canvas (4 bytes per pixel: R, G, B, A)
+ *
+ * detect() and detect_bin() convert the RGBA pixels to grayscale (luma) before detection, with a SIMD kernel when available
+ *
+ * @param width Width of the image
+ * @param height Height of the image
+ * @param stride How many pixels per row (=width typically)
+ *
+ * @return the pointer to the RGBA image buffer (height*stride*4 bytes); NULL on failure
+ *
+ * @warning calling set_img_buffer switches the input back to grayscale
+ */
+uint8_t *atagjs_set_rgba_buffer(int width, int height, int stride);
+
+/**
+ * @brief Preallocate the buffers for frames up to a given size, and the heap for the detector, so the first frames do
+ *        not pay for growing the input buffers (or, in WASM, the heap)
+ *
+ * Grows the input buffers (the RGBA one if the input is RGBA) and the decimated buffer of the fused conversion to this
+ * size, then allocates and releases the heap the detector intermediates of a frame this size need
+ * (ATAGJS_HEAP_BYTES_PER_PIXEL per pixel), so a heap that can grow does it now. The detector still allocates its
+ * intermediates on each frame (the allocator reuses the heap they were released to). Detection state (stats, tracking,
+ * records) is not changed
+ *
+ * @param width Width of the largest frame expected
+ * @param height Height of the largest frame expected
+ *
+ * @return 0=success; -1 on failure (the buffers or the heap could not be allocated)
+ *
+ * @warning the input buffers might move; call set_img_buffer (or set_rgba_buffer) after, to get their pointer
+ */
+int atagjs_reserve(int width, int height);
+
 /**
  * @brief Set the size of a known tag; This size will be used for pose computation later
  *
+ * The size applies to the tag id in any family, unless a size was set for the id in its family (set_family_tag_size)
+ *
  * @param tagid the ID of the tag
  * @param size the size of the tag in meters
  *
@@ -89,13 +513,318 @@ uint8_t *atagjs_set_img_buffer(int width, int height, int stride);
 int atagjs_set_tag_size(int tagid, double size);
 
 /**
- * @brief Detect tags in image stored in the buffer (g_img_buf)
+ * @brief Set the size of a known tag of a family; This size will be used for pose computation later
+ *
+ * Sizes are kept in a hash table keyed by family and id, so any id of any family can be sized
+ *
+ * @param family the family of the tag (one ATAGJS_FAMILY_* bit)
+ * @param tagid the ID of the tag
+ * @param size the size of the tag in meters
+ *
+ * @return 0=success; -1 on failure
+ */
+int atagjs_set_family_tag_size(int family, int tagid, double size);
+
+/**
+ * @brief Set the tag families to detect (tag36h11 by default)
+ *
+ * All the families enabled are detected in the same detector pass: the image is thresholded and segmented into quads
+ * once, and each quad is decoded against every family. This is cheaper than a detector per family, which would
+ * process the frame once per family. Detections report their family (json "family"; record family field)
+ *
+ * @param families ATAGJS_FAMILY_* bits
+ * @param bits_corrected number of bits corrected when decoding (0 .. ATAGJS_MAX_BITS_CORRECTED; 1 by default)
+ *
+ * @return 0=success; -1 on failure (invalid families or bits corrected, or the families could not be created; no
+ *         family is enabled after a creation failure)
+ */
+int atagjs_set_families(int families, int bits_corrected);
+
+/**
+ * @brief Detect tags in image stored in the buffer (of the default context)
  *
  * @return pointer to str_json structure. The data in this memory location must be consumed before the next call to detect()
  *
- * @warning caller is responsible for putting *grayscale* image pixels in the input buffer (g_img_buf)
+ * @warning caller is responsible for putting *grayscale* image pixels in the input buffer (set_img_buffer), or RGBA
+ *          pixels in the RGBA input buffer (set_rgba_buffer)
  * @warning caller *should not* release return pointer (it's reused at every detect() call); data returned must be consumed before the next call to detect()
  */
 t_str_json *atagjs_detect();
 
+/**
+ * @brief Detect tags in a grayscale image owned by the caller (e.g. a memory-mapped file), without copying it into the
+ *        image buffer; returns the same as atagjs_detect()
+ *
+ * The image buffer (set_img_buffer) is not used, nor changed. Each image is detected on its own (e.g. the files of a
+ * dataset): pose estimation does not start from the poses of the last frame
+ *
+ * @param pixels the image pixels (height*stride bytes); not written to
+ * @param width Width of the image
+ * @param height Height of the image
+ * @param stride How many pixels per row (>= width)
+ *
+ * @return pointer to str_json structure. The data in this memory location must be consumed before the next call to
+ *         detect() or detect_image()
+ */
+t_str_json *atagjs_detect_image(const uint8_t *pixels, int width, int height, int stride);
+
+/**
+ * @brief Detect tags in image stored in the buffer (of the default context) and return them as fixed-layout binary records
+ *
+ * Same detections and pose as atagjs_detect(), without formatting a json string
+ *
+ * @return pointer to t_atagjs_det_bin structure; NULL on error. The data in this memory location must be consumed before the next call to detect_bin()
+ *
+ * @warning caller is responsible for putting *grayscale* image pixels in the input buffer (set_img_buffer)
+ * @warning caller *should not* release return pointer (it's reused at every detect_bin() call)
+ */
+t_atagjs_det_bin *atagjs_detect_bin();
+
+/**
+ * @brief Creates/changes size of a buffer where we receive a batch of frames to process with detect_batch(), for callers
+ *        that cannot pass a pointer to their frames (e.g. javascript)
+ *
+ * Frames have the size of the image buffer (set_img_buffer) and are stored one after the other (height*stride bytes each)
+ *
+ * @param nframes number of frames
+ *
+ * @return the pointer to the batch buffer; NULL on failure or if set_img_buffer was not called
+ */
+uint8_t *atagjs_set_batch_buffer(int nframes);
+
+/**
+ * @brief Detect tags in a batch of grayscale frames, e.g. to process a recorded session
+ *
+ * Frames are processed independently (as detect_bin() would; tracking is not used, and pose estimation does not start
+ * from the poses of another frame), by nthreads workers in parallel
+ * (one frame per worker; each worker detects with one thread) in the builds with threads. Results are returned in a single
+ * block, with the records of each frame one after the other; buffers are reused across calls
+ *
+ * @param frames the frames, one after the other; each has the size of the image buffer (set_img_buffer), height*stride bytes
+ * @param nframes number of frames
+ *
+ * @return pointer to t_atagjs_det_batch structure; NULL on error. The data in this memory location must be consumed before
+ *         the next call to detect_batch()
+ *
+ * @warning caller *should not* release return pointer (it's reused at every detect_batch() call)
+ */
+t_atagjs_det_batch *atagjs_detect_batch(const uint8_t *frames, int nframes);
+
+/**
+ * @brief Acquire a slot of the frame ring, to fill with a frame while the detector works on another slot
+ *
+ * The ring has ATAGJS_RING_SLOTS input slots, each with its own buffer, so a frame can be copied in (e.g. by another
+ * thread, or by the page through shared WASM memory) while the previous frame is detected. A slot goes through
+ * ring_acquire() -> fill ring_buffer() -> ring_commit() -> ring_detect() (or ring_release() to drop it). Slot buffers are
+ * kept, and only reallocated when a larger frame is acquired
+ *
+ * @param width Width of the frame
+ * @param height Height of the frame
+ * @param stride How many pixels per row (=width typically)
+ * @param rgba 0=grayscale frame (1 byte per pixel); RGBA frame otherwise (4 bytes per pixel, converted at detect)
+ *
+ * @return the slot; -1 if all slots are in use or on allocation failure
+ */
+int atagjs_ring_acquire(int width, int height, int stride, int rgba);
+
+/**
+ * @brief Get the buffer of an acquired frame ring slot (height*stride pixels)
+ *
+ * @param slot the slot
+ *
+ * @return the pointer to the slot buffer; NULL if the slot is not acquired
+ */
+uint8_t *atagjs_ring_buffer(int slot);
+
+/**
+ * @brief Mark a frame ring slot as filled, ready for ring_detect()
+ *
+ * @param slot the slot
+ *
+ * @return 0=success; -1 if the slot is not acquired
+ */
+int atagjs_ring_commit(int slot);
+
+/**
+ * @brief Detect tags in a committed frame ring slot, and release the slot
+ *
+ * Same detections as detect_bin() on the frame in the slot (tracking state is shared with detect()); the image buffer
+ * (set_img_buffer/set_rgba_buffer) is not changed
+ *
+ * @param slot the slot
+ *
+ * @return pointer to t_atagjs_det_bin structure; NULL on error or if the slot is not committed. The data in this memory
+ *         location must be consumed before the next call to detect_bin() or ring_detect()
+ */
+t_atagjs_det_bin *atagjs_ring_detect(int slot);
+
+/**
+ * @brief Release a frame ring slot without detecting (e.g. to drop a frame)
+ *
+ * @param slot the slot
+ *
+ * @return 0=success; -1 if the slot is invalid
+ */
+int atagjs_ring_release(int slot);
+
+/**
+ * @brief Enable/disable tracking mode (disabled by default)
+ *
+ * When tracking, the detector keeps the last detections of each tag and first searches padded regions around their
+ * predicted corners; it scans the full frame every keyframe_interval frames, when no tags are tracked, or when a
+ * tracked tag is not found in its region (new tags are only found on full-frame scans). Changing options resets the tracks
+ *
+ * @param enable 0=disable; enable otherwise
+ * @param keyframe_interval do a full-frame scan at least every keyframe_interval frames
+ * @param roi_padding padding around the predicted corners of a tag, as a fraction of the tag size (e.g. 0.5)
+ *
+ * @return 0=success
+ */
+int atagjs_set_tracking(int enable, int keyframe_interval, float roi_padding);
+
+/**
+ * @brief Enable/disable motion gating (disabled by default): frames of a static scene return the results of the last
+ *        frame detected instead of running the detector
+ *
+ * Before detecting, the frame is compared to the last frame detected over a heavily downsampled copy (a grid of
+ * MOTION_GATE_GRID_W x MOTION_GATE_GRID_H cells, a few samples each; RGBA frames by luma, before any conversion). When
+ * the mean absolute difference of the samples of every cell is within threshold, the records (and poses) of the last
+ * frame detected are returned: frame stats reused is set, and detect_bin() has ATAGJS_DET_BIN_REUSED in its flags. A
+ * frame is detected after refresh_interval frames reused in a row, when its size changes, and after the detector options,
+ * families, tag sizes or camera intrinsics change. Applies to detect(), detect_bin() and ring_detect(); frames cut short
+ * by the deadline are not reused
+ *
+ * @param enable 0=disable; enable otherwise
+ * @param threshold largest mean absolute difference of a cell (gray levels) of an unchanged frame (e.g. 6; above the
+ *        sensor noise of the camera)
+ * @param refresh_interval most frames reused in a row (e.g. 30); 0=no limit
+ *
+ * @return 0=success
+ */
+int atagjs_set_motion_gate(int enable, int threshold, int refresh_interval);
+
+/**
+ * @brief Enable/disable fused conversion of the RGBA input (set_rgba_buffer) (disabled by default)
+ *
+ * The RGBA input is converted to grayscale and decimated in one pass, reading only the pixels the decimation samples,
+ * straight into the image the detector thresholds. Candidate quads are found in that image, and only the regions around
+ * them are converted at full resolution for the detector to refine and decode. Frames without candidates are never
+ * converted at full resolution. Applies when quad_decimate >= 2 and quad_sigma = 0; with too many candidates the full
+ * frame is converted (as when disabled). Detections can differ slightly from a full-frame scan, as the detector runs on
+ * regions around the candidates
+ *
+ * @param enable 0=disable; enable otherwise
+ *
+ * @return 0=success
+ */
+int atagjs_set_fused_input(int enable);
+
+/**
+ * @brief Enable/disable adaptive decimation (disabled by default): decimation is adjusted frame by frame to keep the
+ *        time of each detect call within a budget, e.g. to hold a frame rate on slower devices
+ *
+ * Each detect(), detect_bin(), detect_image() and ring_detect() call is timed (conversion, detector, pose and json).
+ * While the time (median of the last few frames) is over budget, decimation goes up one step (1, 1.5, 2, 3, 4, 5, 6, 8)
+ * at a time, as long as the smallest tag of the last frame stays large enough to be found (12 pixels per side once
+ * decimated); if it cannot, edge refinement is turned off (adapt_refine). When the time predicted for one step less
+ * fits the budget with some headroom, edge refinement is turned back on, then decimation goes down.
+ * The settings each frame was detected with are in the frame stats (quad_decimate, refine_edges). Changing the detector
+ * options restarts the controller from the new decimation
+ *
+ * @param target_ms frame time budget, in milliseconds; <= 0 disables (the decimate and refine_edges options are restored)
+ * @param min_decimate smallest decimation (>= 1)
+ * @param max_decimate largest decimation (>= min_decimate)
+ * @param adapt_refine 0=edge refinement is left as set in the detector options; turned off when over budget otherwise
+ *        (it is never turned on if the refine_edges option is off)
+ *
+ * @return 0=success; -1 on invalid arguments
+ */
+int atagjs_set_auto_decimate(double target_ms, float min_decimate, float max_decimate, int adapt_refine);
+
+/**
+ * @brief Set a deadline for each detect call (none by default), so a cluttered frame returns partial results instead of
+ *        taking several times longer than usual
+ *
+ * Frames run through the detector as without a deadline while the time of the last full-frame scan predicts the next
+ * one fits. When it predicts an overrun (e.g. a cluttered scene), detection runs in two steps instead: the candidate
+ * quads of the whole frame are found first (thresholding, segmentation and quad fitting, which cannot be stopped), and
+ * ranked by size and edge contrast; the detector then refines and decodes the region around each candidate, highest
+ * ranked first, until the deadline. Once it expires, no more candidates are decoded, and the pose of the remaining
+ * detections is not estimated; the frame is flagged as truncated (frame stats truncated; ATAGJS_DET_BIN_TRUNCATED in
+ * the flags of detect_bin()). The first frame is a full-frame scan (there is nothing to predict from yet). The
+ * deadline counts from the start of the call (including the RGBA conversion). Applies to detect(), detect_bin(),
+ * detect_image() and ring_detect() (not to batches), when quad_sigma = 0 (a blurred frame is detected as without a deadline, except for
+ * pose); in tracking mode, the regions of the tracked tags are searched until the deadline
+ *
+ * @param deadline_ms time budget of each detect call, in milliseconds; <= 0 for no deadline
+ *
+ * @return 0=success
+ */
+int atagjs_set_deadline(double deadline_ms);
+
+/**
+ * @brief Set a heap budget: the largest frame and the most tags the detector must handle (none by default); used by
+ *        the fixed-heap WASM build, where the heap cannot grow and running out of it mid-frame would abort the module
+ *
+ * Preallocates the input buffers and the heap for the detector intermediates (see atagjs_reserve()), the records and
+ * the json output for the largest frame and tags. Then, frames larger than the budget are refused (set_img_buffer(),
+ * set_rgba_buffer(), reserve() and ring_acquire() fail); detections past max_tags are not returned; and each detect
+ * call first checks that the heap has room for the detector intermediates of the frame (ATAGJS_HEAP_BYTES_PER_PIXEL
+ * per pixel of the decimated frame, ATAGJS_HEAP_BYTES_PER_TAG per tag). The heap for the largest frame and tags is
+ * allocated in one block (and released) here, after the records and json; a frame within the budget needs no more, so
+ * the check of each frame costs nothing while the context's buffers do not grow. Once they grow (e.g. the pose arena,
+ * on the first frames with poses), the next frame allocates that block again (or, if it no longer fits, one for its
+ * own intermediates). Allocations made outside the context after the budget is set are not tracked. If the heap has
+ * no room, the frame is not detected: detect() returns an error result, detect_bin() and ring_detect() return NULL,
+ * and the frame stats have over_budget set. The fixed-heap build (make apriltag_wasm_fixed.js) sets the budget it was
+ * sized for at atagjs_init()
+ *
+ * @param max_width Width of the largest frame; 0 to remove the budget
+ * @param max_height Height of the largest frame; 0 to remove the budget
+ * @param max_tags Most tags returned per frame (>= 1)
+ *
+ * @return 0=success; -1 on invalid arguments, or if the buffers or the intermediates of the largest frame could not be
+ *         allocated (the heap is too small)
+ *
+ * @warning the input buffers might move; call set_img_buffer (or set_rgba_buffer) after, to get their pointer
+ */
+int atagjs_set_heap_budget(int max_width, int max_height, int max_tags);
+
+/**
+ * @brief Enable/disable the detector stage breakdown and pipeline counters in the frame stats (disabled by default)
+ *
+ * @param enable 0=only total detection, pose and json times; stage breakdown and counters otherwise
+ *
+ * @return 0=success
+ */
+int atagjs_set_frame_stats(int enable);
+
+/**
+ * @brief Get the timing and counters of the last frame processed (by the default context)
+ *
+ * @return pointer to the frame stats (updated at every detect() and detect_bin() call); NULL if the detector is not initialized
+ */
+const t_atagjs_frame_stats *atagjs_get_frame_stats();
+
+/**
+ * @brief Get a record from the binary detection output
+ *
+ * @param bin binary output returned by atagjs_detect_bin()
+ * @param i index of the record
+ *
+ * @return pointer to the record; NULL if i is out of range
+ */
+const t_atagjs_det_record *atagjs_det_bin_get(const t_atagjs_det_bin *bin, int i);
+
+/**
+ * @brief Get the records of a frame from the binary detection output of a batch
+ *
+ * @param batch binary output returned by atagjs_detect_batch()
+ * @param frame index of the frame in the batch
+ * @param len where to write the number of records of the frame (can be NULL)
+ *
+ * @return pointer to the first record of the frame; NULL if frame is out of range
+ */
+const t_atagjs_det_record *atagjs_det_batch_get(const t_atagjs_det_batch *batch, int frame, int *len);
+
 #endif
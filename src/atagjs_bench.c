@@ -0,0 +1,274 @@
+/** @file atagjs_bench.c
+ *  @brief Benchmark program; runs the detector over a set of image files several times and reports throughput and latency
+ *
+ *  Images are loaded once; each frame is then copied into the detector buffer and processed with atagjs_detect(), as
+ *  when the detector is running in a WASM module. Reports frames/s and latency percentiles of the whole detect() call
+ *  and of its detection (and detector stages), pose estimation and json serialization stages, as csv or json, so
+ *  results can be compared across builds and detector options.
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "apriltag.h"
+
+#include "common/getopt.h"
+#include "common/image_u8.h"
+#include "common/pjpeg.h"
+#include "common/zarray.h"
+#include "common/time_util.h"
+
+#include "apriltag_js.h"
+#include "img_convert.h"
+
+// stages we report
+enum { STAGE_TOTAL = 0, STAGE_CONVERT, STAGE_DETECT, STAGE_DECIMATE, STAGE_BLUR, STAGE_THRESHOLD, STAGE_UNIONFIND, STAGE_CLUSTERS, STAGE_QUAD_FIT, STAGE_DECODE, STAGE_POSE, STAGE_JSON, NSTAGES };
+static const char *stage_names[NSTAGES] = { "total", "convert", "detect", "decimate", "blur", "threshold", "unionfind", "clusters", "quad_fit", "decode", "pose", "json" };
+
+/**
+ * @brief Latency summary of one stage, in microseconds
+ */
+typedef struct {
+    double mean, p50, p90, p99, max;
+} t_latency;
+
+/**
+ * @brief Load a pnm/pgm or jpg image
+ *
+ * @return the image; NULL on failure
+ */
+static image_u8_t *load_image(const char *path)
+{
+    if (str_ends_with(path, "pnm") || str_ends_with(path, "PNM") ||
+        str_ends_with(path, "pgm") || str_ends_with(path, "PGM"))
+        return image_u8_create_from_pnm(path);
+
+    if (str_ends_with(path, "jpg") || str_ends_with(path, "JPG"))
+    {
+        int err = 0;
+        pjpeg_t *pjpeg = pjpeg_create_from_file(path, 0, &err);
+        if (pjpeg == NULL) return NULL;
+        image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+        pjpeg_destroy(pjpeg);
+        return im;
+    }
+
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+/**
+ * @brief Nearest-rank percentile of sorted values
+ */
+static double percentile(const double *sorted, int n, double p)
+{
+    int idx = (int)ceil(p / 100.0 * n) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return sorted[idx];
+}
+
+/**
+ * @brief Summarize samples (sorts them in place)
+ */
+static t_latency summarize(double *samples, int n)
+{
+    t_latency l = { 0 };
+    if (n == 0) return l;
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += samples[i];
+    qsort(samples, n, sizeof(double), cmp_double);
+    l.mean = sum / n;
+    l.p50 = percentile(samples, n, 50);
+    l.p90 = percentile(samples, n, 90);
+    l.p99 = percentile(samples, n, 99);
+    l.max = samples[n - 1];
+    return l;
+}
+
+int main(int argc, char *argv[])
+{
+    getopt_t *getopt = getopt_create();
+
+    getopt_add_bool(getopt, 'h', "help", 0, "Show this help");
+    getopt_add_int(getopt, 'i', "iters", "10", "Repeat processing on input set this many times");
+    getopt_add_int(getopt, 'w', "warmup", "1", "Untimed iterations over the input set before measuring");
+    getopt_add_int(getopt, 't', "threads", "1", "Use this many CPU threads");
+    getopt_add_double(getopt, 'x', "decimate", "2.0", "Decimate input image by this factor");
+    getopt_add_double(getopt, 'b', "blur", "0.0", "Apply low-pass blur to input; negative sharpens");
+    getopt_add_bool(getopt, '0', "refine-edges", 1, "Spend more time trying to align edges of tags");
+    getopt_add_int(getopt, 'p', "output-pose", "1", "Return pose (0=no pose; 1=full pose; 2=fast pose)");
+    getopt_add_bool(getopt, 's', "output-pose-sol", 1, "Return pose solutions");
+    getopt_add_bool(getopt, 'r', "rgba", 0, "Pass RGBA frames (as from a canvas) and let the detector convert them to grayscale");
+    getopt_add_string(getopt, 'f', "format", "csv", "Output format (csv or json)");
+
+    if (argc == 1 || !getopt_parse(getopt, argc, argv, 1) || getopt_get_bool(getopt, "help"))
+    {
+        printf("Usage: %s [options] <input files>\n", argv[0]);
+        getopt_do_usage(getopt);
+        exit(0);
+    }
+
+    const zarray_t *inputs = getopt_get_extra_args(getopt);
+
+    int iters = getopt_get_int(getopt, "iters");
+    int warmup = getopt_get_int(getopt, "warmup");
+    int nthreads = getopt_get_int(getopt, "threads");
+    double quad_decimate = getopt_get_double(getopt, "decimate");
+    double quad_sigma = getopt_get_double(getopt, "blur");
+    bool refine_edges = getopt_get_bool(getopt, "refine-edges");
+    int output_pose = getopt_get_int(getopt, "output-pose");
+    bool output_pose_solutions = getopt_get_bool(getopt, "output-pose-sol");
+    if (!output_pose) output_pose_solutions = 0;
+    bool rgba = getopt_get_bool(getopt, "rgba");
+    bool json = strcmp(getopt_get_string(getopt, "format"), "json") == 0;
+
+    // load all images once
+    zarray_t *images = zarray_create(sizeof(image_u8_t *));
+    for (int input = 0; input < zarray_size(inputs); input++)
+    {
+        char *path;
+        zarray_get(inputs, input, &path);
+        image_u8_t *im = load_image(path);
+        if (im == NULL)
+        {
+            fprintf(stderr, "couldn't load %s\n", path);
+            continue;
+        }
+        zarray_add(images, &im);
+    }
+    int nimages = zarray_size(images);
+    if (nimages == 0 || iters <= 0)
+    {
+        fprintf(stderr, "nothing to do\n");
+        zarray_destroy(images);
+        getopt_destroy(getopt);
+        return 1;
+    }
+
+    if (atagjs_init() != 0) return 1;
+    if (nthreads > atagjs_max_threads()) nthreads = atagjs_max_threads(); // report the threads actually used
+    atagjs_set_detector_options(quad_decimate, quad_sigma, nthreads, refine_edges, 0, output_pose, output_pose_solutions);
+    atagjs_set_frame_stats(1);
+
+    // camera parameters from ipad where tag photos were taken, for the sake of outputing some pose values
+    atagjs_set_pose_info(997.5703125, 997.5703125, 636.783203125, 360.4857482910);
+
+    // RGBA frames (gray replicated in R, G and B, opaque alpha), as the javascript side gets them from a canvas
+    uint8_t **rgba_frames = calloc(nimages, sizeof(uint8_t *));
+    for (int i = 0; rgba && i < nimages; i++)
+    {
+        image_u8_t *im;
+        zarray_get(images, i, &im);
+        rgba_frames[i] = malloc((size_t)im->width * im->height * 4);
+        for (int y = 0; y < im->height; y++)
+            for (int x = 0; x < im->width; x++)
+            {
+                uint8_t *p = rgba_frames[i] + ((size_t)y * im->width + x) * 4;
+                p[0] = p[1] = p[2] = im->buf[y * im->stride + x];
+                p[3] = 255;
+            }
+    }
+
+    int nframes = nimages * iters;
+    double *samples[NSTAGES];
+    for (int s = 0; s < NSTAGES; s++) samples[s] = calloc(nframes, sizeof(double));
+
+    int64_t bench_start = 0;
+    int frame = 0;
+    for (int iter = -warmup; iter < iters; iter++)
+    {
+        if (iter == 0) bench_start = utime_now();
+        for (int i = 0; i < nimages; i++)
+        {
+            image_u8_t *im;
+            zarray_get(images, i, &im);
+
+            // copy the image into the detector buffer, as the javascript side does
+            if (rgba)
+            {
+                uint8_t *dimg = atagjs_set_rgba_buffer(im->width, im->height, im->width);
+                memcpy(dimg, rgba_frames[i], (size_t)im->width * im->height * 4);
+            }
+            else
+            {
+                uint8_t *dimg = atagjs_set_img_buffer(im->width, im->height, im->stride);
+                memcpy(dimg, im->buf, im->height * im->stride);
+            }
+
+            int64_t start = utime_now();
+            atagjs_detect();
+            int64_t end = utime_now();
+
+            if (iter < 0) continue;
+
+            const t_atagjs_frame_stats *stats = atagjs_get_frame_stats();
+            samples[STAGE_TOTAL][frame] = end - start;
+            samples[STAGE_CONVERT][frame] = stats->convert_us;
+            samples[STAGE_DETECT][frame] = stats->detect_us;
+            samples[STAGE_DECIMATE][frame] = stats->decimate_us;
+            samples[STAGE_BLUR][frame] = stats->blur_us;
+            samples[STAGE_THRESHOLD][frame] = stats->threshold_us;
+            samples[STAGE_UNIONFIND][frame] = stats->unionfind_us;
+            samples[STAGE_CLUSTERS][frame] = stats->clusters_us;
+            samples[STAGE_QUAD_FIT][frame] = stats->quad_fit_us;
+            samples[STAGE_DECODE][frame] = stats->decode_us;
+            samples[STAGE_POSE][frame] = stats->pose_us;
+            samples[STAGE_JSON][frame] = stats->json_us;
+            frame++;
+        }
+    }
+    double elapsed_s = (utime_now() - bench_start) / 1.0e6;
+    double fps = elapsed_s > 0 ? nframes / elapsed_s : 0;
+
+    t_latency lat[NSTAGES];
+    for (int s = 0; s < NSTAGES; s++) lat[s] = summarize(samples[s], nframes);
+
+    if (json)
+    {
+        printf("{\"config\": {\"decimate\": %.2f, \"blur\": %.2f, \"threads\": %d, \"refine_edges\": %d, \"pose\": %d, \"pose_solutions\": %d, \"rgba\": %d, \"kernels\": \"%s\", \"images\": %d, \"iters\": %d}, ",
+               quad_decimate, quad_sigma, nthreads, refine_edges, output_pose, output_pose_solutions, rgba, img_convert_impl(), nimages, iters);
+        printf("\"frames\": %d, \"fps\": %.2f, \"stages\": {", nframes, fps);
+        for (int s = 0; s < NSTAGES; s++)
+            printf("%s\"%s\": {\"mean_us\": %.1f, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f}",
+                   s > 0 ? ", " : "", stage_names[s], lat[s].mean, lat[s].p50, lat[s].p90, lat[s].p99, lat[s].max);
+        printf("}}\n");
+    }
+    else
+    {
+        // configuration is repeated on every row so outputs of several runs can be concatenated
+        printf("decimate,blur,threads,refine_edges,pose,pose_solutions,rgba,kernels,images,iters,frames,fps,stage,mean_us,p50_us,p90_us,p99_us,max_us\n");
+        for (int s = 0; s < NSTAGES; s++)
+            printf("%.2f,%.2f,%d,%d,%d,%d,%d,%s,%d,%d,%d,%.2f,%s,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                   quad_decimate, quad_sigma, nthreads, refine_edges, output_pose, output_pose_solutions, rgba, img_convert_impl(), nimages, iters, nframes, fps,
+                   stage_names[s], lat[s].mean, lat[s].p50, lat[s].p90, lat[s].p99, lat[s].max);
+    }
+
+    for (int s = 0; s < NSTAGES; s++) free(samples[s]);
+    for (int i = 0; i < nimages; i++) free(rgba_frames[i]);
+    free(rgba_frames);
+    for (int i = 0; i < nimages; i++)
+    {
+        image_u8_t *im;
+        zarray_get(images, i, &im);
+        image_u8_destroy(im);
+    }
+    zarray_destroy(images);
+
+    atagjs_destroy();
+
+    getopt_destroy(getopt);
+
+    return 0;
+}
@@ -1,6 +1,17 @@
 /** @file apriltag_example.c
  *  @brief Example program that get the detrector output by giving it image files
  *
+ *  With --stream, it reads a video stream instead (Y4M or raw grayscale frames, e.g. from a pipe or FIFO) and outputs
+ *  one json line per frame (NDJSON):
+ *  { "frame": <frame number>, "read_us": <time read>, "done_us": <time detected>, "dropped": <frames dropped so far>,
+ *    "detections": <detections, as returned by detect()> }
+ *  (times in microseconds since the epoch)
+ *
+ *  With --jobs N, the input files (or the image files in input directories) are processed as a dataset by N threads,
+ *  each with its own detector context, and the results are output one json line per file, in input order:
+ *  { "file": <path>, "detections": <detections, as returned by detect()> }
+ *  8-bit binary PGM files are memory-mapped and detected on the mapped pixels, without copies
+ *
  *  This file is based on apritag library examples. Copyright notice below.
  *  @date June, 2020
  */
@@ -39,10 +50,17 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <inttypes.h>
 #include <ctype.h>
 #include <unistd.h>
 #include <math.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "apriltag.h"
 #include "tag36h11.h"
@@ -52,8 +70,374 @@
 #include "common/image_u8x4.h"
 #include "common/pjpeg.h"
 #include "common/zarray.h"
+#include "common/time_util.h"
 
 #include "apriltag_js.h"
+#include "frame_stream.h"
+#include "str_json.h"
+
+// results a dataset worker can get ahead of the next result output, per worker (bounds the results waiting for output)
+#define DATASET_WINDOW_PER_WORKER 16
+
+/**
+ * @brief A dataset being processed: its files, and their results (json lines) until they are output in order
+ */
+typedef struct {
+        char **paths;
+        int npaths;
+        t_str_json *results;    // result of each file; .str is NULL until the file is processed
+        int next;               // next file to process (workers take files with an atomic add)
+        int output;             // files output
+        int window;             // a worker waits before processing file i >= output + window
+        pthread_mutex_t lock;
+        pthread_cond_t cond;    // a result is ready, or results were output
+} t_dataset;
+
+/**
+ * @brief A dataset worker; has its own detector context
+ */
+typedef struct {
+        t_dataset *ds;
+        atagjs_ctx_t *ctx;
+        pthread_t thread;
+} t_dataset_worker;
+
+/**
+ * @brief Load an image file (PNM/PGM or JPG)
+ *
+ * @return the image (destroy with image_u8_destroy()); NULL on failure
+ */
+static image_u8_t *load_image(const char *path)
+{
+        if (str_ends_with(path, "pnm") || str_ends_with(path, "PNM") ||
+            str_ends_with(path, "pgm") || str_ends_with(path, "PGM"))
+                return image_u8_create_from_pnm(path);
+
+        if (str_ends_with(path, "jpg") || str_ends_with(path, "JPG"))
+        {
+                int err = 0;
+                pjpeg_t *pjpeg = pjpeg_create_from_file(path, 0, &err);
+                if (pjpeg == NULL)
+                {
+                        printf("pjpeg error %d\n", err);
+                        return NULL;
+                }
+                image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+                pjpeg_destroy(pjpeg);
+                return im;
+        }
+        return NULL;
+}
+
+/**
+ * @brief Memory-map a binary 8-bit PGM file (P5, maxval < 256); the image points to the mapped pixels
+ *
+ * The mapping is private: the file is never written
+ *
+ * @return the mapping (release with munmap(map, *map_size)); NULL if the file is not an 8-bit binary PGM, or could not
+ *         be mapped
+ */
+static void *map_pgm(const char *path, size_t *map_size, image_u8_t *im)
+{
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return NULL;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 3)
+        {
+                close(fd);
+                return NULL;
+        }
+        size_t size = st.st_size;
+        uint8_t *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) return NULL;
+
+        // header: "P5" <width> <height> <maxval>, separated by whitespace (and comments), then one whitespace character
+        int fields[3];
+        size_t p = 2;
+        int ok = (map[0] == 'P' && map[1] == '5');
+        for (int i = 0; ok && i < 3; i++)
+        {
+                while (p < size && (isspace(map[p]) || map[p] == '#'))
+                {
+                        if (map[p] == '#') while (p < size && map[p] != '\n') p++;
+                        else p++;
+                }
+                if (p >= size || !isdigit(map[p])) ok = 0;
+                fields[i] = 0;
+                while (ok && p < size && isdigit(map[p]))
+                {
+                        fields[i] = fields[i] * 10 + (map[p++] - '0');
+                        if (fields[i] > 1000000) ok = 0;
+                }
+        }
+        p++;
+        if (!ok || fields[0] <= 0 || fields[1] <= 0 || fields[2] <= 0 || fields[2] > 255 ||
+            p + (size_t)fields[0] * fields[1] > size)
+        {
+                munmap(map, size);
+                return NULL;
+        }
+
+        *im = (image_u8_t) {.width = fields[0], .height = fields[1], .stride = fields[0], .buf = map + p};
+        *map_size = size;
+        return map;
+}
+
+/**
+ * @brief Detect tags in a file of a dataset, and format its result (json line)
+ */
+static void dataset_detect_file(atagjs_ctx_t *ctx, const char *path, t_str_json *result)
+{
+        str_json_create(result, STR_DET_LEN);
+        str_json_concat(result, "{ \"file\": \"");
+        for (const char *c = path; *c != '\0'; c++)
+        {
+                if (*c == '"' || *c == '\\') str_json_append(result, "\\", 1);
+                str_json_append(result, c, 1);
+        }
+        str_json_concat(result, "\", \"detections\": ");
+
+        // 8-bit binary PGM files are detected on the mapped pixels; other files are loaded
+        image_u8_t im, *loaded = NULL;
+        size_t map_size = 0;
+        void *map = NULL;
+        if (str_ends_with(path, "pgm") || str_ends_with(path, "PGM") || str_ends_with(path, "pnm") || str_ends_with(path, "PNM"))
+                map = map_pgm(path, &map_size, &im);
+        if (map == NULL)
+        {
+                loaded = load_image(path);
+                if (loaded != NULL) im = *loaded;
+        }
+
+        if (map == NULL && loaded == NULL)
+                str_json_concat(result, "{ \"result\": \"Could not load image.\" }");
+        else
+                str_json_concat(result, atagjs_ctx_detect_image(ctx, im.buf, im.width, im.height, im.stride)->str);
+        str_json_concat(result, " }\n");
+
+        if (map != NULL) munmap(map, map_size);
+        if (loaded != NULL) image_u8_destroy(loaded);
+}
+
+/**
+ * @brief Dataset worker thread: processes the next file of the dataset until there are no more files
+ */
+static void *dataset_worker_run(void *arg)
+{
+        t_dataset_worker *worker = (t_dataset_worker *)arg;
+        t_dataset *ds = worker->ds;
+
+        int i;
+        while ((i = __atomic_fetch_add(&ds->next, 1, __ATOMIC_RELAXED)) < ds->npaths)
+        {
+                // do not get too far ahead of the output
+                pthread_mutex_lock(&ds->lock);
+                while (i >= ds->output + ds->window) pthread_cond_wait(&ds->cond, &ds->lock);
+                pthread_mutex_unlock(&ds->lock);
+
+                t_str_json result = STR_JSON_INITIALIZER;
+                dataset_detect_file(worker->ctx, ds->paths[i], &result);
+
+                pthread_mutex_lock(&ds->lock);
+                ds->results[i] = result;
+                pthread_cond_broadcast(&ds->cond);
+                pthread_mutex_unlock(&ds->lock);
+        }
+        return NULL;
+}
+
+/**
+ * @brief Add an input to the files of a dataset: a directory adds its image files (sorted by name), a file adds itself
+ *
+ * @return 0 on success; -1 on allocation failure
+ */
+static int dataset_add_input(t_dataset *ds, int *alloc, const char *path)
+{
+        struct dirent **entries = NULL;
+        int nentries = 1;
+        DIR *dir = opendir(path);
+        int is_dir = (dir != NULL);
+        if (is_dir)
+        {
+                closedir(dir);
+                nentries = scandir(path, &entries, NULL, alphasort);
+                if (nentries < 0) return 0;
+        }
+
+        for (int e = 0; e < nentries; e++)
+        {
+                char *file;
+                if (is_dir)
+                {
+                        const char *name = entries[e]->d_name;
+                        int image = str_ends_with(name, "pnm") || str_ends_with(name, "PNM") || str_ends_with(name, "pgm") ||
+                                    str_ends_with(name, "PGM") || str_ends_with(name, "jpg") || str_ends_with(name, "JPG");
+                        file = image ? malloc(strlen(path) + strlen(name) + 2) : NULL;
+                        if (file != NULL) sprintf(file, "%s/%s", path, name);
+                        free(entries[e]);
+                        if (!image) continue;
+                }
+                else file = strdup(path);
+                if (file == NULL) return -1;
+
+                if (ds->npaths == *alloc)
+                {
+                        *alloc = (*alloc > 0) ? *alloc * 2 : 1024;
+                        char **paths = realloc(ds->paths, *alloc * sizeof(char *));
+                        if (paths == NULL) return -1;
+                        ds->paths = paths;
+                }
+                ds->paths[ds->npaths++] = file;
+        }
+        free(entries);
+        return 0;
+}
+
+/**
+ * @brief Run the workers of a dataset, each with its own detector context, and output the result of each file, in
+ *        input order
+ *
+ * @return 0 on success; -1 on failure
+ */
+static int dataset_run(t_dataset *ds, int nworkers, float decimate, float sigma, int refine_edges, int max_detections, int return_pose, int return_solutions)
+{
+        ds->results = calloc(ds->npaths > 0 ? ds->npaths : 1, sizeof(t_str_json));
+        t_dataset_worker *workers = calloc(nworkers, sizeof(t_dataset_worker));
+        if (ds->results == NULL || workers == NULL)
+        {
+                free(ds->results);
+                free(workers);
+                return -1;
+        }
+        ds->window = nworkers * DATASET_WINDOW_PER_WORKER;
+        pthread_mutex_init(&ds->lock, NULL);
+        pthread_cond_init(&ds->cond, NULL);
+
+        // one detector context per worker, each detector single-threaded: workers run in parallel on separate files
+        int nstarted = 0;
+        for (; nstarted < nworkers; nstarted++)
+        {
+                t_dataset_worker *w = &workers[nstarted];
+                w->ds = ds;
+                w->ctx = atagjs_ctx_create();
+                if (w->ctx == NULL) break;
+                atagjs_ctx_set_detector_options(w->ctx, decimate, sigma, 1, refine_edges, max_detections, return_pose, return_solutions);
+                atagjs_ctx_set_pose_info(w->ctx, 997.5703125, 997.5703125, 636.783203125, 360.4857482910);
+                if (pthread_create(&w->thread, NULL, dataset_worker_run, w) != 0)
+                {
+                        atagjs_ctx_destroy(w->ctx);
+                        break;
+                }
+        }
+
+        // output the results in input order, as they are ready
+        for (int i = 0; nstarted > 0 && i < ds->npaths; i++)
+        {
+                pthread_mutex_lock(&ds->lock);
+                while (ds->results[i].str == NULL) pthread_cond_wait(&ds->cond, &ds->lock);
+                pthread_mutex_unlock(&ds->lock);
+
+                fputs(ds->results[i].str, stdout);
+                str_json_destroy(&ds->results[i]);
+
+                pthread_mutex_lock(&ds->lock);
+                ds->output = i + 1;
+                pthread_cond_broadcast(&ds->cond);
+                pthread_mutex_unlock(&ds->lock);
+        }
+
+        for (int w = 0; w < nstarted; w++)
+        {
+                pthread_join(workers[w].thread, NULL);
+                atagjs_ctx_destroy(workers[w].ctx);
+        }
+        free(workers);
+        free(ds->results);
+        pthread_mutex_destroy(&ds->lock);
+        pthread_cond_destroy(&ds->cond);
+        return (nstarted > 0) ? 0 : -1;
+}
+
+/**
+ * @brief Detect tags in the files of a dataset with a pool of workers, and output a json line per file, in input order
+ *
+ * @param inputs input files and directories
+ * @param nworkers number of workers (threads)
+ * @param decimate, sigma, refine_edges, max_detections, return_pose, return_solutions detector options
+ *
+ * @return 0 on success; -1 on failure
+ */
+static int detect_dataset(const zarray_t *inputs, int nworkers, float decimate, float sigma, int refine_edges, int max_detections, int return_pose, int return_solutions)
+{
+        t_dataset ds = {0};
+        int alloc = 0, ret = 0;
+        for (int input = 0; ret == 0 && input < zarray_size(inputs); input++)
+        {
+                char *path;
+                zarray_get(inputs, input, &path);
+                ret = dataset_add_input(&ds, &alloc, path);
+        }
+        if (ret == 0) ret = dataset_run(&ds, nworkers, decimate, sigma, refine_edges, max_detections, return_pose, return_solutions);
+
+        for (int i = 0; i < ds.npaths; i++) free(ds.paths[i]);
+        free(ds.paths);
+        return ret;
+}
+
+/**
+ * @brief Detect tags in the frames of a video stream, and output a json line per frame
+ *
+ * @param path where to read the stream from ("-" is stdin)
+ * @param format stream format name (y4m or gray)
+ * @param width, height frame size (gray streams)
+ * @param nbuffers frame buffers of the stream
+ * @param drop_oldest if frames waiting for detection are dropped when detection falls behind (=0 the stream waits)
+ *
+ * @return 0 on success; -1 if the stream could not be opened
+ */
+static int detect_stream(const char *path, const char *format, int width, int height, int nbuffers, int drop_oldest)
+{
+        FILE *f = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+        if (f == NULL)
+        {
+                fprintf(stderr, "couldn't open %s\n", path);
+                return -1;
+        }
+
+        int fmt = (strcmp(format, "gray") == 0) ? FRAME_STREAM_GRAY : FRAME_STREAM_Y4M;
+        t_frame_stream *fs = frame_stream_open(f, fmt, width, height, nbuffers,
+                                               drop_oldest ? FRAME_STREAM_DROP_OLDEST : FRAME_STREAM_BLOCK);
+        if (fs == NULL)
+        {
+                fprintf(stderr, "couldn't read a %s stream from %s (gray streams need --width and --height)\n", format, path);
+                if (f != stdin) fclose(f);
+                return -1;
+        }
+
+        // all frames have the same size; buffers are allocated once
+        int w = frame_stream_width(fs), h = frame_stream_height(fs);
+        atagjs_reserve(w, h);
+
+        const t_stream_frame *frame;
+        while ((frame = frame_stream_next(fs)) != NULL)
+        {
+                uint8_t *dimg = atagjs_set_img_buffer(w, h, w);
+                if (dimg == NULL) break;
+                memcpy(dimg, frame->buf, (size_t)w * h);
+
+                t_str_json *detjson = atagjs_detect();
+                const t_atagjs_frame_stats *stats = atagjs_get_frame_stats();
+
+                printf("{ \"frame\": %" PRId64 ", \"read_us\": %" PRId64 ", \"done_us\": %" PRId64 ", \"dropped\": %" PRId64 ", \"decimate\": %g, \"refine_edges\": %d, \"truncated\": %d, \"detections\": %s }\n",
+                       frame->number, frame->read_us, utime_now(), frame_stream_dropped(fs), stats->quad_decimate, stats->refine_edges, stats->truncated, detjson->str);
+                fflush(stdout); // one line per frame, as it is detected
+        }
+
+        frame_stream_close(fs);
+        if (f != stdin) fclose(f);
+        return 0;
+}
 
 int main(int argc, char *argv[])
 {
@@ -69,12 +453,22 @@ int main(int argc, char *argv[])
         getopt_add_double(getopt, 'b', "blur", "0.0", "Apply low-pass blur to input; negative sharpens");
         getopt_add_bool(getopt, '0', "refine-edges", 1, "Spend more time trying to align edges of tags");
         getopt_add_int(getopt, 'm', "max-detections", "0", "Maximum detections to return (0=return all)");
-        getopt_add_bool(getopt, 'p', "output-pose", 1, "Return pose");
+        getopt_add_int(getopt, 'p', "output-pose", "1", "Return pose (0=no pose; 1=full pose; 2=fast pose)");
         getopt_add_bool(getopt, 's', "output-pose-sol", 1, "Return pose solutions");
+        getopt_add_string(getopt, 'S', "stream", "", "Read a video stream from this file or FIFO ('-' = stdin) instead of image files; outputs a json line per frame");
+        getopt_add_string(getopt, 'F', "stream-format", "y4m", "Stream format: y4m, or gray (raw 8-bit grayscale frames; needs --width and --height)");
+        getopt_add_int(getopt, 'W', "width", "0", "Frame width of gray streams");
+        getopt_add_int(getopt, 'H', "height", "0", "Frame height of gray streams");
+        getopt_add_int(getopt, 'B', "stream-buffers", "4", "Stream frame buffers (frame detected, frame being read, and frames waiting)");
+        getopt_add_bool(getopt, 'D', "drop-oldest", 0, "Drop the oldest waiting frame when detection falls behind (the stream waits otherwise)");
+        getopt_add_double(getopt, 'T', "target-ms", "0", "Adapt decimation (and edge refinement) to keep each frame within this many milliseconds (0=fixed decimation)");
+        getopt_add_double(getopt, 'L', "deadline-ms", "0", "Return the detections found after this many milliseconds per frame (0=no deadline)");
+        getopt_add_int(getopt, 'j', "jobs", "0", "Process the input files (and directories) as a dataset with this many threads, and output a json line per file, in order (0=one file at a time)");
 
         if (argc==1 || !getopt_parse(getopt, argc, argv, 1) || getopt_get_bool(getopt, "help"))
         {
                 printf("Usage: %s [options] <input files>\n", argv[0]);
+                printf("       %s [options] --stream <file|fifo|->\n", argv[0]);
                 getopt_do_usage(getopt);
                 exit(0);
         }
@@ -88,7 +482,7 @@ int main(int argc, char *argv[])
         bool refine_edges = getopt_get_bool(getopt, "refine-edges");
 
         int max_detections = getopt_get_int(getopt, "max-detections");
-        bool output_pose = getopt_get_bool(getopt, "output-pose");
+        int output_pose = getopt_get_int(getopt, "output-pose");
         bool output_pose_solutions = getopt_get_bool(getopt, "output-pose-sol");
         if (!output_pose) output_pose_solutions = 0;
         int quiet = getopt_get_bool(getopt, "quiet");
@@ -102,57 +496,72 @@ int main(int argc, char *argv[])
         // camera parameters from ipad where tag photos were taken, for the sake of outputing some pose values
         atagjs_set_pose_info(997.5703125, 997.5703125, 636.783203125, 360.4857482910); // double fx, double fy, double cx, double cy
 
-        for (int input = 0; input < zarray_size(inputs); input++)
+        // double target_ms, float min_decimate, float max_decimate, int adapt_refine
+        double target_ms = getopt_get_double(getopt, "target-ms");
+        if (target_ms > 0) atagjs_set_auto_decimate(target_ms, 1.0, 4.0, 1);
+        atagjs_set_deadline(getopt_get_double(getopt, "deadline-ms"));
+
+        const char *stream = getopt_get_string(getopt, "stream");
+        if (stream != NULL && stream[0] != '\0')
         {
-                char *path;
-                zarray_get(inputs, input, &path);
-                if (!quiet)
-                        printf("loading %s\n", path);
-
-                image_u8_t *im = NULL;
-                if (str_ends_with(path, "pnm") || str_ends_with(path, "PNM") ||
-                    str_ends_with(path, "pgm") || str_ends_with(path, "PGM"))
-                        im = image_u8_create_from_pnm(path);
-                else if (str_ends_with(path, "jpg") || str_ends_with(path, "JPG"))
-                {
-                        int err = 0;
-                        pjpeg_t *pjpeg = pjpeg_create_from_file(path, 0, &err);
-                        if (pjpeg == NULL)
-                        {
-                                printf("pjpeg error %d\n", err);
-                                continue;
-                        }
+                int ret = detect_stream(stream, getopt_get_string(getopt, "stream-format"),
+                                        getopt_get_int(getopt, "width"), getopt_get_int(getopt, "height"),
+                                        getopt_get_int(getopt, "stream-buffers"), getopt_get_bool(getopt, "drop-oldest"));
+                atagjs_destroy();
+                getopt_destroy(getopt);
+                return (ret == 0) ? 0 : 1;
+        }
 
-                        im = pjpeg_to_u8_baseline(pjpeg);
+        int jobs = getopt_get_int(getopt, "jobs");
+        if (jobs > 0)
+        {
+                int ret = detect_dataset(inputs, jobs, quad_decimate, quad_sigma, refine_edges, max_detections, output_pose, output_pose_solutions);
+                atagjs_destroy();
+                getopt_destroy(getopt);
+                return (ret == 0) ? 0 : 1;
+        }
 
-                        pjpeg_destroy(pjpeg);
-                }
+        int maxiters = getopt_get_int(getopt, "iters");
 
-                if (im == NULL)
+        for (int iter = 0; iter < maxiters; iter++)
+        {
+                if (maxiters > 1 && !quiet)
+                        printf("iter %d / %d\n", iter + 1, maxiters);
+
+                for (int input = 0; input < zarray_size(inputs); input++)
                 {
-                        printf("couldn't load %s\n", path);
-                        continue;
-                }
+                        char *path;
+                        zarray_get(inputs, input, &path);
+                        if (!quiet)
+                                printf("loading %s\n", path);
+
+                        image_u8_t *im = load_image(path);
+                        if (im == NULL)
+                        {
+                                printf("couldn't load %s\n", path);
+                                continue;
+                        }
 
-                if (debug)
-                        image_u8_write_pnm(im, "detect_input.pnm");
+                        if (debug)
+                                image_u8_write_pnm(im, "detect_input.pnm");
 
-                // copy the image into the detector buffer
-                // reproduce what needs to happen when the detector is running in a WASM module
+                        // copy the image into the detector buffer
+                        // reproduce what needs to happen when the detector is running in a WASM module
 
-                // get pointer to buffer
-                uint8_t * dimg = atagjs_set_img_buffer(im->width, im->height, im->stride);
+                        // get pointer to buffer
+                        uint8_t * dimg = atagjs_set_img_buffer(im->width, im->height, im->stride);
 
-                // copy data
-                memcpy(dimg, im->buf, im->height*im->stride);
+                        // copy data
+                        memcpy(dimg, im->buf, im->height*im->stride);
 
-                // call apriltag detect
-                t_str_json *detjson = atagjs_detect();
+                        // call apriltag detect
+                        t_str_json *detjson = atagjs_detect();
 
-                printf("(%lu) %s\n",  detjson->len, detjson->str);
+                        printf("(%lu) %s\n",  detjson->len, detjson->str);
 
-                image_u8_destroy(im);
+                        image_u8_destroy(im);
 
+                }
         }
 
         printf("\n");
@@ -0,0 +1,204 @@
+/** @file atagjs_gen_tables.c
+ *  @brief Build-time generator of the tag family decode tables (tag_decode_tables.c)
+ *
+ *  Builds the decode table of each family given with the apriltag library itself (apriltag_detector_add_family_bits()),
+ *  checks that the table matches our definition of its layout (tag_decode_table.h), and writes the codes it holds as C
+ *  source (sorted, without the empty entries of the hash table), so the detector can fill the table from them instead
+ *  of computing them at startup.
+ *
+ *  Usage: atagjs_gen_tables <family>:<bits corrected> [...] > tag_decode_tables.c
+ *  e.g.: atagjs_gen_tables tag36h11:1
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "apriltag.h"
+#include "tag36h11.h"
+#include "tag25h9.h"
+#include "tag16h5.h"
+#include "tagCircle21h7.h"
+#include "tagStandard41h12.h"
+
+#include "tag_decode_table.h"
+
+// entries written per line
+#define ENTRIES_PER_LINE 8
+
+/**
+ * @brief Families we can generate tables for
+ */
+static const struct {
+    const char *name;
+    apriltag_family_t *(*create)();
+    void (*destroy)(apriltag_family_t *);
+} families[] = {
+    { "tag36h11", tag36h11_create, tag36h11_destroy },
+    { "tag25h9", tag25h9_create, tag25h9_destroy },
+    { "tag16h5", tag16h5_create, tag16h5_destroy },
+    { "tagCircle21h7", tagCircle21h7_create, tagCircle21h7_destroy },
+    { "tagStandard41h12", tagStandard41h12_create, tagStandard41h12_destroy },
+};
+
+/**
+ * @brief Check a table built by the library against our definition of its layout
+ *
+ * Every code of the family must be found with its id and no bits corrected, and the table must have one entry for each
+ * code within bits_corrected bits of a family code
+ *
+ * @return 0 if the table is as expected; -1 otherwise
+ */
+static int check_table(const apriltag_family_t *fam, const t_qd_table *qd, int bits_corrected)
+{
+    if (qd == NULL || qd->nentries <= 0 || qd->entries == NULL) return -1;
+
+    for (uint32_t i = 0; i < fam->ncodes; i++)
+    {
+        uint64_t code = fam->codes[i];
+        int found = 0;
+        for (int bucket = code % qd->nentries, n = 0; qd->entries[bucket].rcode != UINT64_MAX && n < qd->nentries; bucket = (bucket + 1) % qd->nentries, n++)
+        {
+            if (qd->entries[bucket].rcode != code) continue;
+            if (qd->entries[bucket].id != i || qd->entries[bucket].hamming != 0) return -1;
+            found = 1;
+            break;
+        }
+        if (!found) return -1;
+    }
+
+    // codes within bits_corrected bits of each family code: sum of (nbits choose h), h <= bits_corrected
+    long expected = 0, choose = 1;
+    for (int h = 0; h <= bits_corrected; h++)
+    {
+        expected += choose;
+        choose = choose * (fam->nbits - h) / (h + 1);
+    }
+    expected *= fam->ncodes;
+
+    long n = 0;
+    for (int i = 0; i < qd->nentries; i++)
+    {
+        if (qd->entries[i].rcode == UINT64_MAX) continue;
+        if (qd->entries[i].hamming > bits_corrected || qd->entries[i].id >= fam->ncodes) return -1;
+        n++;
+    }
+    return n == expected ? 0 : -1;
+}
+
+/**
+ * @brief Order of table entries by code
+ */
+static int compare_entries(const void *a, const void *b)
+{
+    uint64_t ca = ((const t_qd_entry *)a)->rcode, cb = ((const t_qd_entry *)b)->rcode;
+    return (ca > cb) - (ca < cb);
+}
+
+/**
+ * @brief Write the codes of a table as C source, sorted by code: the codes, and the id and bits corrected of each
+ *
+ * @return number of codes written; -1 on allocation failure
+ */
+static int write_table(const char *name, int bits_corrected, const t_qd_table *qd)
+{
+    t_qd_entry *codes = malloc(qd->nentries * sizeof(t_qd_entry));
+    if (codes == NULL) return -1;
+    int n = 0;
+    for (int i = 0; i < qd->nentries; i++)
+        if (qd->entries[i].rcode != UINT64_MAX) codes[n++] = qd->entries[i];
+    qsort(codes, n, sizeof(t_qd_entry), compare_entries);
+
+    printf("// %s, %d bits corrected\n", name, bits_corrected);
+    printf("static const uint64_t %s_%d_rcodes[%d] = {\n", name, bits_corrected, n);
+    for (int i = 0; i < n; i++)
+    {
+        printf("0x%" PRIx64 "ULL", codes[i].rcode);
+        printf(i == n - 1 ? "\n" : (i % ENTRIES_PER_LINE == ENTRIES_PER_LINE - 1) ? ",\n" : ",");
+    }
+    printf("};\n");
+    printf("static const uint16_t %s_%d_ids[%d] = {\n", name, bits_corrected, n);
+    for (int i = 0; i < n; i++)
+    {
+        printf("%u", TAG_DECODE_ID(codes[i].id, codes[i].hamming));
+        printf(i == n - 1 ? "\n" : (i % ENTRIES_PER_LINE == ENTRIES_PER_LINE - 1) ? ",\n" : ",");
+    }
+    printf("};\n");
+    // filled from the codes when the table is first used
+    printf("static t_qd_table %s_%d_table = { 0, NULL };\n\n", name, bits_corrected);
+
+    free(codes);
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <family>:<bits corrected> [...] > tag_decode_tables.c\n", argv[0]);
+        return 1;
+    }
+
+    printf("/** @file tag_decode_tables.c\n");
+    printf(" *  @brief Tag family decode tables; generated at build time by atagjs_gen_tables (do not edit)\n");
+    printf(" *  @see tag_decode_table.h\n");
+    printf(" */\n\n");
+    printf("#include <stdint.h>\n");
+    printf("#include <stddef.h>\n");
+    printf("#include \"tag_decode_table.h\"\n\n");
+
+    char index[4096] = "";
+    for (int a = 1; a < argc; a++)
+    {
+        char name[64];
+        int bits_corrected;
+        if (sscanf(argv[a], "%63[^:]:%d", name, &bits_corrected) != 2 || bits_corrected < 0 || bits_corrected > 3)
+        {
+            fprintf(stderr, "Invalid table %s (expected <family>:<bits corrected 0..3>)\n", argv[a]);
+            return 1;
+        }
+
+        int f = 0, nfamilies = sizeof(families) / sizeof(families[0]);
+        while (f < nfamilies && strcmp(families[f].name, name) != 0) f++;
+        if (f == nfamilies)
+        {
+            fprintf(stderr, "Unknown family %s\n", name);
+            return 1;
+        }
+
+        // let the library build the table
+        apriltag_family_t *tf = families[f].create();
+        apriltag_detector_t *td = apriltag_detector_create();
+        apriltag_detector_add_family_bits(td, tf, bits_corrected);
+
+        t_qd_table *qd = (t_qd_table *)tf->impl;
+        if (check_table(tf, qd, bits_corrected) != 0)
+        {
+            fprintf(stderr, "Decode table of %s does not match the layout in tag_decode_table.h\n", name);
+            return 1;
+        }
+        int n = write_table(name, bits_corrected, qd);
+        if (n < 0)
+        {
+            fprintf(stderr, "Error allocating the codes of %s\n", name);
+            return 1;
+        }
+
+        char line[512];
+        snprintf(line, sizeof(line), "    { \"%s\", %d, %u, %d, %d, %s_%d_rcodes, %s_%d_ids, &%s_%d_table },\n", name, bits_corrected,
+                 tf->ncodes, qd->nentries, n, name, bits_corrected, name, bits_corrected, name, bits_corrected);
+        strncat(index, line, sizeof(index) - strlen(index) - 1);
+
+        apriltag_detector_destroy(td);
+        families[f].destroy(tf);
+    }
+
+    printf("const t_tag_decode_table tag_decode_tables[] = {\n%s    { NULL, 0, 0, 0, 0, NULL, NULL, NULL }\n};\n", index);
+
+    return 0;
+}
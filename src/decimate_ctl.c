@@ -0,0 +1,87 @@
+/** @file decimate_ctl.c
+ *  @brief Adaptive decimation controller
+ *  @see documentation in decimate_ctl.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include "decimate_ctl.h"
+
+// decimations the detector supports: 1.5, or an integer factor (other values are truncated by the detector)
+static const double levels[] = { 1.0, 1.5, 2.0, 3.0, 4.0, 5.0, 6.0, 8.0 };
+#define NLEVELS ((int)(sizeof(levels) / sizeof(levels[0])))
+
+/**
+ * @brief Index of the level of a decimation (the largest level not above it), within the range of the controller
+ */
+static int level_of ( const t_decimate_ctl *dc, double decimate ) {
+  int lo = 0, hi = NLEVELS - 1;
+  while (lo < NLEVELS - 1 && levels[lo] < dc->min_decimate) lo++;
+  while (hi > lo && levels[hi] > dc->max_decimate) hi--;
+  int l = hi;
+  while (l > lo && levels[l] > decimate) l--;
+  return l;
+}
+
+/**
+ * @brief Median of the frame times in the window
+ */
+static double median_us ( const t_decimate_ctl *dc ) {
+  double t[DECIMATE_CTL_WINDOW];
+  for (int i = 0; i < DECIMATE_CTL_WINDOW; i++) {
+    // insertion sort
+    int j = i;
+    for (; j > 0 && t[j - 1] > dc->frame_us[i]; j--) t[j] = t[j - 1];
+    t[j] = dc->frame_us[i];
+  }
+  return t[DECIMATE_CTL_WINDOW / 2];
+}
+
+/** @copydoc decimate_ctl_reset */
+void decimate_ctl_reset ( t_decimate_ctl *dc, double target_us, double min_decimate, double max_decimate, int adapt_refine ) {
+  dc->target_us = target_us;
+  dc->min_decimate = (min_decimate < 1.0) ? 1.0 : min_decimate;
+  dc->max_decimate = (max_decimate < dc->min_decimate) ? dc->min_decimate : max_decimate;
+  dc->adapt_refine = adapt_refine;
+  decimate_ctl_start(dc, dc->decimate, dc->refine_option);
+}
+
+/** @copydoc decimate_ctl_start */
+void decimate_ctl_start ( t_decimate_ctl *dc, double decimate, int refine_edges ) {
+  dc->decimate = levels[level_of(dc, decimate)];
+  dc->refine_option = refine_edges;
+  dc->refine_edges = refine_edges;
+  dc->nframes = 0;
+}
+
+/** @copydoc decimate_ctl_update */
+int decimate_ctl_update ( t_decimate_ctl *dc, double frame_us, double min_tag_px ) {
+  // median frame time of the window (a few slow frames, e.g. garbage collection pauses, do not change the settings)
+  dc->frame_us[dc->nframes % DECIMATE_CTL_WINDOW] = frame_us;
+  if (++dc->nframes < DECIMATE_CTL_WINDOW) return 0;
+  if (dc->nframes == 2 * DECIMATE_CTL_WINDOW) dc->nframes = DECIMATE_CTL_WINDOW; // same slots; does not overflow
+  double time_us = median_us(dc);
+
+  int l = level_of(dc, dc->decimate);
+  int up = (l + 1 < NLEVELS && levels[l + 1] <= dc->max_decimate) ? l + 1 : -1;
+  int down = (l > 0 && levels[l - 1] >= dc->min_decimate) ? l - 1 : -1;
+
+  if (time_us > dc->target_us) {
+    // over budget: decimate more, as long as the smallest tag stays large enough to be found; or else stop refining edges
+    if (up >= 0 && (min_tag_px <= 0 || min_tag_px / levels[up] >= DECIMATE_CTL_MIN_TAG_PX)) dc->decimate = levels[up];
+    else if (dc->adapt_refine && dc->refine_edges) dc->refine_edges = 0;
+    else return 0;
+  } else {
+    // under budget: refine edges again, then decimate less if the time predicted for it fits (detector stages scale
+    // with the decimated pixels; an overestimate, as decoding and pose do not)
+    double headroom_us = dc->target_us * DECIMATE_CTL_HEADROOM;
+    double ratio = (down >= 0) ? dc->decimate / levels[down] : 0;
+    if (!dc->refine_edges && dc->refine_option && time_us < headroom_us) dc->refine_edges = 1;
+    else if (down >= 0 && time_us * ratio * ratio < headroom_us) dc->decimate = levels[down];
+    else return 0;
+  }
+
+  // new settings; measure them from scratch
+  dc->nframes = 0;
+  return 1;
+}
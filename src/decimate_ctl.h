@@ -0,0 +1,75 @@
+/** @file decimate_ctl.h
+*  @brief Definitions for an adaptive decimation controller, that keeps the frame time of a detector within a budget
+*
+*  After each frame, the controller compares the frame time (the median of the last few frames) to the budget, and picks the
+*  decimation (and, optionally, edge refinement) of the next frame: more decimation when over budget, less when the
+*  time predicted for less decimation fits. Decimation is not raised past what the smallest tag last detected needs to
+*  stay detectable
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _DECIMATE_CTL_H_
+#define _DECIMATE_CTL_H_
+
+// smallest side of a tag in the decimated image, in pixels, for its quad to be found reliably
+#define DECIMATE_CTL_MIN_TAG_PX 12.0
+
+// frames the frame time is the median of; also the frames measured after a change before the next one
+#define DECIMATE_CTL_WINDOW 5
+
+// less decimation (or edge refinement back on) only if predicted to stay below this fraction of the budget
+#define DECIMATE_CTL_HEADROOM 0.8
+
+#define DECIMATE_CTL_INITIALIZER { .target_us = 0, .min_decimate = 1.0, .max_decimate = 4.0, .adapt_refine = 0, \
+                                   .refine_option = 1, .decimate = 2.0, .refine_edges = 1, .frame_us = { 0 }, .nframes = 0 }
+
+/**
+ * @typedef t_decimate_ctl
+ * @brief Controller state
+ */
+typedef struct {
+  double target_us;      // frame time budget, in microseconds
+  double min_decimate;   // decimation range
+  double max_decimate;
+  int adapt_refine;      // turn edge refinement off when over budget and decimation cannot be raised
+  int refine_option;     // edge refinement option of the detector (never turned on if off)
+  double decimate;       // decimation of the next frame
+  int refine_edges;      // edge refinement of the next frame
+  double frame_us[DECIMATE_CTL_WINDOW];  // time of the last frames (circular; frame n is at n % DECIMATE_CTL_WINDOW)
+  int nframes;           // frames measured since the last change (wraps, staying >= DECIMATE_CTL_WINDOW once full)
+} t_decimate_ctl;
+
+/**
+ * @brief Set the budget and range of the controller
+ *
+ * @param dc the controller
+ * @param target_us frame time budget, in microseconds
+ * @param min_decimate smallest decimation (at least 1)
+ * @param max_decimate largest decimation (at least min_decimate)
+ * @param adapt_refine 0=edge refinement is left as set; turn it off when over budget otherwise
+ */
+void decimate_ctl_reset ( t_decimate_ctl *dc, double target_us, double min_decimate, double max_decimate, int adapt_refine );
+
+/**
+ * @brief Restart the controller from the given detector settings (e.g. when the detector options change)
+ *
+ * @param dc the controller
+ * @param decimate decimation to start from (snapped to a decimation the detector supports, within the range)
+ * @param refine_edges edge refinement option of the detector
+ */
+void decimate_ctl_start ( t_decimate_ctl *dc, double decimate, int refine_edges );
+
+/**
+ * @brief Account for a frame, and update the settings of the next frame (decimate, refine_edges)
+ *
+ * @param dc the controller
+ * @param frame_us time spent on the frame, in microseconds
+ * @param min_tag_px side of the smallest tag detected in the frame, in (full-resolution) pixels; 0 if none
+ *
+ * @return 1 if the settings changed; 0 otherwise
+ */
+int decimate_ctl_update ( t_decimate_ctl *dc, double frame_us, double min_tag_px );
+
+#endif
@@ -0,0 +1,62 @@
+/** @file frame_arena.c
+ *  @brief Per-frame arena allocator
+ *  @see documentation in frame_arena.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include "frame_arena.h"
+
+// chunk header size, rounded up so the memory after it is aligned
+#define CHUNK_HEADER ((sizeof(t_frame_arena_chunk) + FRAME_ARENA_ALIGN - 1) & ~(size_t)(FRAME_ARENA_ALIGN - 1))
+
+/** @copydoc frame_arena_alloc */
+void *frame_arena_alloc ( t_frame_arena *fa, size_t size ) {
+  size = (size + FRAME_ARENA_ALIGN - 1) & ~(size_t)(FRAME_ARENA_ALIGN - 1);
+
+  t_frame_arena_chunk *c = fa->chunk;
+  if (c == NULL || c->size - c->used < size) {
+    // new chunk, at least twice all the memory of the arena
+    size_t total = 0;
+    for (t_frame_arena_chunk *o = c; o != NULL; o = o->next) total += o->size;
+    size_t chunk_size = (total * 2 > FRAME_ARENA_MIN_CHUNK) ? total * 2 : FRAME_ARENA_MIN_CHUNK;
+    if (chunk_size < size) chunk_size = size;
+
+    t_frame_arena_chunk *n = malloc(CHUNK_HEADER + chunk_size);
+    if (n == NULL) return NULL;
+    n->next = c;
+    n->size = chunk_size;
+    n->used = 0;
+    fa->chunk = c = n;
+    fa->nallocs++;
+  }
+
+  void *p = (char *)c + CHUNK_HEADER + c->used;
+  c->used += size;
+  return p;
+}
+
+/** @copydoc frame_arena_reset */
+void frame_arena_reset ( t_frame_arena *fa ) {
+  t_frame_arena_chunk *c = fa->chunk;
+  if (c != NULL) {
+    // keep the current chunk (the largest); release the others
+    t_frame_arena_chunk *o = c->next;
+    while (o != NULL) {
+      t_frame_arena_chunk *next = o->next;
+      free(o);
+      o = next;
+    }
+    c->next = NULL;
+    c->used = 0;
+  }
+  fa->nallocs = 0;
+}
+
+/** @copydoc frame_arena_destroy */
+void frame_arena_destroy ( t_frame_arena *fa ) {
+  frame_arena_reset(fa);
+  free(fa->chunk);
+  fa->chunk = NULL;
+}
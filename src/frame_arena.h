@@ -0,0 +1,70 @@
+/** @file frame_arena.h
+*  @brief Definitions for a per-frame arena allocator
+*
+*  Bump allocator for the temporaries of a frame; everything allocated is released at once when the next frame starts.
+*  The arena keeps its memory across frames, so once it has grown to the size a frame needs, frames do not allocate
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _FRAME_ARENA_H_
+#define _FRAME_ARENA_H_
+
+#include <stddef.h>
+
+// size of the first chunk of an arena, in bytes
+#define FRAME_ARENA_MIN_CHUNK 4096
+
+// alignment of the allocations, in bytes
+#define FRAME_ARENA_ALIGN 16
+
+#define FRAME_ARENA_INITIALIZER { .chunk = NULL, .nallocs = 0 }
+
+/**
+ * @typedef t_frame_arena_chunk
+ * @brief A block of memory of an arena; the memory follows the header
+ */
+typedef struct frame_arena_chunk {
+  struct frame_arena_chunk *next;  // chunk allocated before this one in the current frame
+  size_t size;                     // bytes after the header
+  size_t used;                     // bytes allocated
+} t_frame_arena_chunk;
+
+/**
+ * @typedef t_frame_arena
+ * @brief Arena state
+ */
+typedef struct {
+  t_frame_arena_chunk *chunk;  // current chunk (largest)
+  int nallocs;                 // heap allocations made by the arena since the last reset
+} t_frame_arena;
+
+/**
+ * @brief Allocate memory from the arena; valid until the next frame_arena_reset()
+ *
+ * When the current chunk is full, a chunk of at least twice the memory of the arena is allocated; resets keep only that
+ * chunk, so after a few frames the arena settles into a single chunk large enough for a frame
+ *
+ * @param fa the arena
+ * @param size bytes to allocate
+ *
+ * @return pointer to the memory (aligned to FRAME_ARENA_ALIGN bytes); NULL if a chunk could not be allocated
+ */
+void *frame_arena_alloc ( t_frame_arena *fa, size_t size );
+
+/**
+ * @brief Start a new frame: release everything allocated; keeps the largest chunk
+ *
+ * @param fa the arena
+ */
+void frame_arena_reset ( t_frame_arena *fa );
+
+/**
+ * @brief Free the memory of the arena
+ *
+ * @param fa the arena
+ */
+void frame_arena_destroy ( t_frame_arena *fa );
+
+#endif
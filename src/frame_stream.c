@@ -0,0 +1,333 @@
+/** @file frame_stream.c
+ *  @brief Video stream reader (Y4M or raw grayscale frames)
+ *  @see documentation in frame_stream.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common/time_util.h"
+#include "frame_stream.h"
+
+// longest Y4M header line we parse (the rest of a longer line is skipped)
+#define Y4M_LINE_LEN 256
+
+// bytes read at a time when skipping the chroma planes of Y4M frames
+#define SKIP_CHUNK 4096
+
+// buffer states
+#define BUF_FREE 0     // can be taken by the reader
+#define BUF_READING 1  // a frame is being read into it
+#define BUF_QUEUED 2   // waiting for the caller
+#define BUF_HELD 3     // held by the caller (last frame returned by frame_stream_next())
+
+struct frame_stream {
+  FILE *f;
+  int format;
+  int width, height;
+  size_t skip;            // bytes after the luma plane of each frame (Y4M chroma planes)
+  int policy;
+
+  int nbuffers;
+  t_stream_frame *frames; // one per buffer
+  int *state;             // BUF_* state of each buffer
+  int *queue;             // buffers waiting for the caller, oldest first (circular)
+  int qhead, qlen;
+  int held;               // buffer held by the caller; -1 if none
+
+  int64_t nread;          // frames read (including dropped ones)
+  int64_t dropped;
+  int ended;              // the reader reached the end of the stream (or a read error)
+  int closing;            // frame_stream_close() was called
+
+  pthread_mutex_t lock;
+  pthread_cond_t ready;   // a frame was queued, or the stream ended
+  pthread_cond_t space;   // a buffer was freed, or the stream is closing
+  pthread_t thread;
+};
+
+/**
+ * @brief Read a line of a Y4M stream, without the '\n'; the part of a line that does not fit in line is skipped
+ *
+ * @return 0 on success; -1 at the end of the stream
+ */
+static int read_line ( FILE *f, char *line, size_t size ) {
+  if (fgets(line, size, f) == NULL) return -1;
+  size_t len = strlen(line);
+  if (len > 0 && line[len - 1] == '\n') {
+    line[len - 1] = '\0';
+    return 0;
+  }
+  int c;
+  while ((c = getc(f)) != EOF && c != '\n');
+  return (c == EOF) ? -1 : 0;
+}
+
+/**
+ * @brief Parse a Y4M stream header ("YUV4MPEG2 W<width> H<height> ... C<colorspace> ...")
+ *
+ * @return 0 on success; -1 if the header is invalid, or the colorspace is not 8-bit
+ */
+static int parse_y4m_header ( t_frame_stream *fs ) {
+  char line[Y4M_LINE_LEN];
+  if (read_line(fs->f, line, sizeof(line)) != 0 || strncmp(line, "YUV4MPEG2 ", 10) != 0) return -1;
+
+  const char *colorspace = "420";  // default colorspace
+  char *save = NULL;
+  for (char *tok = strtok_r(line + 10, " ", &save); tok != NULL; tok = strtok_r(NULL, " ", &save)) {
+    if (tok[0] == 'W') fs->width = atoi(tok + 1);
+    else if (tok[0] == 'H') fs->height = atoi(tok + 1);
+    else if (tok[0] == 'C') colorspace = tok + 1;
+  }
+  if (fs->width <= 0 || fs->height <= 0) return -1;
+
+  size_t w = fs->width, h = fs->height;
+  if (strcmp(colorspace, "mono") == 0) fs->skip = 0;
+  else if (strcmp(colorspace, "420") == 0 || strcmp(colorspace, "420jpeg") == 0 ||
+           strcmp(colorspace, "420paldv") == 0 || strcmp(colorspace, "420mpeg2") == 0) fs->skip = 2 * ((w + 1) / 2) * ((h + 1) / 2);
+  else if (strcmp(colorspace, "411") == 0) fs->skip = 2 * ((w + 3) / 4) * h;
+  else if (strcmp(colorspace, "422") == 0) fs->skip = 2 * ((w + 1) / 2) * h;
+  else if (strcmp(colorspace, "444") == 0) fs->skip = 2 * w * h;
+  else if (strcmp(colorspace, "444alpha") == 0) fs->skip = 3 * w * h;
+  else return -1;  // e.g. high bit depth (420p10, mono16, ...)
+  return 0;
+}
+
+/**
+ * @brief Wait for the next frame of the stream (its Y4M "FRAME" line, or its first byte)
+ *
+ * @return 0 if there is a frame; -1 at the end of the stream
+ */
+static int read_frame_header ( t_frame_stream *fs ) {
+  if (fs->format == FRAME_STREAM_Y4M) {
+    char line[Y4M_LINE_LEN];
+    if (read_line(fs->f, line, sizeof(line)) != 0) return -1;
+    return (strncmp(line, "FRAME", 5) == 0) ? 0 : -1;
+  }
+  int c = getc(fs->f);
+  if (c == EOF) return -1;
+  ungetc(c, fs->f);
+  return 0;
+}
+
+/**
+ * @brief Read the pixels of a frame into a buffer (width*height bytes), and skip the rest of the frame
+ *
+ * @return 0 on success; -1 if the stream ended in the middle of the frame
+ */
+static int read_frame ( t_frame_stream *fs, uint8_t *buf ) {
+  size_t size = (size_t)fs->width * fs->height;
+  if (fread(buf, 1, size, fs->f) != size) return -1;
+
+  uint8_t chunk[SKIP_CHUNK];
+  for (size_t left = fs->skip; left > 0; ) {
+    size_t n = (left < sizeof(chunk)) ? left : sizeof(chunk);
+    if (fread(chunk, 1, n, fs->f) != n) return -1;
+    left -= n;
+  }
+  return 0;
+}
+
+/**
+ * @brief Take a buffer to read a frame into: a free one or, if there is none and the policy allows it, the one of the
+ *        oldest frame waiting; waits otherwise. Called with the lock held
+ *
+ * @return the buffer; -1 if the stream is closing
+ */
+static int take_buffer ( t_frame_stream *fs ) {
+  for (;;) {
+    if (fs->closing) return -1;
+    for (int b = 0; b < fs->nbuffers; b++) {
+      if (fs->state[b] != BUF_FREE) continue;
+      fs->state[b] = BUF_READING;
+      return b;
+    }
+    if (fs->policy == FRAME_STREAM_DROP_OLDEST && fs->qlen > 0) {
+      int b = fs->queue[fs->qhead];
+      fs->qhead = (fs->qhead + 1) % fs->nbuffers;
+      fs->qlen--;
+      fs->dropped++;
+      fs->state[b] = BUF_READING;
+      return b;
+    }
+    pthread_cond_wait(&fs->space, &fs->lock);
+  }
+}
+
+/**
+ * @brief Reader thread: reads frames into free buffers until the end of the stream
+ *
+ * Can only be cancelled (by frame_stream_close()) while it waits for data, never with the lock held
+ */
+static void *stream_reader ( void *arg ) {
+  t_frame_stream *fs = arg;
+  pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+  for (;;) {
+    // wait for the next frame before taking a buffer, so no frame is dropped for a frame that never comes
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    int more = (read_frame_header(fs) == 0);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    if (!more) break;
+
+    pthread_mutex_lock(&fs->lock);
+    int b = take_buffer(fs);
+    pthread_mutex_unlock(&fs->lock);
+    if (b < 0) break;
+
+    pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+    int ok = (read_frame(fs, fs->frames[b].buf) == 0);
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    pthread_mutex_lock(&fs->lock);
+    if (!ok) {
+      fs->state[b] = BUF_FREE;
+      pthread_mutex_unlock(&fs->lock);
+      break;
+    }
+    fs->frames[b].number = fs->nread++;
+    fs->frames[b].read_us = utime_now();
+    fs->state[b] = BUF_QUEUED;
+    fs->queue[(fs->qhead + fs->qlen) % fs->nbuffers] = b;
+    fs->qlen++;
+    pthread_cond_signal(&fs->ready);
+    pthread_mutex_unlock(&fs->lock);
+  }
+
+  pthread_mutex_lock(&fs->lock);
+  fs->ended = 1;
+  pthread_cond_broadcast(&fs->ready);
+  pthread_mutex_unlock(&fs->lock);
+  return NULL;
+}
+
+/**
+ * @brief Free the memory of a stream (the reader is not running)
+ */
+static void stream_free ( t_frame_stream *fs ) {
+  if (fs->frames != NULL)
+    for (int b = 0; b < fs->nbuffers; b++) free(fs->frames[b].buf);
+  free(fs->frames);
+  free(fs->state);
+  free(fs->queue);
+  free(fs);
+}
+
+/** @copydoc frame_stream_open */
+t_frame_stream *frame_stream_open ( FILE *f, int format, int width, int height, int nbuffers, int policy ) {
+  if (f == NULL || nbuffers < FRAME_STREAM_MIN_BUFFERS) return NULL;
+  t_frame_stream *fs = calloc(1, sizeof(t_frame_stream));
+  if (fs == NULL) return NULL;
+  fs->f = f;
+  fs->format = format;
+  fs->policy = policy;
+  fs->nbuffers = nbuffers;
+  fs->held = -1;
+
+  if (format == FRAME_STREAM_Y4M) {
+    if (parse_y4m_header(fs) != 0) {
+      stream_free(fs);
+      return NULL;
+    }
+  } else {
+    fs->width = width;
+    fs->height = height;
+    if (format != FRAME_STREAM_GRAY || width <= 0 || height <= 0) {
+      stream_free(fs);
+      return NULL;
+    }
+  }
+
+  fs->frames = calloc(nbuffers, sizeof(t_stream_frame));
+  fs->state = calloc(nbuffers, sizeof(int));
+  fs->queue = calloc(nbuffers, sizeof(int));
+  if (fs->frames == NULL || fs->state == NULL || fs->queue == NULL) {
+    stream_free(fs);
+    return NULL;
+  }
+  for (int b = 0; b < nbuffers; b++) {
+    fs->frames[b].buf = malloc((size_t)fs->width * fs->height);
+    if (fs->frames[b].buf == NULL) {
+      stream_free(fs);
+      return NULL;
+    }
+  }
+
+  pthread_mutex_init(&fs->lock, NULL);
+  pthread_cond_init(&fs->ready, NULL);
+  pthread_cond_init(&fs->space, NULL);
+  if (pthread_create(&fs->thread, NULL, stream_reader, fs) != 0) {
+    pthread_mutex_destroy(&fs->lock);
+    pthread_cond_destroy(&fs->ready);
+    pthread_cond_destroy(&fs->space);
+    stream_free(fs);
+    return NULL;
+  }
+  return fs;
+}
+
+/** @copydoc frame_stream_next */
+const t_stream_frame *frame_stream_next ( t_frame_stream *fs ) {
+  pthread_mutex_lock(&fs->lock);
+
+  // the caller is done with the frame it held
+  if (fs->held >= 0) {
+    fs->state[fs->held] = BUF_FREE;
+    fs->held = -1;
+    pthread_cond_signal(&fs->space);
+  }
+
+  while (fs->qlen == 0 && !fs->ended) pthread_cond_wait(&fs->ready, &fs->lock);
+  if (fs->qlen == 0) {
+    pthread_mutex_unlock(&fs->lock);
+    return NULL;
+  }
+
+  int b = fs->queue[fs->qhead];
+  fs->qhead = (fs->qhead + 1) % fs->nbuffers;
+  fs->qlen--;
+  fs->state[b] = BUF_HELD;
+  fs->held = b;
+  pthread_mutex_unlock(&fs->lock);
+  return &fs->frames[b];
+}
+
+/** @copydoc frame_stream_width */
+int frame_stream_width ( const t_frame_stream *fs ) {
+  return fs->width;
+}
+
+/** @copydoc frame_stream_height */
+int frame_stream_height ( const t_frame_stream *fs ) {
+  return fs->height;
+}
+
+/** @copydoc frame_stream_dropped */
+int64_t frame_stream_dropped ( t_frame_stream *fs ) {
+  pthread_mutex_lock(&fs->lock);
+  int64_t dropped = fs->dropped;
+  pthread_mutex_unlock(&fs->lock);
+  return dropped;
+}
+
+/** @copydoc frame_stream_close */
+void frame_stream_close ( t_frame_stream *fs ) {
+  if (fs == NULL) return;
+
+  pthread_mutex_lock(&fs->lock);
+  fs->closing = 1;
+  int ended = fs->ended;
+  pthread_cond_broadcast(&fs->space);
+  pthread_mutex_unlock(&fs->lock);
+
+  // the reader might be waiting for data that never comes (e.g. an idle pipe)
+  if (!ended) pthread_cancel(fs->thread);
+  pthread_join(fs->thread, NULL);
+
+  pthread_mutex_destroy(&fs->lock);
+  pthread_cond_destroy(&fs->ready);
+  pthread_cond_destroy(&fs->space);
+  stream_free(fs);
+}
@@ -0,0 +1,95 @@
+/** @file frame_stream.h
+*  @brief Definitions for reading a video stream (Y4M or raw grayscale frames) from a pipe, file or FIFO
+*
+*  A reader thread reads the frames into a fixed set of buffers while the caller detects on the previous ones, so
+*  memory is bounded by the number of buffers. When all buffers are taken (detection fell behind), the reader either
+*  waits (no frame is lost; the writer of the stream blocks) or drops the oldest frame waiting for detection
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _FRAME_STREAM_H_
+#define _FRAME_STREAM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// stream formats
+#define FRAME_STREAM_Y4M 0   // YUV4MPEG2: header with the frame size; the luma plane of each frame is used
+#define FRAME_STREAM_GRAY 1  // raw 8-bit grayscale frames, one after the other (the frame size is given)
+
+// policies when detection falls behind
+#define FRAME_STREAM_BLOCK 0        // the reader waits for a free buffer
+#define FRAME_STREAM_DROP_OLDEST 1  // the reader takes the buffer of the oldest frame waiting for detection
+
+// fewest buffers of a stream: the one the caller holds, plus the one being read
+#define FRAME_STREAM_MIN_BUFFERS 2
+
+/**
+ * @typedef t_stream_frame
+ * @brief A frame read from the stream
+ */
+typedef struct {
+  uint8_t *buf;     // width*height grayscale pixels
+  int64_t number;   // frame number in the stream, from 0 (dropped frames are counted)
+  int64_t read_us;  // when the frame was read (utime_now(), microseconds)
+} t_stream_frame;
+
+/**
+ * @typedef t_frame_stream
+ * @brief Stream state (opaque)
+ */
+typedef struct frame_stream t_frame_stream;
+
+/**
+ * @brief Open a stream and start reading frames
+ *
+ * Y4M streams have their header read before returning, so the frame size is known
+ *
+ * @param f where to read from (e.g. stdin, or a FIFO); not closed by the stream
+ * @param format FRAME_STREAM_Y4M or FRAME_STREAM_GRAY
+ * @param width frame width (FRAME_STREAM_GRAY only)
+ * @param height frame height (FRAME_STREAM_GRAY only)
+ * @param nbuffers frame buffers (at least FRAME_STREAM_MIN_BUFFERS); frames waiting for detection are at most
+ *        nbuffers-1 (nbuffers-2 while the caller holds a frame)
+ * @param policy FRAME_STREAM_BLOCK or FRAME_STREAM_DROP_OLDEST
+ *
+ * @return the stream; NULL on failure (invalid header or arguments, allocation failure)
+ */
+t_frame_stream *frame_stream_open ( FILE *f, int format, int width, int height, int nbuffers, int policy );
+
+/**
+ * @brief Get the oldest frame read; waits for one if there is none yet
+ *
+ * The frame is held by the caller (the reader does not touch it) until the next call to frame_stream_next()
+ *
+ * @param fs the stream
+ *
+ * @return the frame; NULL at the end of the stream (or on a read error)
+ */
+const t_stream_frame *frame_stream_next ( t_frame_stream *fs );
+
+/**
+ * @brief Frame width
+ */
+int frame_stream_width ( const t_frame_stream *fs );
+
+/**
+ * @brief Frame height
+ */
+int frame_stream_height ( const t_frame_stream *fs );
+
+/**
+ * @brief Number of frames dropped so far (FRAME_STREAM_DROP_OLDEST)
+ */
+int64_t frame_stream_dropped ( t_frame_stream *fs );
+
+/**
+ * @brief Stop reading (a read in progress is cancelled) and free the stream
+ *
+ * @param fs the stream
+ */
+void frame_stream_close ( t_frame_stream *fs );
+
+#endif
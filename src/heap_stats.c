@@ -0,0 +1,52 @@
+/** @file heap_stats.c
+ *  @brief Heap usage sampling
+ *  @see documentation in heap_stats.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#if defined(__EMSCRIPTEN__) || defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#ifdef __EMSCRIPTEN__
+#include <emscripten/heap.h>
+#endif
+#include "heap_stats.h"
+
+/** @copydoc heap_stats_sample */
+void heap_stats_sample ( t_heap_stats *hs ) {
+  size_t max_footprint = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  struct mallinfo2 mi = mallinfo2();
+  hs->used = mi.uordblks + mi.hblkhd;  // hblkhd: large blocks mapped directly (not in the arena)
+  hs->footprint = mi.arena + mi.hblkhd;
+#elif defined(__EMSCRIPTEN__) || defined(__GLIBC__)
+  struct mallinfo mi = mallinfo();
+  hs->used = (size_t)mi.uordblks + (size_t)mi.hblkhd;
+  hs->footprint = (size_t)mi.arena + (size_t)mi.hblkhd;
+  max_footprint = (size_t)mi.usmblks;  // dlmalloc (emscripten) keeps the high-water mark here; glibc leaves it zero
+#else
+  hs->used = 0;
+  hs->footprint = 0;
+#endif
+  if (max_footprint > hs->peak) hs->peak = max_footprint;
+  if (hs->footprint > hs->peak) hs->peak = hs->footprint;
+}
+
+/** @copydoc heap_stats_size */
+size_t heap_stats_size ( void ) {
+#ifdef __EMSCRIPTEN__
+  return emscripten_get_heap_size();
+#else
+  return 0;
+#endif
+}
+
+/** @copydoc heap_stats_probe */
+int heap_stats_probe ( size_t bytes ) {
+  void *volatile block = malloc(bytes);  // volatile: the compiler must not elide the allocation
+  if (block == NULL) return -1;
+  free(block);
+  return 0;
+}
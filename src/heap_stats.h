@@ -0,0 +1,55 @@
+/** @file heap_stats.h
+*  @brief Definitions for sampling heap usage (bytes in use, heap footprint and size) and probing free heap
+*
+*  Reads the allocator statistics (mallinfo) of emscripten and glibc; in WASM, the heap size is the size of the WASM
+*  memory, which only grows (every view over it from javascript is invalidated when it does). Elsewhere, usage is
+*  reported as zero
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _HEAP_STATS_H_
+#define _HEAP_STATS_H_
+
+#include <stddef.h>
+
+#define HEAP_STATS_INITIALIZER { .used = 0, .footprint = 0, .peak = 0 }
+
+/**
+ * @typedef t_heap_stats
+ * @brief Heap usage, in bytes
+ */
+typedef struct {
+  size_t used;       // bytes allocated
+  size_t footprint;  // bytes the allocator holds (allocated and free); what the heap must be able to hold
+  size_t peak;       // highest footprint so far (the allocator high-water mark, when it keeps one; else the highest sampled)
+} t_heap_stats;
+
+/**
+ * @brief Sample heap usage; walks the allocator state (cost grows with the number of heap chunks)
+ *
+ * @param hs where to write the usage; peak keeps the highest footprint of this and earlier samples
+ */
+void heap_stats_sample ( t_heap_stats *hs );
+
+/**
+ * @brief Size of the heap: the size of the WASM memory (constant time)
+ *
+ * @return the size in bytes; 0 when not running in WASM
+ */
+size_t heap_stats_size ( void );
+
+/**
+ * @brief Check if a block of a given size can be allocated now, by allocating and releasing it
+ *
+ * Where the heap cannot grow (fixed-heap WASM builds), tells if that much memory is free without running out of it
+ * halfway through a frame; where it can, the heap grows to fit the block
+ *
+ * @param bytes size of the block
+ *
+ * @return 0 if it could be allocated; -1 otherwise
+ */
+int heap_stats_probe ( size_t bytes );
+
+#endif
@@ -0,0 +1,178 @@
+/** @file img_convert.c
+ *  @brief Image conversion kernels
+ *  @see documentation in img_convert.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stddef.h>
+#include "img_convert.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define IMG_CONVERT_SIMD "wasm_simd128"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define IMG_CONVERT_SIMD "sse2"
+#endif
+
+/**
+ * @brief Gray value of one RGBA pixel
+ */
+static inline uint8_t rgba_to_gray_px ( const uint8_t *p ) {
+  return (uint8_t)((p[0] * IMG_CONVERT_WR + p[1] * IMG_CONVERT_WG + p[2] * IMG_CONVERT_WB + 128) >> 8);
+}
+
+#if defined(__wasm_simd128__)
+
+/**
+ * @brief Gray values (16-bit lanes) of 8 RGBA pixels given in two vectors
+ *
+ * Each 32-bit lane holds one pixel (R in the low byte); R, G and B are moved to 16-bit lanes so the weighted sum
+ * (at most 255*256+128) fits in an unsigned 16-bit lane
+ */
+static inline v128_t gray8 ( v128_t p0, v128_t p1 ) {
+  const v128_t m = wasm_i32x4_splat(0xff);
+  v128_t r = wasm_i16x8_narrow_i32x4(wasm_v128_and(p0, m), wasm_v128_and(p1, m));
+  v128_t g = wasm_i16x8_narrow_i32x4(wasm_v128_and(wasm_u32x4_shr(p0, 8), m), wasm_v128_and(wasm_u32x4_shr(p1, 8), m));
+  v128_t b = wasm_i16x8_narrow_i32x4(wasm_v128_and(wasm_u32x4_shr(p0, 16), m), wasm_v128_and(wasm_u32x4_shr(p1, 16), m));
+  v128_t y = wasm_i16x8_add(wasm_i16x8_mul(r, wasm_i16x8_splat(IMG_CONVERT_WR)), wasm_i16x8_mul(g, wasm_i16x8_splat(IMG_CONVERT_WG)));
+  y = wasm_i16x8_add(y, wasm_i16x8_add(wasm_i16x8_mul(b, wasm_i16x8_splat(IMG_CONVERT_WB)), wasm_i16x8_splat(128)));
+  return wasm_u16x8_shr(y, 8);
+}
+
+/**
+ * @brief Convert the first (width rounded down to 16) pixels of a row
+ *
+ * @return number of pixels converted
+ */
+static inline int rgba_to_gray_row_simd ( const uint8_t *rgba, uint8_t *gray, int width ) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const uint8_t *p = rgba + x * 4;
+    v128_t y0 = gray8(wasm_v128_load(p), wasm_v128_load(p + 16));
+    v128_t y1 = gray8(wasm_v128_load(p + 32), wasm_v128_load(p + 48));
+    wasm_v128_store(gray + x, wasm_u8x16_narrow_i16x8(y0, y1));
+  }
+  return x;
+}
+
+/**
+ * @brief Convert and decimate by 2 the first (dwidth rounded down to 16) output pixels of a row; takes the even pixels
+ *
+ * @return number of output pixels written
+ */
+static inline int rgba_decimate2_row_simd ( const uint8_t *rgba, uint8_t *gray, int dwidth, int width ) {
+  int x = 0;
+  for (; x + 16 <= dwidth && 2 * x + 32 <= width; x += 16) {
+    const uint8_t *p = rgba + x * 8;
+    v128_t e0 = wasm_i32x4_shuffle(wasm_v128_load(p), wasm_v128_load(p + 16), 0, 2, 4, 6);
+    v128_t e1 = wasm_i32x4_shuffle(wasm_v128_load(p + 32), wasm_v128_load(p + 48), 0, 2, 4, 6);
+    v128_t e2 = wasm_i32x4_shuffle(wasm_v128_load(p + 64), wasm_v128_load(p + 80), 0, 2, 4, 6);
+    v128_t e3 = wasm_i32x4_shuffle(wasm_v128_load(p + 96), wasm_v128_load(p + 112), 0, 2, 4, 6);
+    wasm_v128_store(gray + x, wasm_u8x16_narrow_i16x8(gray8(e0, e1), gray8(e2, e3)));
+  }
+  return x;
+}
+
+#elif defined(__SSE2__)
+
+/**
+ * @brief Gray values (16-bit lanes) of 8 RGBA pixels given in two vectors
+ *
+ * Each 32-bit lane holds one pixel (R in the low byte); R, G and B are moved to 16-bit lanes so the weighted sum
+ * (at most 255*256+128) fits in an unsigned 16-bit lane
+ */
+static inline __m128i gray8 ( __m128i p0, __m128i p1 ) {
+  const __m128i m = _mm_set1_epi32(0xff);
+  __m128i r = _mm_packs_epi32(_mm_and_si128(p0, m), _mm_and_si128(p1, m));
+  __m128i g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), m), _mm_and_si128(_mm_srli_epi32(p1, 8), m));
+  __m128i b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), m), _mm_and_si128(_mm_srli_epi32(p1, 16), m));
+  __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(IMG_CONVERT_WR)), _mm_mullo_epi16(g, _mm_set1_epi16(IMG_CONVERT_WG)));
+  y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(IMG_CONVERT_WB)), _mm_set1_epi16(128)));
+  return _mm_srli_epi16(y, 8);
+}
+
+/**
+ * @brief Convert the first (width rounded down to 16) pixels of a row
+ *
+ * @return number of pixels converted
+ */
+static inline int rgba_to_gray_row_simd ( const uint8_t *rgba, uint8_t *gray, int width ) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i *p = (const __m128i *)(rgba + x * 4);
+    __m128i y0 = gray8(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+    __m128i y1 = gray8(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+    _mm_storeu_si128((__m128i *)(gray + x), _mm_packus_epi16(y0, y1));
+  }
+  return x;
+}
+
+/**
+ * @brief Even pixels of 8 RGBA pixels given in two vectors
+ */
+static inline __m128i even4 ( __m128i p0, __m128i p1 ) {
+  return _mm_unpacklo_epi64(_mm_shuffle_epi32(p0, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(p1, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+/**
+ * @brief Convert and decimate by 2 the first (dwidth rounded down to 16) output pixels of a row; takes the even pixels
+ *
+ * @return number of output pixels written
+ */
+static inline int rgba_decimate2_row_simd ( const uint8_t *rgba, uint8_t *gray, int dwidth, int width ) {
+  int x = 0;
+  for (; x + 16 <= dwidth && 2 * x + 32 <= width; x += 16) {
+    const __m128i *p = (const __m128i *)(rgba + x * 8);
+    __m128i e0 = even4(_mm_loadu_si128(p), _mm_loadu_si128(p + 1));
+    __m128i e1 = even4(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3));
+    __m128i e2 = even4(_mm_loadu_si128(p + 4), _mm_loadu_si128(p + 5));
+    __m128i e3 = even4(_mm_loadu_si128(p + 6), _mm_loadu_si128(p + 7));
+    _mm_storeu_si128((__m128i *)(gray + x), _mm_packus_epi16(gray8(e0, e1), gray8(e2, e3)));
+  }
+  return x;
+}
+
+#endif
+
+/** @copydoc img_rgba_to_gray */
+void img_rgba_to_gray ( const uint8_t *rgba, int rgba_stride, int width, int height, uint8_t *gray, int gray_stride ) {
+  for (int y = 0; y < height; y++) {
+    const uint8_t *src = rgba + (size_t)y * rgba_stride * 4;
+    uint8_t *dst = gray + (size_t)y * gray_stride;
+    int x = 0;
+#ifdef IMG_CONVERT_SIMD
+    x = rgba_to_gray_row_simd(src, dst, width);
+#endif
+    for (; x < width; x++) dst[x] = rgba_to_gray_px(src + x * 4);
+  }
+}
+
+/** @copydoc img_rgba_decimate_to_gray */
+void img_rgba_decimate_to_gray ( const uint8_t *rgba, int rgba_stride, int width, int height, int factor, uint8_t *gray, int gray_stride ) {
+  if (factor <= 1) {
+    img_rgba_to_gray(rgba, rgba_stride, width, height, gray, gray_stride);
+    return;
+  }
+  int dwidth = IMG_DECIMATED_SIZE(width, factor);
+  int dheight = IMG_DECIMATED_SIZE(height, factor);
+  for (int y = 0; y < dheight; y++) {
+    const uint8_t *src = rgba + (size_t)y * factor * rgba_stride * 4;
+    uint8_t *dst = gray + (size_t)y * gray_stride;
+    int x = 0;
+#ifdef IMG_CONVERT_SIMD
+    if (factor == 2) x = rgba_decimate2_row_simd(src, dst, dwidth, width);
+#endif
+    for (; x < dwidth; x++) dst[x] = rgba_to_gray_px(src + (size_t)x * factor * 4);
+  }
+}
+
+/** @copydoc img_convert_impl */
+const char *img_convert_impl ( ) {
+#ifdef IMG_CONVERT_SIMD
+  return IMG_CONVERT_SIMD;
+#else
+  return "scalar";
+#endif
+}
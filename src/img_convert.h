@@ -0,0 +1,58 @@
+/** @file img_convert.h
+*  @brief Definitions for the image conversion kernels
+*
+*  Converts color images (as they come from an html canvas) into the grayscale images processed by the detector.
+*  Kernels have 128-bit SIMD versions (WASM SIMD when compiled with -msimd128; SSE2 on x86) and a scalar fallback;
+*  all versions produce exactly the same output
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _IMG_CONVERT_H_
+#define _IMG_CONVERT_H_
+
+#include <stdint.h>
+
+// integer luma weights (ITU-R BT.601, scaled by 256; sum is 256): gray = (R*77 + G*150 + B*29 + 128) >> 8
+#define IMG_CONVERT_WR 77
+#define IMG_CONVERT_WG 150
+#define IMG_CONVERT_WB 29
+
+// size of a decimated image dimension (same as image_u8_decimate())
+#define IMG_DECIMATED_SIZE(size, factor) (1 + ((size) - 1) / (factor))
+
+/**
+ * @brief Convert an RGBA image (4 bytes per pixel, R first, as in canvas ImageData) to grayscale; alpha is ignored
+ *
+ * @param rgba the RGBA pixels
+ * @param rgba_stride pixels per row of the RGBA image
+ * @param width width of the image
+ * @param height height of the image
+ * @param gray where to write the grayscale pixels
+ * @param gray_stride pixels (bytes) per row of the grayscale image
+ */
+void img_rgba_to_gray ( const uint8_t *rgba, int rgba_stride, int width, int height, uint8_t *gray, int gray_stride );
+
+/**
+ * @brief Convert an RGBA image to grayscale and decimate it in one pass; only the sampled pixels are read
+ *
+ * Samples the pixel at (x*factor, y*factor) for each output pixel (x, y), like the apriltag detector decimation
+ * (image_u8_decimate()) does on a grayscale image, so the output is the same as converting and then decimating
+ *
+ * @param rgba the RGBA pixels
+ * @param rgba_stride pixels per row of the RGBA image
+ * @param width width of the RGBA image
+ * @param height height of the RGBA image
+ * @param factor decimation factor (>= 1)
+ * @param gray where to write the decimated grayscale pixels; IMG_DECIMATED_SIZE(width, factor) x IMG_DECIMATED_SIZE(height, factor)
+ * @param gray_stride pixels (bytes) per row of the grayscale image
+ */
+void img_rgba_decimate_to_gray ( const uint8_t *rgba, int rgba_stride, int width, int height, int factor, uint8_t *gray, int gray_stride );
+
+/**
+ * @brief Name of the kernel implementation compiled in ("wasm_simd128", "sse2" or "scalar")
+ */
+const char *img_convert_impl ( );
+
+#endif
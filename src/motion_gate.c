@@ -0,0 +1,97 @@
+/** @file motion_gate.c
+ *  @brief Change detector over a downsampled copy of the frame
+ *  @see documentation in motion_gate.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "motion_gate.h"
+
+/**
+ * @brief Sample a frame into a thumbnail: the mean of the 2x2 pixels at each sample point, evenly spread over the frame
+ */
+static void sample ( uint8_t *thumb, const uint8_t *pixels, int width, int height, int stride, int channels ) {
+  int xs[MOTION_GATE_THUMB_W];
+  for (int i = 0; i < MOTION_GATE_THUMB_W; i++) {
+    int x = (int)(((int64_t)(2 * i + 1) * width) / (2 * MOTION_GATE_THUMB_W));
+    xs[i] = (x < width - 1) ? x : (width > 1 ? width - 2 : 0);
+  }
+  int dx = (width > 1) ? channels : 0;
+
+  for (int j = 0; j < MOTION_GATE_THUMB_H; j++) {
+    int y = (int)(((int64_t)(2 * j + 1) * height) / (2 * MOTION_GATE_THUMB_H));
+    if (y >= height - 1) y = (height > 1) ? height - 2 : 0;
+    const uint8_t *row0 = pixels + (size_t)y * stride * channels;
+    const uint8_t *row1 = (height > 1) ? row0 + (size_t)stride * channels : row0;
+    uint8_t *out = thumb + j * MOTION_GATE_THUMB_W;
+
+    if (channels == 1) {
+      for (int i = 0; i < MOTION_GATE_THUMB_W; i++) {
+        const uint8_t *p0 = row0 + xs[i], *p1 = row1 + xs[i];
+        out[i] = (p0[0] + p0[dx] + p1[0] + p1[dx] + 2) >> 2;
+      }
+    } else {
+      // luma as (R + 2G + B) / 4
+      for (int i = 0; i < MOTION_GATE_THUMB_W; i++) {
+        const uint8_t *p0 = row0 + (size_t)xs[i] * channels, *p1 = row1 + (size_t)xs[i] * channels;
+        int sum = p0[0] + 2 * p0[1] + p0[2] + p0[dx] + 2 * p0[dx + 1] + p0[dx + 2] +
+                  p1[0] + 2 * p1[1] + p1[2] + p1[dx] + 2 * p1[dx + 1] + p1[dx + 2];
+        out[i] = (sum + 8) >> 4;
+      }
+    }
+  }
+}
+
+/** @copydoc motion_gate_reset */
+void motion_gate_reset ( t_motion_gate *mg, int threshold, int refresh_interval ) {
+  mg->threshold = (threshold < 0) ? 0 : threshold;
+  mg->refresh_interval = (refresh_interval < 0) ? 0 : refresh_interval;
+  mg->change = 0;
+  motion_gate_invalidate(mg);
+}
+
+/** @copydoc motion_gate_check */
+int motion_gate_check ( t_motion_gate *mg, const uint8_t *pixels, int width, int height, int stride, int channels ) {
+  if (pixels == NULL || width < 1 || height < 1 || stride < width || (channels != 1 && channels != 4)) return 0;
+  sample(mg->cur, pixels, width, height, stride, channels);
+
+  // largest block SAD (mean absolute difference of the samples of a cell)
+  int change = 0;
+  if (mg->width == width && mg->height == height) {
+    for (int cy = 0; cy < MOTION_GATE_GRID_H; cy++) {
+      for (int cx = 0; cx < MOTION_GATE_GRID_W; cx++) {
+        int sad = 0;
+        for (int j = 0; j < MOTION_GATE_SAMPLES; j++) {
+          int o = (cy * MOTION_GATE_SAMPLES + j) * MOTION_GATE_THUMB_W + cx * MOTION_GATE_SAMPLES;
+          for (int i = 0; i < MOTION_GATE_SAMPLES; i++) sad += abs(mg->cur[o + i] - mg->ref[o + i]);
+        }
+        if (sad > change) change = sad;
+      }
+    }
+    change /= MOTION_GATE_SAMPLES * MOTION_GATE_SAMPLES;
+  }
+  mg->change = change;
+
+  if (mg->width != width || mg->height != height) return 0;
+  if (mg->refresh_interval > 0 && mg->nreused >= mg->refresh_interval) return 0;
+  if (change > mg->threshold) return 0;
+  mg->nreused++;
+  return 1;
+}
+
+/** @copydoc motion_gate_commit */
+void motion_gate_commit ( t_motion_gate *mg, int width, int height ) {
+  memcpy(mg->ref, mg->cur, sizeof(mg->ref));
+  mg->width = width;
+  mg->height = height;
+  mg->nreused = 0;
+}
+
+/** @copydoc motion_gate_invalidate */
+void motion_gate_invalidate ( t_motion_gate *mg ) {
+  mg->width = 0;
+  mg->height = 0;
+  mg->nreused = 0;
+}
@@ -0,0 +1,82 @@
+/** @file motion_gate.h
+*  @brief Definitions for a change detector that tells if a frame is the same scene as the last frame detected
+*
+*  Keeps a heavily downsampled copy (thumbnail) of the last frame detected: a grid of cells, each sampled at a few
+*  points (2x2 pixel means). A frame is unchanged when the mean absolute difference of the samples of every cell (block
+*  SAD) stays within a threshold, so a small tag moving in one cell is noticed while sensor noise, spread over the samples,
+*  is not. Frames are compared to the last frame detected, not the previous one, so slow drifts add up
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _MOTION_GATE_H_
+#define _MOTION_GATE_H_
+
+#include <stdint.h>
+
+// thumbnail grid (cells) and samples per cell side
+#define MOTION_GATE_GRID_W 32
+#define MOTION_GATE_GRID_H 24
+#define MOTION_GATE_SAMPLES 4
+
+#define MOTION_GATE_THUMB_W (MOTION_GATE_GRID_W * MOTION_GATE_SAMPLES)
+#define MOTION_GATE_THUMB_H (MOTION_GATE_GRID_H * MOTION_GATE_SAMPLES)
+
+#define MOTION_GATE_INITIALIZER { .threshold = 6, .refresh_interval = 30, .width = 0, .height = 0, .nreused = 0, .change = 0 }
+
+/**
+ * @typedef t_motion_gate
+ * @brief Change detector state
+ */
+typedef struct {
+  int threshold;          // largest mean absolute difference of a cell (gray levels) of an unchanged frame
+  int refresh_interval;   // most frames reused in a row; the next one is detected (0=no limit)
+  int width, height;      // size of the reference frame (0=no reference)
+  int nreused;            // frames reused since the reference
+  int change;             // largest mean absolute difference of a cell in the last frame checked
+  uint8_t ref[MOTION_GATE_THUMB_H * MOTION_GATE_THUMB_W];  // thumbnail of the reference (the last frame detected)
+  uint8_t cur[MOTION_GATE_THUMB_H * MOTION_GATE_THUMB_W];  // thumbnail of the last frame checked
+} t_motion_gate;
+
+/**
+ * @brief Reset the change detector (no reference) and set its parameters
+ *
+ * @param mg the change detector
+ * @param threshold largest mean absolute difference of a cell (gray levels) of an unchanged frame
+ * @param refresh_interval most frames reused in a row (0=no limit)
+ */
+void motion_gate_reset ( t_motion_gate *mg, int threshold, int refresh_interval );
+
+/**
+ * @brief Check if a frame is unchanged from the reference; counts it as reused if it is
+ *
+ * @param mg the change detector
+ * @param pixels the frame: grayscale (channels=1) or RGBA (channels=4; compared by luma)
+ * @param width frame width
+ * @param height frame height
+ * @param stride pixels per row
+ * @param channels bytes per pixel (1 or 4)
+ *
+ * @return 1 if the results of the reference can be reused; 0 if the frame must be detected (it changed, there is no
+ *         reference or it has another size, or refresh_interval frames were reused in a row)
+ */
+int motion_gate_check ( t_motion_gate *mg, const uint8_t *pixels, int width, int height, int stride, int channels );
+
+/**
+ * @brief Make the last frame checked the reference, after it was detected
+ *
+ * @param mg the change detector
+ * @param width frame width
+ * @param height frame height
+ */
+void motion_gate_commit ( t_motion_gate *mg, int width, int height );
+
+/**
+ * @brief Drop the reference (e.g. its results are out of date); the next frame is detected
+ *
+ * @param mg the change detector
+ */
+void motion_gate_invalidate ( t_motion_gate *mg );
+
+#endif
@@ -0,0 +1,60 @@
+/** @file quad_rank.c
+ *  @brief Ranking of candidate quads
+ *  @see documentation in quad_rank.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "quad_rank.h"
+
+/**
+ * @brief Pixel nearest to a point, clamped to the image
+ */
+static int sample ( const image_u8_t *im, double x, double y ) {
+  int ix = (int)floor(x), iy = (int)floor(y);
+  ix = (ix < 0) ? 0 : (ix >= im->width) ? im->width - 1 : ix;
+  iy = (iy < 0) ? 0 : (iy >= im->height) ? im->height - 1 : iy;
+  return im->buf[iy * im->stride + ix];
+}
+
+/** @copydoc quad_rank_score */
+double quad_rank_score ( const image_u8_t *im, const float p[4][2] ) {
+  // area (shoelace formula)
+  double area = 0;
+  for (int i = 0; i < 4; i++) {
+    int j = (i + 1) % 4;
+    area += (double)p[i][0] * p[j][1] - (double)p[j][0] * p[i][1];
+  }
+  area = fabs(area) / 2;
+  if (area == 0) return 0;
+
+  double cx = (p[0][0] + p[1][0] + p[2][0] + p[3][0]) / 4.0;
+  double cy = (p[0][1] + p[1][1] + p[2][1] + p[3][1]) / 4.0;
+
+  // contrast between each side of each edge, at its midpoint (either polarity: some families have reversed borders)
+  double contrast = 0;
+  for (int i = 0; i < 4; i++) {
+    int j = (i + 1) % 4;
+    double mx = (p[i][0] + p[j][0]) / 2.0, my = (p[i][1] + p[j][1]) / 2.0;
+    double dx = (cx - mx) * QUAD_RANK_EDGE_OFFSET, dy = (cy - my) * QUAD_RANK_EDGE_OFFSET;
+    contrast += abs(sample(im, mx + dx, my + dy) - sample(im, mx - dx, my - dy));
+  }
+
+  return area * contrast / 4;
+}
+
+/**
+ * @brief Highest score first; ties by index
+ */
+static int compare_rank ( const void *a, const void *b ) {
+  const t_quad_rank *ra = a, *rb = b;
+  if (ra->score != rb->score) return (ra->score > rb->score) ? -1 : 1;
+  return ra->index - rb->index;
+}
+
+/** @copydoc quad_rank_sort */
+void quad_rank_sort ( t_quad_rank *ranks, int n ) {
+  qsort(ranks, n, sizeof(t_quad_rank), compare_rank);
+}
@@ -0,0 +1,47 @@
+/** @file quad_rank.h
+*  @brief Definitions for ranking candidate quads, so the ones most likely to be tags are decoded first
+*
+*  A quad is scored by its size and the contrast across its edges (tags have a dark border next to a light one); when
+*  a frame has more candidates than there is time to decode, decoding them by rank keeps the likely tags
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _QUAD_RANK_H_
+#define _QUAD_RANK_H_
+
+#include "common/image_u8.h"
+
+// where the contrast of an edge is sampled: this fraction of the way from the edge midpoint to the quad center, on
+// each side of the edge (inside the border of the tag; outside the tag)
+#define QUAD_RANK_EDGE_OFFSET 0.125
+
+/**
+ * @typedef t_quad_rank
+ * @brief A scored candidate
+ */
+typedef struct {
+  double score;  // size (area, in pixels) times mean contrast across the edges (0..255)
+  int index;     // index of the candidate
+} t_quad_rank;
+
+/**
+ * @brief Score a candidate quad
+ *
+ * @param im image the quad was found in
+ * @param p corners of the quad, in the coordinates of im
+ *
+ * @return the score (>= 0; 0 for a degenerate quad or no contrast)
+ */
+double quad_rank_score ( const image_u8_t *im, const float p[4][2] );
+
+/**
+ * @brief Sort scored candidates, highest score first (ties keep their order)
+ *
+ * @param ranks the candidates
+ * @param n number of candidates
+ */
+void quad_rank_sort ( t_quad_rank *ranks, int n );
+
+#endif
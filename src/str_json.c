@@ -6,11 +6,19 @@
  */
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <math.h>
 #include "str_json.h"
 
+// powers of ten up to 10^STR_JSON_MAX_DECIMALS
+static const double pow10_tab[STR_JSON_MAX_DECIMALS+1] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+// scaled values from this up are formatted with printf (integers above 2^53 are not exact in a double)
+#define DOUBLE_EXACT_INT 9007199254740992.0
+
 /** @copydoc str_json_create */
 int str_json_create ( t_str_json *str_json, size_t size_bytes ) {
    if (str_json->str != NULL) return -1;
@@ -19,7 +27,10 @@ int str_json_create ( t_str_json *str_json, size_t size_bytes ) {
    if (size_bytes == 0) return -1;
    str_json->alloc_size=size_bytes;
    str_json->str = malloc(size_bytes+1); // allocate 1 byte extra
-   if (str_json->str == NULL) return -1;
+   if (str_json->str == NULL) {
+     str_json->alloc_size = 0;
+     return -1;
+   }
    str_json->len = 0;
    str_json->str[0] = '\0';
    return 0;
@@ -43,39 +54,154 @@ void str_json_clear ( t_str_json *str_json ) {
    str_json->len = 0;
 }
 
-/** @copydoc str_json_concat */
-size_t str_json_concat ( t_str_json *str_json_dest, const char *source_c_str ) {
+/** @copydoc str_json_reserve */
+int str_json_reserve ( t_str_json *str_json, size_t size_bytes ) {
+  if (str_json->alloc_size == 0) return -1;
+  if (str_json->str == NULL) return -1;
+  assert(str_json->alloc_size >= str_json->len); // should never be smaller
+  if (str_json->alloc_size - str_json->len >= size_bytes) return 0;
+
+  size_t need = str_json->len + size_bytes;
+  if (need < str_json->len) return -1; // overflow
+  size_t new_size = str_json->alloc_size * 2;
+  if (new_size < need) new_size = need;
+  char *new_str = realloc(str_json->str, new_size+1); // allocate 1 byte extra
+  if (new_str == NULL) return -1;
+  str_json->str = new_str;
+  str_json->alloc_size = new_size;
+  return 0;
+}
+
+/** @copydoc str_json_append */
+size_t str_json_append ( t_str_json *str_json_dest, const char *source, size_t size_bytes ) {
   if (str_json_dest->alloc_size == 0) return 0;
   if (str_json_dest->str == NULL) return 0;
-  if (source_c_str == NULL) return 0;
-  if (str_json_dest->alloc_size == str_json_dest->len) return str_json_dest->len;
-  assert(str_json_dest->alloc_size >= str_json_dest->len); // should never be smaller
+  if (source == NULL) return str_json_dest->len;
 
-  int num = str_json_dest->alloc_size - str_json_dest->len;
-  assert(num >= 0);
-  strncat(str_json_dest->str, source_c_str, num); // strncat should always add a terminating null character
-  str_json_dest->str[str_json_dest->alloc_size]='\0'; // we add our own too
-  str_json_dest->len = strlen(str_json_dest->str);
+  if (str_json_reserve(str_json_dest, size_bytes) != 0) {
+    size_t num = str_json_dest->alloc_size - str_json_dest->len; // could not grow; append what fits
+    if (size_bytes > num) size_bytes = num;
+  }
+  memcpy(str_json_dest->str + str_json_dest->len, source, size_bytes);
+  str_json_dest->len += size_bytes;
+  str_json_dest->str[str_json_dest->len] = '\0';
 
   assert(str_json_dest->alloc_size >= str_json_dest->len); // should never be smaller
   return str_json_dest->len;
 }
 
+/** @copydoc str_json_concat */
+size_t str_json_concat ( t_str_json *str_json_dest, const char *source_c_str ) {
+  if (source_c_str == NULL) return str_json_dest->len;
+  return str_json_append(str_json_dest, source_c_str, strlen(source_c_str));
+}
+
 /** @copydoc str_json_printf */
 size_t str_json_printf ( t_str_json *str_json_dest, const char *format, ... ) {
   if (str_json_dest->alloc_size == 0) return 0;
   if (str_json_dest->str == NULL) return 0;
-  if (str_json_dest->alloc_size == str_json_dest->len) return str_json_dest->len;
   assert(str_json_dest->alloc_size >= str_json_dest->len); // should never be smaller
 
-  int num = str_json_dest->alloc_size - str_json_dest->len;
+  size_t num = str_json_dest->alloc_size - str_json_dest->len;
   va_list args;
   va_start (args, format);
-  vsnprintf (str_json_dest->str, num, format, args);
+  int r = vsnprintf (str_json_dest->str + str_json_dest->len, num+1, format, args); // string is allocated with +1
   va_end (args);
-  str_json_dest->str[str_json_dest->alloc_size]='\0'; // we add our own too (string is allocated with +1)
-  str_json_dest->len = strlen(str_json_dest->str);
+  if (r < 0) {
+    str_json_dest->str[str_json_dest->len] = '\0';
+    return str_json_dest->len;
+  }
+
+  if ((size_t)r > num) {
+    if (str_json_reserve(str_json_dest, r) == 0) {
+      // did not fit; format again into the grown string
+      va_start (args, format);
+      vsnprintf (str_json_dest->str + str_json_dest->len, r+1, format, args);
+      va_end (args);
+    } else r = num; // could not grow; vsnprintf wrote what fits
+  }
+  str_json_dest->len += r;
 
   assert(str_json_dest->alloc_size >= str_json_dest->len); // should never be smaller
   return str_json_dest->len;
 }
+
+/** @copydoc str_json_int */
+size_t str_json_int ( t_str_json *str_json_dest, long value ) {
+  char buf[24];
+  char *p = buf + sizeof(buf);
+  unsigned long u = (value < 0) ? 0UL - (unsigned long)value : (unsigned long)value;
+
+  // write the digits backwards from the end of buf
+  do {
+    *--p = '0' + (u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (value < 0) *--p = '-';
+
+  return str_json_append(str_json_dest, p, buf + sizeof(buf) - p);
+}
+
+/** @copydoc str_json_fixed */
+size_t str_json_fixed ( t_str_json *str_json_dest, double value, int decimals ) {
+  char buf[32];
+  char *p = buf + sizeof(buf);
+
+  if (!isfinite(value)) return str_json_append(str_json_dest, "null", 4);
+  if (decimals < 0) decimals = 0;
+  if (decimals > STR_JSON_MAX_DECIMALS) decimals = STR_JSON_MAX_DECIMALS;
+
+  double scaled = fabs(value) * pow10_tab[decimals];
+  if (scaled >= DOUBLE_EXACT_INT) {
+    // too large to round in an integer; let printf do it and drop the trailing zeros
+    size_t start = str_json_dest->len;
+    size_t len = str_json_printf(str_json_dest, "%.*f", decimals, value);
+    if (decimals > 0 && len > start && memchr(str_json_dest->str + start, '.', len - start) != NULL) {
+      while (str_json_dest->str[len-1] == '0') len--;
+      if (str_json_dest->str[len-1] == '.') len--;
+      str_json_dest->len = len;
+      str_json_dest->str[len] = '\0';
+    }
+    return str_json_dest->len;
+  }
+
+  // round to an integer number of 10^-decimals units, and drop the trailing zeros of the fraction
+  uint64_t u = (uint64_t)(scaled + 0.5);
+  int negative = (value < 0 && u != 0); // no -0
+  int frac_digits = decimals;
+  while (frac_digits > 0 && u % 10 == 0) {
+    u /= 10;
+    frac_digits--;
+  }
+
+  // write the digits backwards from the end of buf: fraction, point, integer part
+  if (frac_digits > 0) {
+    for (int i = 0; i < frac_digits; i++) {
+      *--p = '0' + (u % 10);
+      u /= 10;
+    }
+    *--p = '.';
+  }
+  do {
+    *--p = '0' + (u % 10);
+    u /= 10;
+  } while (u != 0);
+  if (negative) *--p = '-';
+
+  return str_json_append(str_json_dest, p, buf + sizeof(buf) - p);
+}
+
+/** @copydoc str_json_double */
+size_t str_json_double ( t_str_json *str_json_dest, double value ) {
+  char buf[32];
+  int len = 0;
+
+  if (!isfinite(value)) return str_json_append(str_json_dest, "null", 4);
+
+  for (int digits = 15; digits <= 17; digits++) {
+    len = snprintf(buf, sizeof(buf), "%.*g", digits, value);
+    if (strtod(buf, NULL) == value) break;
+  }
+
+  return str_json_append(str_json_dest, buf, len);
+}
@@ -8,32 +8,32 @@
 #ifndef _STR_JSON_JS_
 #define _STR_JSON_JS_
 
+#include <stddef.h>
+
+// maximum decimal places of str_json_fixed()
+#define STR_JSON_MAX_DECIMALS 9
+
 #define STR_JSON_INITIALIZER { .len = 0, .str=NULL, .alloc_size=0 }
  /**
   * @typedef t_str_json
-  * @brief json string structure
+  * @brief json string structure; an append buffer that grows as needed (doubling its size), so that building a string
+  *        costs time linear in its length
   * @warning this is the structure returned to javascript; it assumes the *first* four bytes are the length of the string
   */
 typedef struct {
   size_t len; // string length
   char *str;
-  size_t alloc_size; // allocated size
+  size_t alloc_size; // allocated size (not counting the terminating null character)
 } t_str_json;
 
 // json format string for errors
 extern const char fmt_error[];
 
-// json format string for the detection corners
-extern const char fmt_det_point[];
-
-// json format string for the detection with pose
-extern const char fmt_det_point_pose[];
-
 /**
  * @brief Init a string
  *
  * @param str_json t_str_json structure to hold the string info
- * @param size_bytes size of the string to allocate
+ * @param size_bytes initial size of the string to allocate (the string grows as needed)
  *
  * @return 0=success; -1 on error
  * @warning Declare strings with: t_str_json a_str = STR_JSON_INITIALIZER;
@@ -51,18 +51,42 @@ int str_json_create ( t_str_json *str_json, size_t size_bytes );
 int str_json_destroy ( t_str_json *str_json );
 
  /**
-  * @brief Clear a string
+  * @brief Clear a string; keeps the allocated memory, so the string can be reused without allocating
   *
   * @param str_json t_str_json structure of the string to clear
   */
 void str_json_clear ( t_str_json *str_json );
 
 /**
- * @brief Copy the content of source_c_str to str_json_dest
+ * @brief Make sure a string can take size_bytes more characters without allocating
+ *
+ * Grows the allocation to at least twice its size, so that a sequence of appends costs amortized constant time per character
+ *
+ * @param str_json t_str_json structure with the string info (must have been created)
+ * @param size_bytes number of characters to be appended
+ *
+ * @return 0=success; -1 on error (string not created or could not allocate memory)
+ */
+int str_json_reserve ( t_str_json *str_json, size_t size_bytes );
+
+/**
+ * @brief Append size_bytes characters of source to str_json_dest
+ *
+ * A terminating null character is always appended to dest.str. If memory cannot be allocated, appends what fits
+ *
+ * @param str_json_dest the destination t_str_json structure with the destination string info
+ * @param source the characters to append (need not be null-terminated)
+ * @param size_bytes number of characters to append
+ *
+ * @return the length, in bytes, of the new string
+ */
+size_t str_json_append ( t_str_json *str_json_dest, const char *source, size_t size_bytes );
+
+/**
+ * @brief Append the content of source_c_str to str_json_dest
  *
- * Copies up to the terminating null-character, or no more space in dest
- * A terminating null character is always appended to dest.str.
- * IMPORTANT: dest is assumed to be null-terminated
+ * Copies up to the terminating null-character; the string grows as needed.
+ * A terminating null character is always appended to dest.str. If memory cannot be allocated, appends what fits
  *
  * @param str_json_dest the destination t_str_json structure with the destination string info
  * @param source_c_str a null-terminated c string (char *) to the source string
@@ -72,14 +96,56 @@ void str_json_clear ( t_str_json *str_json );
 size_t str_json_concat ( t_str_json *str_json_dest, const char *source_c_str );
 
 /**
- * @brief Composes a string with the same text that would be printed if format was used on printf,
+ * @brief Append a string with the same text that would be printed if format was used on printf
+ *
+ * The string grows as needed. If memory cannot be allocated, appends what fits
  *
  * @param str_json_dest the destination t_str_json structure with the destination string info
  * @param format a format string
  * @param ... additional arguments
  *
- * @return The number of characters that would have been written if str_json_dest had been sufficiently large, not counting the terminating null character.
+ * @return the length, in bytes, of the new string
  */
 size_t str_json_printf ( t_str_json *str_json_dest, const char *format, ... );
 
+/**
+ * @brief Append an integer
+ *
+ * @param str_json_dest the destination t_str_json structure with the destination string info
+ * @param value the integer
+ *
+ * @return the length, in bytes, of the new string
+ */
+size_t str_json_int ( t_str_json *str_json_dest, long value );
+
+/**
+ * @brief Append a double at a fixed precision: rounded to a number of decimal places (as printf "%.*f"), without printf
+ *
+ * Not a round trip: the value read back is the double rounded to decimals places (see str_json_double() for an exact
+ * one). Trailing zeros are dropped: 1.50 is written as 1.5, 2.00 as 2. Values that are not finite are written as null
+ * (json has no nan/inf). Halves round away from zero, so on ties the last digit may be one more than printf's (which
+ * rounds ties to even)
+ *
+ * @param str_json_dest the destination t_str_json structure with the destination string info
+ * @param value the double
+ * @param decimals number of decimal places (0 to STR_JSON_MAX_DECIMALS)
+ *
+ * @return the length, in bytes, of the new string
+ */
+size_t str_json_fixed ( t_str_json *str_json_dest, double value, int decimals );
+
+/**
+ * @brief Append a double with the fewest significant digits (15 to 17) that read back as the same double
+ *
+ * Tries printf "%.15g" and adds a digit while the result does not parse back (strtod) to exactly the value; 17 digits
+ * always do. Exponents are written as printf does (1e+20), which json accepts. Values that are not finite are written
+ * as null (json has no nan/inf)
+ *
+ * @param str_json_dest the destination t_str_json structure with the destination string info
+ * @param value the double
+ *
+ * @return the length, in bytes, of the new string
+ */
+size_t str_json_double ( t_str_json *str_json_dest, double value );
+
 #endif
@@ -0,0 +1,70 @@
+/** @file tag_decode_table.c
+ *  @brief Tag family decode tables generated at build time
+ *  @see documentation in tag_decode_table.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "tag_decode_table.h"
+
+// tables may be first used by several threads at once, except in WASM builds without pthreads
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#include <pthread.h>
+static pthread_mutex_t fill_lock = PTHREAD_MUTEX_INITIALIZER;
+#define FILL_LOCK() pthread_mutex_lock(&fill_lock)
+#define FILL_UNLOCK() pthread_mutex_unlock(&fill_lock)
+#else
+#define FILL_LOCK()
+#define FILL_UNLOCK()
+#endif
+
+/**
+ * @brief Fill a table from its generated codes, if it was not filled yet; inserts as the library does (open
+ *        addressing, linear probing from code % nentries)
+ *
+ * @return 0 if the table is filled; -1 on allocation failure
+ */
+static int fill_table ( const t_tag_decode_table *t ) {
+  FILL_LOCK();
+  if (t->table->entries == NULL) {
+    t_qd_entry *entries = malloc(t->nentries * sizeof(t_qd_entry));
+    if (entries != NULL) {
+      for (int i = 0; i < t->nentries; i++) entries[i] = (t_qd_entry) { .rcode = UINT64_MAX };
+      for (int i = 0; i < t->nwords; i++) {
+        uint32_t bucket = t->rcodes[i] % t->nentries;
+        while (entries[bucket].rcode != UINT64_MAX) bucket = (bucket + 1) % t->nentries;
+        entries[bucket] = (t_qd_entry) { .rcode = t->rcodes[i], .id = t->ids[i] >> 2, .hamming = t->ids[i] & 3 };
+      }
+      t->table->nentries = t->nentries;
+      t->table->entries = entries;
+    }
+  }
+  int filled = (t->table->entries != NULL);
+  FILL_UNLOCK();
+  return filled ? 0 : -1;
+}
+
+/** @copydoc tag_decode_table_attach */
+int tag_decode_table_attach ( apriltag_family_t *fam, int bits_corrected ) {
+  if (fam->impl != NULL) return -1;
+  for (const t_tag_decode_table *t = tag_decode_tables; t->family != NULL; t++) {
+    if (t->bits_corrected == bits_corrected && t->ncodes == fam->ncodes && strcmp(t->family, fam->name) == 0) {
+      if (fill_table(t) != 0) return -1;
+      fam->impl = t->table;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+/** @copydoc tag_decode_table_detach */
+void tag_decode_table_detach ( apriltag_family_t *fam ) {
+  for (const t_tag_decode_table *t = tag_decode_tables; t->family != NULL; t++) {
+    if (fam->impl == t->table) {
+      fam->impl = NULL;
+      return;
+    }
+  }
+}
@@ -0,0 +1,86 @@
+/** @file tag_decode_table.h
+*  @brief Definitions for the tag family decode tables generated at build time
+*
+*  The apriltag detector decodes tags with a hash table of all codes of a family within the number of bits corrected
+*  (the "quick decode" table), which apriltag_detector_add_family_bits() builds when a family is added. The codes of the
+*  tables of the families we use are generated at build time (by atagjs_gen_tables, into tag_decode_tables.c), without
+*  the empty entries of the hash table; each table is filled from them once, when first used, and shared by every
+*  detector, so adding a family does not compute the codes (nor build a table per detector)
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _TAG_DECODE_TABLE_H_
+#define _TAG_DECODE_TABLE_H_
+
+#include <stdint.h>
+#include "apriltag.h"
+
+/**
+ * @typedef t_qd_entry
+ * @brief A decode table entry
+ * @warning must have the same layout as struct quick_decode_entry in apriltag.c (private to the library);
+ *          atagjs_gen_tables checks it against the tables built by the library
+ */
+typedef struct {
+  uint64_t rcode;    // the code (UINT64_MAX if empty)
+  uint16_t id;       // the tag id
+  uint8_t hamming;   // number of bits corrected
+  uint8_t rotation;  // unused
+} t_qd_entry;
+
+/**
+ * @typedef t_qd_table
+ * @brief A decode table, as set in the impl field of a family
+ * @warning must have the same layout as struct quick_decode in apriltag.c (private to the library)
+ */
+typedef struct {
+  int nentries;
+  t_qd_entry *entries;
+} t_qd_table;
+
+// id and bits corrected of a code of a generated table, in 16 bits (ids up to 16383, up to 3 bits corrected)
+#define TAG_DECODE_ID(id, hamming) ((uint16_t)(((id) << 2) | (hamming)))
+
+/**
+ * @typedef t_tag_decode_table
+ * @brief A decode table generated at build time
+ */
+typedef struct {
+  const char *family;      // family name
+  int bits_corrected;      // bits corrected the table was built for
+  uint32_t ncodes;         // number of codes in the family
+  int nentries;            // size of the table (as the library sizes it)
+  int nwords;              // codes in the table (each family code, and the codes within bits_corrected bits of it)
+  const uint64_t *rcodes;  // the codes in the table, sorted
+  const uint16_t *ids;     // id and bits corrected of each code (TAG_DECODE_ID())
+  t_qd_table *table;       // the table; empty until first used
+} t_tag_decode_table;
+
+// tables generated at build time (tag_decode_tables.c); terminated by an entry with family=NULL
+extern const t_tag_decode_table tag_decode_tables[];
+
+/**
+ * @brief Use the build-time decode table of a family, if there is one
+ *
+ * Call before adding the family to a detector (apriltag_detector_add_family_bits() then uses the table instead of
+ * building one); call tag_decode_table_detach() before removing the family from the detector or destroying the detector.
+ * The first call for a table fills it from the generated codes; the table is then kept (shared by all families using it)
+ *
+ * @param fam the family
+ * @param bits_corrected number of bits corrected
+ *
+ * @return 0 if the family now uses a build-time table; -1 if there is no table for the family and bits corrected (or the
+ *         family already has a table, or the table could not be allocated)
+ */
+int tag_decode_table_attach ( apriltag_family_t *fam, int bits_corrected );
+
+/**
+ * @brief Stop using a build-time decode table, so the detector does not try to release it
+ *
+ * @param fam the family; nothing is done if it does not use a build-time table
+ */
+void tag_decode_table_detach ( apriltag_family_t *fam );
+
+#endif
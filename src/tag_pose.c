@@ -0,0 +1,532 @@
+/** @file tag_pose.c
+ *  @brief Tag pose estimation with a per-tag pose cache
+ *  @see documentation in tag_pose.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <string.h>
+#include <math.h>
+#include "common/matd.h"
+#include "tag_pose.h"
+
+// corners of the tag in tag coordinates, times half the tag size (same object points as estimate_tag_pose_orthogonal_iteration)
+static const double tag_corners[4][2] = { { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+
+// largest root the polynomial solver looks for (as the apriltag library)
+#define POLY_MAX_ROOT 1000
+
+/**
+ * @typedef t_pose_problem
+ * @brief Object points and image rays of the four corners, and the terms of orthogonal iteration that do not change
+ *        across steps; on the stack, so estimating a pose does not allocate
+ */
+typedef struct {
+  double p[4][3];       // object points (z = 0: the tag is planar)
+  double v[4][3];       // image rays (normalized image coordinates, z = 1)
+  double p_res[4][3];   // object points minus their mean
+  double F[4][9];       // projection on each image ray: v v' / v'v (row major)
+  double M1_inv[9];     // (I - mean of F)^-1
+} t_pose_problem;
+
+/**
+ * @brief Find the cached pose of a tag
+ *
+ * @return index of the pose; -1 if the tag is not in the cache
+ */
+static int find_pose ( const t_tag_pose_cache *pc, const apriltag_family_t *family, int id ) {
+  for (int i = 0; i < pc->nposes; i++)
+    if (pc->poses[i].id == id && pc->poses[i].family == family) return i;
+  return -1;
+}
+
+/**
+ * @brief a*b, 3x3 row major (c must not be a or b)
+ */
+static void mat3_mul ( const double *a, const double *b, double *c ) {
+  for (int r = 0; r < 3; r++)
+    for (int k = 0; k < 3; k++) c[r*3+k] = a[r*3] * b[k] + a[r*3+1] * b[3+k] + a[r*3+2] * b[6+k];
+}
+
+/**
+ * @brief a*x, 3x3 row major times a 3-vector (y must not be x)
+ */
+static void mat3_vec ( const double *a, const double *x, double *y ) {
+  for (int r = 0; r < 3; r++) y[r] = a[r*3] * x[0] + a[r*3+1] * x[1] + a[r*3+2] * x[2];
+}
+
+/**
+ * @brief a'*x, transpose of a 3x3 row major times a 3-vector (y must not be x)
+ */
+static void mat3t_vec ( const double *a, const double *x, double *y ) {
+  for (int r = 0; r < 3; r++) y[r] = a[r] * x[0] + a[3+r] * x[1] + a[6+r] * x[2];
+}
+
+static double dot3 ( const double *a, const double *b ) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross3 ( const double *a, const double *b, double *c ) {
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/**
+ * @brief Inverse of a 3x3 row major matrix
+ *
+ * @return 0=success; -1 if it is singular
+ */
+static int mat3_inv ( const double *a, double *inv ) {
+  double c[9] = {
+    a[4] * a[8] - a[5] * a[7], a[2] * a[7] - a[1] * a[8], a[1] * a[5] - a[2] * a[4],
+    a[5] * a[6] - a[3] * a[8], a[0] * a[8] - a[2] * a[6], a[2] * a[3] - a[0] * a[5],
+    a[3] * a[7] - a[4] * a[6], a[1] * a[6] - a[0] * a[7], a[0] * a[4] - a[1] * a[3] };
+  double det = a[0] * c[0] + a[1] * c[3] + a[2] * c[6];
+  if (det == 0) return -1;
+  for (int i = 0; i < 9; i++) inv[i] = c[i] / det;
+  return 0;
+}
+
+/**
+ * @brief Projection on a ray: v v' / v'v
+ */
+static void ray_projection ( const double *v, double *F ) {
+  double n = dot3(v, v);
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++) F[r*3+c] = v[r] * v[c] / n;
+}
+
+/**
+ * @brief Fill the object points and image rays of a detection, and the terms of orthogonal iteration that depend
+ *        only on them
+ *
+ * @return 0=success; -1 if the rays are degenerate
+ */
+static int pose_problem_init ( t_pose_problem *pp, apriltag_detection_info_t *info ) {
+  const apriltag_detection_t *det = info->det;
+  double scale = info->tagsize / 2.0;
+  double p_mean[3] = { 0, 0, 0 }, avg_F[9] = { 0 };
+
+  for (int i = 0; i < 4; i++) {
+    pp->p[i][0] = tag_corners[i][0] * scale;
+    pp->p[i][1] = tag_corners[i][1] * scale;
+    pp->p[i][2] = 0;
+    pp->v[i][0] = (det->p[i][0] - info->cx) / info->fx;
+    pp->v[i][1] = (det->p[i][1] - info->cy) / info->fy;
+    pp->v[i][2] = 1;
+    ray_projection(pp->v[i], pp->F[i]);
+    for (int r = 0; r < 3; r++) p_mean[r] += pp->p[i][r] / 4;
+    for (int k = 0; k < 9; k++) avg_F[k] += pp->F[i][k] / 4;
+  }
+  for (int i = 0; i < 4; i++)
+    for (int r = 0; r < 3; r++) pp->p_res[i][r] = pp->p[i][r] - p_mean[r];
+
+  double M1[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+  for (int k = 0; k < 9; k++) M1[k] -= avg_F[k];
+  return mat3_inv(M1, pp->M1_inv);
+}
+
+/**
+ * @brief The rotation nearest to M3 = sum (q - q_mean) p_res' (the rotation step of orthogonal iteration)
+ *
+ * The object points are planar (z = 0), so the third column of M3 is zero and the first two columns of the rotation
+ * are the orthonormal polar factor of the first two, A (A'A)^-1/2; the third is their cross product. This is U V' of
+ * the SVD of M3, with its sign fixed so the determinant is 1, as the apriltag library computes it
+ *
+ * @return 0=success; -1 if M3 is degenerate (R is left unchanged)
+ */
+static int nearest_rotation ( const double *M3, double *R ) {
+  // S = A'A (2x2), and its inverse square root: sqrt(S) = (S + sqrt(det S) I) / sqrt(tr S + 2 sqrt(det S))
+  double s00 = M3[0] * M3[0] + M3[3] * M3[3] + M3[6] * M3[6];
+  double s01 = M3[0] * M3[1] + M3[3] * M3[4] + M3[6] * M3[7];
+  double s11 = M3[1] * M3[1] + M3[4] * M3[4] + M3[7] * M3[7];
+  double det = s00 * s11 - s01 * s01;
+  if (!(det > 1e-30 * (s00 + s11) * (s00 + s11))) return -1;
+  double sq = sqrt(det), tr = sqrt(s00 + s11 + 2 * sq);
+  double h00 = (s00 + sq) / tr, h01 = s01 / tr, h11 = (s11 + sq) / tr;  // sqrt(S)
+  double hdet = h00 * h11 - h01 * h01;
+  double i00 = h11 / hdet, i01 = -h01 / hdet, i11 = h00 / hdet;         // sqrt(S)^-1
+
+  double c0[3], c1[3], c2[3];
+  for (int r = 0; r < 3; r++) {
+    c0[r] = M3[r*3] * i00 + M3[r*3+1] * i01;
+    c1[r] = M3[r*3] * i01 + M3[r*3+1] * i11;
+  }
+  cross3(c0, c1, c2);
+  for (int r = 0; r < 3; r++) {
+    R[r*3] = c0[r];
+    R[r*3+1] = c1[r];
+    R[r*3+2] = c2[r];
+  }
+  return 0;
+}
+
+/**
+ * @brief Orthogonal iteration, as orthogonal_iteration() of the apriltag library, with the pose in caller storage
+ *
+ * @param pp object points, image rays and the terms that do not change across steps
+ * @param t translation; computed from R by the first step
+ * @param R rotation (row major); the starting point
+ * @param n_steps number of steps
+ *
+ * @return the object-space error after the last step
+ */
+static double orthogonal_iteration_steps ( const t_pose_problem *pp, double *t, double *R, int n_steps ) {
+  double err = HUGE_VAL;
+  for (int s = 0; s < n_steps; s++) {
+    // translation: M1_inv * mean of (F - I) R p
+    double M2[3] = { 0, 0, 0 }, Rp[4][3];
+    for (int j = 0; j < 4; j++) {
+      double FRp[3];
+      mat3_vec(R, pp->p[j], Rp[j]);
+      mat3_vec(pp->F[j], Rp[j], FRp);
+      for (int r = 0; r < 3; r++) M2[r] += (FRp[r] - Rp[j][r]) / 4;
+    }
+    mat3_vec(pp->M1_inv, M2, t);
+
+    // rotation: nearest to sum (q - q_mean) p_res', with q = F (R p + t)
+    double q[4][3], q_mean[3] = { 0, 0, 0 }, M3[9] = { 0 };
+    for (int j = 0; j < 4; j++) {
+      double x[3] = { Rp[j][0] + t[0], Rp[j][1] + t[1], Rp[j][2] + t[2] };
+      mat3_vec(pp->F[j], x, q[j]);
+      for (int r = 0; r < 3; r++) q_mean[r] += q[j][r] / 4;
+    }
+    for (int j = 0; j < 4; j++)
+      for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++) M3[r*3+c] += (q[j][r] - q_mean[r]) * pp->p_res[j][c];
+    nearest_rotation(M3, R);
+
+    // error: sum of |(I - F)(R p + t)|^2
+    err = 0;
+    for (int j = 0; j < 4; j++) {
+      double x[3], Fx[3];
+      mat3_vec(R, pp->p[j], x);
+      for (int r = 0; r < 3; r++) x[r] += t[r];
+      mat3_vec(pp->F[j], x, Fx);
+      for (int r = 0; r < 3; r++) err += (x[r] - Fx[r]) * (x[r] - Fx[r]);
+    }
+  }
+  return err;
+}
+
+/**
+ * @brief Run orthogonal iteration in steps of TAG_POSE_STEP_ITERS until the error converges
+ *
+ * @param err object-space error of the starting pose; HUGE_VAL if unknown (the first step is not checked)
+ * @param iters incremented by the number of steps run
+ *
+ * @return the object-space error
+ */
+static double iterate ( const t_pose_problem *pp, double *t, double *R, double err, int *iters ) {
+  for (int n = 0; n < TAG_POSE_MAX_ITERS; n += TAG_POSE_STEP_ITERS) {
+    double e = orthogonal_iteration_steps(pp, t, R, TAG_POSE_STEP_ITERS);
+    *iters += TAG_POSE_STEP_ITERS;
+    int converged = isfinite(err) && (err - e <= TAG_POSE_REL_TOL * err);
+    err = e;
+    if (converged) break;
+  }
+  return err;
+}
+
+/**
+ * @brief Value of a polynomial (coefficients from degree 0)
+ */
+static double polyval ( const double *p, int degree, double x ) {
+  double y = p[degree];
+  for (int i = degree - 1; i >= 0; i--) y = y * x + p[i];
+  return y;
+}
+
+/**
+ * @brief Real roots of a polynomial in [-POLY_MAX_ROOT, POLY_MAX_ROOT], as solve_poly_approx() of the apriltag library:
+ *        between the roots of its derivative, by Newton's method safeguarded with bisection
+ *
+ * @param p coefficients, from degree 0
+ * @param degree degree of the polynomial (1 to 4)
+ * @param roots where to write the roots (degree of them at most)
+ *
+ * @return number of roots
+ */
+static int solve_poly ( const double *p, int degree, double *roots ) {
+  if (degree == 1) {
+    if (fabs(p[0]) > POLY_MAX_ROOT * fabs(p[1])) return 0;
+    roots[0] = -p[0] / p[1];
+    return 1;
+  }
+
+  double p_der[4], der_roots[3];
+  for (int i = 0; i < degree; i++) p_der[i] = (i + 1) * p[i+1];
+  int n_der_roots = solve_poly(p_der, degree - 1, der_roots);
+
+  int n_roots = 0;
+  for (int i = 0; i <= n_der_roots; i++) {
+    double min = (i == 0) ? -POLY_MAX_ROOT : der_roots[i-1];
+    double max = (i == n_der_roots) ? POLY_MAX_ROOT : der_roots[i];
+    double fmin = polyval(p, degree, min), fmax = polyval(p, degree, max);
+
+    if (fmin * fmax < 0) {
+      double lower = (fmin < fmax) ? min : max, upper = (fmin < fmax) ? max : min;
+      double root = 0.5 * (lower + upper);
+      double dx_old = upper - lower, dx = dx_old;
+      double f = polyval(p, degree, root), df = polyval(p_der, degree - 1, root);
+      for (int j = 0; j < 100; j++) {
+        if ((f + df * (upper - root)) * (f + df * (lower - root)) > 0 || fabs(2 * f) > fabs(dx_old * df)) {
+          dx_old = dx;
+          dx = 0.5 * (upper - lower);
+          root = lower + dx;
+        } else {
+          dx_old = dx;
+          dx = -f / df;
+          root += dx;
+        }
+        if (root == upper || root == lower) break;
+        f = polyval(p, degree, root);
+        df = polyval(p_der, degree - 1, root);
+        if (f > 0) upper = root;
+        else lower = root;
+      }
+      roots[n_roots++] = root;
+    } else if (fmax == 0) {
+      roots[n_roots++] = max;  // double or triple root
+    }
+  }
+  return n_roots;
+}
+
+/**
+ * @brief Search for a second local minimum of the object-space error, as fix_pose_ambiguities() of the apriltag library
+ *        (rotations about the axis perpendicular to the line of sight to the tag), with the pose in caller storage
+ *
+ * @param pp object points and image rays
+ * @param t translation of the first solution
+ * @param R rotation of the first solution (row major)
+ * @param R2 where to write the rotation of the second minimum
+ *
+ * @return 1 if there is a second minimum (distinct from the first); 0 otherwise
+ */
+static int second_minimum ( const t_pose_problem *pp, const double *t, const double *R, double *R2 ) {
+  static const double I3[9] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+  static const double M1[9] = { 0, 0, 2, 0, 0, 0, -2, 0, 0 };
+  static const double M2[9] = { -1, 0, 0, 0, 1, 0, 0, 0, -1 };
+
+  // 1. R_t: rotates the line of sight to the tag onto z
+  double r1[3] = { 1, 0, 0 }, r2[3], r3[3];
+  double tn = sqrt(dot3(t, t));
+  if (!(tn > 0)) return 0;
+  for (int r = 0; r < 3; r++) r3[r] = t[r] / tn;
+  for (int r = 0; r < 3; r++) r1[r] -= r3[0] * r3[r];
+  double r1n = sqrt(dot3(r1, r1));
+  if (!(r1n > 0)) return 0;
+  for (int r = 0; r < 3; r++) r1[r] /= r1n;
+  cross3(r3, r1, r2);
+  double R_t[9] = { r1[0], r1[1], r1[2], r2[0], r2[1], r2[2], r3[0], r3[1], r3[2] };
+
+  // 2. R_z
+  double R_1_prime[9];
+  mat3_mul(R_t, R, R_1_prime);
+  double r31 = R_1_prime[6], r32 = R_1_prime[7];
+  double hypotenuse = sqrt(r31 * r31 + r32 * r32);
+  if (hypotenuse < 1e-100) {
+    r31 = 1;
+    r32 = 0;
+    hypotenuse = 1;
+  }
+  double R_z[9] = { r31 / hypotenuse, -r32 / hypotenuse, 0, r32 / hypotenuse, r31 / hypotenuse, 0, 0, 0, 1 };
+
+  // 3. parameters of the error as a function of the rotation about y
+  double R_trans[9];
+  mat3_mul(R_1_prime, R_z, R_trans);
+  double sin_gamma = -R_trans[1], cos_gamma = R_trans[4];
+  double R_gamma[9] = { cos_gamma, -sin_gamma, 0, sin_gamma, cos_gamma, 0, 0, 0, 1 };
+  double t_initial = atan2(-R_trans[6], R_trans[8]);
+
+  double p_trans[4][3], F_trans[4][9], avg_F[9] = { 0 };
+  for (int i = 0; i < 4; i++) {
+    double v_trans[3];
+    mat3t_vec(R_z, pp->p[i], p_trans[i]);
+    mat3_vec(R_t, pp->v[i], v_trans);
+    ray_projection(v_trans, F_trans[i]);
+    for (int k = 0; k < 9; k++) avg_F[k] += F_trans[i][k] / 4;
+  }
+  double IF[9], G[9];
+  for (int k = 0; k < 9; k++) IF[k] = I3[k] - avg_F[k];
+  if (mat3_inv(IF, G) != 0) return 0;
+  for (int k = 0; k < 9; k++) G[k] /= 4;
+
+  // R_gamma p, R_gamma M1 p and R_gamma M2 p of each point
+  double RM1[9], RM2[9], x[3][4][3];
+  mat3_mul(R_gamma, M1, RM1);
+  mat3_mul(R_gamma, M2, RM2);
+  double b[3][3] = { { 0 } };
+  for (int i = 0; i < 4; i++) {
+    mat3_vec(R_gamma, p_trans[i], x[0][i]);
+    mat3_vec(RM1, p_trans[i], x[1][i]);
+    mat3_vec(RM2, p_trans[i], x[2][i]);
+    for (int k = 0; k < 3; k++) {
+      double Fx[3];
+      mat3_vec(F_trans[i], x[k][i], Fx);
+      for (int r = 0; r < 3; r++) b[k][r] += Fx[r] - x[k][i][r];
+    }
+  }
+  double b_[3][3];
+  for (int k = 0; k < 3; k++) mat3_vec(G, b[k], b_[k]);
+
+  double a0 = 0, a1 = 0, a2 = 0, a3 = 0, a4 = 0;
+  for (int i = 0; i < 4; i++) {
+    double c[3][3];
+    for (int k = 0; k < 3; k++) {
+      double y[3], Fy[3];
+      for (int r = 0; r < 3; r++) y[r] = x[k][i][r] + b_[k][r];
+      mat3_vec(F_trans[i], y, Fy);
+      for (int r = 0; r < 3; r++) c[k][r] = y[r] - Fy[r];
+    }
+    a0 += dot3(c[0], c[0]);
+    a1 += 2 * dot3(c[0], c[1]);
+    a2 += dot3(c[1], c[1]) + 2 * dot3(c[0], c[2]);
+    a3 += 2 * dot3(c[1], c[2]);
+    a4 += dot3(c[2], c[2]);
+  }
+
+  // 4. minima of the error
+  double poly[5] = { a1, 2 * a2 - 4 * a0, 3 * a3 - 3 * a1, 4 * a4 - 2 * a2, -a3 };
+  double roots[4], minima[4];
+  int n_roots = solve_poly(poly, 4, roots), n_minima = 0;
+  for (int i = 0; i < n_roots; i++) {
+    double t1 = roots[i], t2 = t1 * t1, t3 = t1 * t2, t4 = t1 * t3, t5 = t1 * t4;
+    // a minimum, at an angle different from the known one
+    if (a2 - 2 * a0 + (3 * a3 - 6 * a1) * t1 + (6 * a4 - 8 * a2 + 10 * a0) * t2 + (-8 * a3 + 6 * a1) * t3 +
+        (-6 * a4 + 3 * a2) * t4 + a3 * t5 >= 0 && fabs(2 * atan(roots[i]) - t_initial) > 0.1)
+      minima[n_minima++] = roots[i];
+  }
+  if (n_minima != 1) return 0;  // more than one: the first solution was not a good minimum
+
+  // 5. rotation of the minimum: R_t' R_gamma R_beta R_z'
+  double tb = minima[0], R_beta[9], A[9], B[9], R_tT[9], R_zT[9];
+  for (int k = 0; k < 9; k++) R_beta[k] = ((M2[k] * tb + M1[k]) * tb + I3[k]) / (1 + tb * tb);
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++) {
+      R_tT[r*3+c] = R_t[c*3+r];
+      R_zT[r*3+c] = R_z[c*3+r];
+    }
+  mat3_mul(R_tT, R_gamma, A);
+  mat3_mul(A, R_beta, B);
+  mat3_mul(B, R_zT, R2);
+  return 1;
+}
+
+/**
+ * @brief Object-space error of a pose: sum, over the corners, of the squared distance between the corner (in camera
+ *        coordinates) and its projection on the image ray of the detected corner
+ */
+static double object_space_error ( apriltag_detection_info_t *info, const double *R, const double *t ) {
+  const apriltag_detection_t *det = info->det;
+  double scale = info->tagsize / 2.0;
+  double err = 0;
+
+  for (int i = 0; i < 4; i++) {
+    double v[3] = { (det->p[i][0] - info->cx) / info->fx, (det->p[i][1] - info->cy) / info->fy, 1 };
+    double x[3];
+    for (int r = 0; r < 3; r++) x[r] = (R[r*3] * tag_corners[i][0] + R[r*3+1] * tag_corners[i][1]) * scale + t[r];
+    double k = (v[0] * x[0] + v[1] * x[1] + v[2] * x[2]) / (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int r = 0; r < 3; r++) {
+      double d = x[r] - k * v[r];
+      err += d * d;
+    }
+  }
+  return err;
+}
+
+/**
+ * @brief A matrix in arena memory (released with the arena, not with matd_destroy())
+ *
+ * @return the matrix, with a copy of data; NULL if the arena could not allocate it
+ */
+static matd_t *arena_matd ( t_frame_arena *fa, int nrows, int ncols, const double *data ) {
+  matd_t *m = frame_arena_alloc(fa, sizeof(matd_t) + nrows * ncols * sizeof(double));
+  if (m == NULL) return NULL;
+  m->nrows = nrows;
+  m->ncols = ncols;
+  memcpy(m->data, data, nrows * ncols * sizeof(double));
+  return m;
+}
+
+/** @copydoc tag_pose_cache_reset */
+void tag_pose_cache_reset ( t_tag_pose_cache *pc ) {
+  pc->frame = 0;
+  pc->nposes = 0;
+}
+
+/** @copydoc tag_pose_begin_frame */
+void tag_pose_begin_frame ( t_tag_pose_cache *pc ) {
+  pc->frame++;
+}
+
+/** @copydoc tag_pose_estimate */
+int tag_pose_estimate ( t_tag_pose_cache *pc, t_frame_arena *fa, apriltag_detection_info_t *info, double *err1, apriltag_pose_t *pose1, double *err2, apriltag_pose_t *pose2 ) {
+  apriltag_detection_t *det = info->det;
+  t_pose_problem pp;
+  double R1[9], t1[3], R2[9], t2[3];
+  int iters = 0;
+
+  pose1->R = pose1->t = pose2->R = pose2->t = NULL;
+  if (pose_problem_init(&pp, info) != 0) return -1;
+
+  // start from the last pose of the tag if it was seen in the last frame; from the homography pose otherwise
+  int k = find_pose(pc, det->family, det->id);
+  if (k >= 0 && pc->poses[k].last_frame == pc->frame - 1 && pc->poses[k].size == info->tagsize) {
+    memcpy(R1, pc->poses[k].R, sizeof(R1));
+    memcpy(t1, pc->poses[k].t, sizeof(t1));
+  } else {
+    apriltag_pose_t h;
+    estimate_pose_for_tag_homography(info, &h);
+    memcpy(R1, h.R->data, sizeof(R1));
+    memcpy(t1, h.t->data, sizeof(t1));
+    matd_destroy(h.R);
+    matd_destroy(h.t);
+  }
+  *err1 = iterate(&pp, t1, R1, object_space_error(info, R1, t1), &iters);
+
+  // second solution, only if there is a second local minimum
+  *err2 = HUGE_VAL;
+  int second = second_minimum(&pp, t1, R1, R2);
+  if (second) *err2 = iterate(&pp, t2, R2, HUGE_VAL, &iters); // no translation yet: the first step computes it
+
+  // the solutions, in the arena
+  pose1->R = arena_matd(fa, 3, 3, R1);
+  pose1->t = arena_matd(fa, 3, 1, t1);
+  if (second) {
+    pose2->R = arena_matd(fa, 3, 3, R2);
+    pose2->t = arena_matd(fa, 3, 1, t2);
+  }
+  if (pose1->R == NULL || pose1->t == NULL || (second && (pose2->R == NULL || pose2->t == NULL))) {
+    pose1->R = pose1->t = pose2->R = pose2->t = NULL;
+    return -1;
+  }
+
+  // cache the best solution; when the cache is full, replace the pose seen longest ago
+  if (k < 0) {
+    if (pc->nposes < TAG_POSE_CACHE_MAX) k = pc->nposes++;
+    else {
+      k = 0;
+      for (int i = 1; i < pc->nposes; i++)
+        if (pc->poses[i].last_frame < pc->poses[k].last_frame) k = i;
+    }
+  }
+  int first = (*err1 <= *err2);
+  t_tag_pose_entry *e = &pc->poses[k];
+  e->family = det->family;
+  e->id = det->id;
+  e->size = info->tagsize;
+  memcpy(e->R, first ? R1 : R2, sizeof(e->R));
+  memcpy(e->t, first ? t1 : t2, sizeof(e->t));
+  e->last_frame = pc->frame;
+
+  return iters;
+}
+
+/** @copydoc tag_pose_estimate_fast */
+double tag_pose_estimate_fast ( apriltag_detection_info_t *info, apriltag_pose_t *pose ) {
+  estimate_pose_for_tag_homography(info, pose);
+  return object_space_error(info, pose->R->data, pose->t->data);
+}
@@ -0,0 +1,103 @@
+/** @file tag_pose.h
+*  @brief Definitions for tag pose estimation with a per-tag pose cache
+*
+*  Keeps the last pose of each tag and uses it as the starting point of orthogonal iteration in the next frame, instead of
+*  the homography pose; iterations stop once the object-space error has converged, so the pose of static or
+*  slow-moving tags takes a few iterations
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _TAG_POSE_H_
+#define _TAG_POSE_H_
+
+#include "apriltag.h"
+#include "apriltag_pose.h"
+#include "frame_arena.h"
+
+// maximum number of tags in the pose cache
+#define TAG_POSE_CACHE_MAX 32
+
+// maximum orthogonal iteration steps per solution (same as the detector used before the cache)
+#define TAG_POSE_MAX_ITERS 50
+
+// orthogonal iteration steps between convergence checks
+#define TAG_POSE_STEP_ITERS 2
+
+// the error has converged when a check lowers it by less than this fraction
+#define TAG_POSE_REL_TOL 1e-6
+
+#define TAG_POSE_CACHE_INITIALIZER { .frame = 0, .nposes = 0 }
+
+/**
+ * @typedef t_tag_pose_entry
+ * @brief The last pose of a tag
+ */
+typedef struct {
+  const apriltag_family_t *family;  // tag family
+  int id;                           // tag id
+  double size;                      // tag size the pose was estimated with
+  double R[9];                      // rotation (row major, as in apriltag_pose_t)
+  double t[3];                      // translation
+  int last_frame;                   // frame of the pose
+} t_tag_pose_entry;
+
+/**
+ * @typedef t_tag_pose_cache
+ * @brief Pose cache state
+ */
+typedef struct {
+  int frame;               // current frame
+  int nposes;              // number of poses in the cache
+  t_tag_pose_entry poses[TAG_POSE_CACHE_MAX];
+} t_tag_pose_cache;
+
+/**
+ * @brief Empty the cache (e.g. when the camera intrinsics change)
+ *
+ * @param pc the pose cache
+ */
+void tag_pose_cache_reset ( t_tag_pose_cache *pc );
+
+/**
+ * @brief Start a new frame
+ *
+ * @param pc the pose cache
+ */
+void tag_pose_begin_frame ( t_tag_pose_cache *pc );
+
+/**
+ * @brief Estimate the pose of a tag, like estimate_tag_pose_orthogonal_iteration() (same object points and solutions)
+ *
+ * Orthogonal iteration starts from the cached pose when the tag was seen in the last frame with the same size, and
+ * from the homography pose otherwise; it stops after TAG_POSE_MAX_ITERS steps or when the error has converged. The
+ * second solution is only searched when the ambiguity test finds a second local minimum. The best solution is cached.
+ * Orthogonal iteration and the ambiguity test run on the stack, and the solutions are allocated in the arena, so only
+ * the homography pose (the library computes it with heap matrices) allocates: a tag seen in the last frame does not
+ *
+ * @param pc the pose cache
+ * @param fa arena for the solutions (valid until it is reset; not to be destroyed with matd_destroy())
+ * @param info detection info (detection, tag size and camera intrinsics)
+ * @param err1 object-space error of the first solution
+ * @param pose1 first solution
+ * @param err2 object-space error of the second solution (HUGE_VAL if there is none)
+ * @param pose2 second solution (R and t are NULL if there is none)
+ *
+ * @return number of orthogonal iteration steps, both solutions; -1 if the arena could not allocate the solutions (or the
+ *         image rays are degenerate), with no solutions
+ */
+int tag_pose_estimate ( t_tag_pose_cache *pc, t_frame_arena *fa, apriltag_detection_info_t *info, double *err1, apriltag_pose_t *pose1, double *err2, apriltag_pose_t *pose2 );
+
+/**
+ * @brief Estimate the pose of a tag in closed form, from the decomposition of the detection homography (the starting
+ *        point of orthogonal iteration); no iterations and a single solution
+ *
+ * @param info detection info (detection, tag size and camera intrinsics)
+ * @param pose the pose
+ *
+ * @return object-space error of the pose (as orthogonal iteration computes it)
+ */
+double tag_pose_estimate_fast ( apriltag_detection_info_t *info, apriltag_pose_t *pose );
+
+#endif
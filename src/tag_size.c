@@ -0,0 +1,113 @@
+/** @file tag_size.c
+ *  @brief Table of tag sizes, keyed by tag family and id
+ *  @see documentation in tag_size.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "tag_size.h"
+
+// key of an empty slot (not a valid key: families are < 0xff)
+#define EMPTY_KEY UINT32_MAX
+
+/**
+ * @brief Slot where a key is, or where it would be inserted (linear probing); the table must have an empty slot
+ */
+static int find_slot ( const t_tag_size_table *ts, uint32_t key ) {
+  uint32_t h = key * 0x9E3779B1u;  // Fibonacci hashing; ids of a family are consecutive
+  h ^= h >> 16;
+  int mask = ts->nslots - 1;
+  int i = h & mask;
+  while (ts->keys[i] != key && ts->keys[i] != EMPTY_KEY) i = (i + 1) & mask;
+  return i;
+}
+
+/**
+ * @brief Allocate the slots of a table (all empty)
+ *
+ * @return 0=success; -1 on allocation failure
+ */
+static int alloc_slots ( t_tag_size_table *ts, int nslots ) {
+  ts->keys = malloc(nslots * sizeof(uint32_t));
+  ts->sizes = malloc(nslots * sizeof(double));
+  if (ts->keys == NULL || ts->sizes == NULL) {
+    free(ts->keys);
+    free(ts->sizes);
+    *ts = (t_tag_size_table) TAG_SIZE_TABLE_INITIALIZER;
+    return -1;
+  }
+  memset(ts->keys, 0xff, nslots * sizeof(uint32_t));  // EMPTY_KEY
+  ts->nslots = nslots;
+  ts->len = 0;
+  return 0;
+}
+
+/** @copydoc tag_size_set */
+int tag_size_set ( t_tag_size_table *ts, int family, int id, double size ) {
+  if (family < 0 || family > TAG_SIZE_ANY_FAMILY || id < 0 || id > TAG_SIZE_MAX_ID) return -1;
+  uint32_t key = (uint32_t)family << 24 | (uint32_t)id;
+
+  if (ts->nslots == 0 && alloc_slots(ts, TAG_SIZE_MIN_SLOTS) != 0) return -1;
+
+  if ((ts->len + 1) * 4 > ts->nslots * 3) {
+    // grow: rehash into twice the slots
+    t_tag_size_table old = *ts;
+    if (alloc_slots(ts, old.nslots * 2) != 0) {
+      *ts = old;
+      return -1;
+    }
+    for (int i = 0; i < old.nslots; i++) {
+      if (old.keys[i] == EMPTY_KEY) continue;
+      int s = find_slot(ts, old.keys[i]);
+      ts->keys[s] = old.keys[i];
+      ts->sizes[s] = old.sizes[i];
+      ts->len++;
+    }
+    tag_size_destroy(&old);
+  }
+
+  int s = find_slot(ts, key);
+  if (ts->keys[s] == EMPTY_KEY) {
+    ts->keys[s] = key;
+    ts->len++;
+  }
+  ts->sizes[s] = size;
+  return 0;
+}
+
+/** @copydoc tag_size_get */
+double tag_size_get ( const t_tag_size_table *ts, int family, int id, double default_size ) {
+  if (ts->len == 0 || id < 0 || id > TAG_SIZE_MAX_ID) return default_size;
+
+  int s = find_slot(ts, (uint32_t)family << 24 | (uint32_t)id);
+  if (ts->keys[s] != EMPTY_KEY) return ts->sizes[s];
+
+  s = find_slot(ts, (uint32_t)TAG_SIZE_ANY_FAMILY << 24 | (uint32_t)id);
+  if (ts->keys[s] != EMPTY_KEY) return ts->sizes[s];
+
+  return default_size;
+}
+
+/** @copydoc tag_size_copy */
+int tag_size_copy ( t_tag_size_table *dest, const t_tag_size_table *src ) {
+  if (dest->nslots != src->nslots) {
+    tag_size_destroy(dest);
+    if (src->nslots == 0) return 0;
+    if (alloc_slots(dest, src->nslots) != 0) return -1;
+  }
+  if (src->nslots > 0) {
+    memcpy(dest->keys, src->keys, src->nslots * sizeof(uint32_t));
+    memcpy(dest->sizes, src->sizes, src->nslots * sizeof(double));
+  }
+  dest->len = src->len;
+  return 0;
+}
+
+/** @copydoc tag_size_destroy */
+void tag_size_destroy ( t_tag_size_table *ts ) {
+  free(ts->keys);
+  free(ts->sizes);
+  *ts = (t_tag_size_table) TAG_SIZE_TABLE_INITIALIZER;
+}
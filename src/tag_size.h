@@ -0,0 +1,80 @@
+/** @file tag_size.h
+*  @brief Definitions for a table of tag sizes, keyed by tag family and id
+*
+*  Open addressing hash table; holds only the sizes that were set, so large id spaces (e.g. tagStandard41h12) and
+*  several families cost memory in proportion to the tags actually sized
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _TAG_SIZE_H_
+#define _TAG_SIZE_H_
+
+#include <stdint.h>
+
+// family of the sizes that apply to a tag id in any family (used when a size was not set for the family of the tag)
+#define TAG_SIZE_ANY_FAMILY 0xfe
+
+// largest tag id
+#define TAG_SIZE_MAX_ID 0xffffff
+
+// slots of a table when the first size is set (the table doubles when 3/4 full)
+#define TAG_SIZE_MIN_SLOTS 16
+
+#define TAG_SIZE_TABLE_INITIALIZER { .keys = NULL, .sizes = NULL, .nslots = 0, .len = 0 }
+
+/**
+ * @typedef t_tag_size_table
+ * @brief Table state
+ */
+typedef struct {
+  uint32_t *keys;  // family << 24 | id of each slot (UINT32_MAX if the slot is empty)
+  double *sizes;   // size of each slot
+  int nslots;      // number of slots (power of two)
+  int len;         // sizes in the table
+} t_tag_size_table;
+
+/**
+ * @brief Set the size of a tag
+ *
+ * @param ts the table
+ * @param family tag family (0 .. TAG_SIZE_ANY_FAMILY)
+ * @param id tag id (0 .. TAG_SIZE_MAX_ID)
+ * @param size tag size
+ *
+ * @return 0=success; -1 if family or id are out of range, or on allocation failure
+ */
+int tag_size_set ( t_tag_size_table *ts, int family, int id, double size );
+
+/**
+ * @brief Get the size of a tag: the size set for its family and id; or else the size set for its id in any family; or
+ *        else the default size
+ *
+ * @param ts the table
+ * @param family tag family
+ * @param id tag id
+ * @param default_size size of tags not in the table
+ *
+ * @return the size
+ */
+double tag_size_get ( const t_tag_size_table *ts, int family, int id, double default_size );
+
+/**
+ * @brief Make a table a copy of another; memory of the destination is reused when it has the same number of slots
+ *
+ * @param dest destination table
+ * @param src source table
+ *
+ * @return 0=success; -1 on allocation failure (dest is left empty)
+ */
+int tag_size_copy ( t_tag_size_table *dest, const t_tag_size_table *src );
+
+/**
+ * @brief Free the memory of a table; the table is left empty
+ *
+ * @param ts the table
+ */
+void tag_size_destroy ( t_tag_size_table *ts );
+
+#endif
@@ -0,0 +1,160 @@
+/** @file tag_track.c
+ *  @brief Tag tracking across frames
+ *  @see documentation in tag_track.h
+ *
+ *  Copyright (C) Wiselab CMU.
+ *  @date Oct, 2026
+ */
+#include <string.h>
+#include <math.h>
+#include "tag_track.h"
+
+/**
+ * @brief Find the track of a tag
+ *
+ * @return index of the track; -1 if the tag is not tracked
+ */
+static int find_track ( const t_tag_track *tt, const apriltag_family_t *family, int id ) {
+  for (int i = 0; i < tt->ntracks; i++)
+    if (tt->tracks[i].id == id && tt->tracks[i].family == family) return i;
+  return -1;
+}
+
+/** @copydoc tag_track_reset */
+void tag_track_reset ( t_tag_track *tt, int keyframe_interval, double roi_padding ) {
+  tt->keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1;
+  tt->roi_padding = roi_padding;
+  tt->frame = 0;
+  tt->last_full_frame = 0;
+  tt->lost = 0;
+  tt->ntracks = 0;
+}
+
+/** @copydoc tag_track_begin_frame */
+int tag_track_begin_frame ( t_tag_track *tt ) {
+  tt->frame++;
+  if (tt->ntracks == 0 || tt->lost) return 1;
+  if (tt->frame - tt->last_full_frame >= tt->keyframe_interval) return 1;
+  return 0;
+}
+
+/** @copydoc tag_track_rois */
+int tag_track_rois ( const t_tag_track *tt, int width, int height, t_tag_roi *rois ) {
+  int n = 0;
+
+  for (int i = 0; i < tt->ntracks; i++) {
+    const t_tag_track_entry *t = &tt->tracks[i];
+    int dframes = tt->frame - t->last_frame;
+    double xmin = HUGE_VAL, ymin = HUGE_VAL, xmax = -HUGE_VAL, ymax = -HUGE_VAL, vmax = 0;
+    for (int j = 0; j < 4; j++) {
+      // predicted corner
+      double x = t->p[j][0] + t->v[j][0] * dframes;
+      double y = t->p[j][1] + t->v[j][1] * dframes;
+      if (x < xmin) xmin = x;
+      if (x > xmax) xmax = x;
+      if (y < ymin) ymin = y;
+      if (y > ymax) ymax = y;
+      double v = fabs(t->v[j][0]) + fabs(t->v[j][1]);
+      if (v > vmax) vmax = v;
+    }
+
+    // pad by a fraction of the tag size, plus the motion we might have mispredicted
+    double size = fmax(xmax - xmin, ymax - ymin);
+    double pad = fmax(size * tt->roi_padding, TAG_TRACK_MIN_PAD) + vmax * dframes;
+
+    t_tag_roi r = {
+      .x0 = (int)floor(xmin - pad), .y0 = (int)floor(ymin - pad),
+      .x1 = (int)ceil(xmax + pad), .y1 = (int)ceil(ymax + pad) };
+    if (r.x0 < 0) r.x0 = 0;
+    if (r.y0 < 0) r.y0 = 0;
+    if (r.x1 > width) r.x1 = width;
+    if (r.y1 > height) r.y1 = height;
+    if (r.x1 <= r.x0 || r.y1 <= r.y0) continue; // predicted out of the image
+
+    rois[n++] = r;
+  }
+
+  return tag_track_merge_rois(rois, n);
+}
+
+/** @copydoc tag_track_merge_rois */
+int tag_track_merge_rois ( t_tag_roi *rois, int n ) {
+  int merged = 1;
+  while (merged) {
+    merged = 0;
+    for (int i = 0; i < n && !merged; i++) {
+      for (int j = i + 1; j < n; j++) {
+        if (rois[i].x0 < rois[j].x1 && rois[j].x0 < rois[i].x1 && rois[i].y0 < rois[j].y1 && rois[j].y0 < rois[i].y1) {
+          if (rois[j].x0 < rois[i].x0) rois[i].x0 = rois[j].x0;
+          if (rois[j].y0 < rois[i].y0) rois[i].y0 = rois[j].y0;
+          if (rois[j].x1 > rois[i].x1) rois[i].x1 = rois[j].x1;
+          if (rois[j].y1 > rois[i].y1) rois[i].y1 = rois[j].y1;
+          rois[j] = rois[--n];
+          merged = 1;
+          break;
+        }
+      }
+    }
+  }
+
+  return n;
+}
+
+/** @copydoc tag_track_all_found */
+int tag_track_all_found ( const t_tag_track *tt, const zarray_t *detections ) {
+  for (int i = 0; i < tt->ntracks; i++) {
+    int found = 0;
+    for (int j = 0; j < zarray_size(detections) && !found; j++) {
+      apriltag_detection_t *det;
+      zarray_get(detections, j, &det);
+      found = (det->id == tt->tracks[i].id && det->family == tt->tracks[i].family);
+    }
+    if (!found) return 0;
+  }
+  return 1;
+}
+
+/** @copydoc tag_track_update */
+void tag_track_update ( t_tag_track *tt, const zarray_t *detections, int full_frame ) {
+  int seen[TAG_TRACK_MAX] = { 0 };
+
+  for (int i = 0; i < zarray_size(detections); i++) {
+    apriltag_detection_t *det;
+    zarray_get(detections, i, &det);
+
+    int k = find_track(tt, det->family, det->id);
+    if (k < 0) {
+      if (tt->ntracks >= TAG_TRACK_MAX) continue;
+      k = tt->ntracks++;
+      t_tag_track_entry *t = &tt->tracks[k];
+      t->family = det->family;
+      t->id = det->id;
+      memcpy(t->p, det->p, sizeof(t->p));
+      memset(t->v, 0, sizeof(t->v));
+    } else {
+      t_tag_track_entry *t = &tt->tracks[k];
+      int dframes = tt->frame - t->last_frame;
+      if (dframes < 1) dframes = 1;
+      for (int j = 0; j < 4; j++) {
+        t->v[j][0] = (det->p[j][0] - t->p[j][0]) / dframes;
+        t->v[j][1] = (det->p[j][1] - t->p[j][1]) / dframes;
+      }
+      memcpy(t->p, det->p, sizeof(t->p));
+    }
+    tt->tracks[k].last_frame = tt->frame;
+    seen[k] = 1;
+  }
+
+  if (full_frame) {
+    // drop tags not seen in a full-frame scan
+    int n = 0;
+    for (int i = 0; i < tt->ntracks; i++)
+      if (seen[i]) tt->tracks[n++] = tt->tracks[i];
+    tt->ntracks = n;
+    tt->last_full_frame = tt->frame;
+    tt->lost = 0;
+  } else {
+    for (int i = 0; i < tt->ntracks; i++)
+      if (!seen[i]) tt->lost = 1;
+  }
+}
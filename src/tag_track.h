@@ -0,0 +1,120 @@
+/** @file tag_track.h
+*  @brief Definitions for tag tracking across frames
+*
+*  Keeps the last detections of each tag and predicts where the tags will be in the next frame, so the detector can
+*  search regions of interest (ROIs) around the predicted corners instead of the full frame
+*
+* Copyright (C) Wiselab CMU.
+* @date Oct, 2026
+*/
+
+#ifndef _TAG_TRACK_H_
+#define _TAG_TRACK_H_
+
+#include "apriltag.h"
+
+// maximum number of tags tracked
+#define TAG_TRACK_MAX 32
+
+// minimum padding around the predicted corners, in pixels
+#define TAG_TRACK_MIN_PAD 16
+
+#define TAG_TRACK_INITIALIZER { .keyframe_interval = 10, .roi_padding = 0.5, .frame = 0, .last_full_frame = 0, .lost = 0, .ntracks = 0 }
+
+/**
+ * @typedef t_tag_track_entry
+ * @brief A tracked tag
+ */
+typedef struct {
+  const apriltag_family_t *family;  // tag family
+  int id;                           // tag id
+  double p[4][2];                   // corners at the last detection
+  double v[4][2];                   // corners velocity, in pixels per frame
+  int last_frame;                   // frame of the last detection
+} t_tag_track_entry;
+
+/**
+ * @typedef t_tag_track
+ * @brief Tracker state
+ */
+typedef struct {
+  int keyframe_interval;   // do a full-frame scan at least every keyframe_interval frames
+  double roi_padding;      // padding around the predicted corners, as a fraction of the tag size
+  int frame;               // current frame
+  int last_full_frame;     // frame of the last full-frame scan
+  int lost;                // a tracked tag was lost; next frame is a full-frame scan
+  int ntracks;             // number of tracked tags
+  t_tag_track_entry tracks[TAG_TRACK_MAX];
+} t_tag_track;
+
+/**
+ * @typedef t_tag_roi
+ * @brief A region of interest; pixels x0 <= x < x1 and y0 <= y < y1
+ */
+typedef struct {
+  int x0, y0, x1, y1;
+} t_tag_roi;
+
+/**
+ * @brief Reset the tracker and set its parameters
+ *
+ * @param tt the tracker
+ * @param keyframe_interval do a full-frame scan at least every keyframe_interval frames
+ * @param roi_padding padding around the predicted corners, as a fraction of the tag size
+ */
+void tag_track_reset ( t_tag_track *tt, int keyframe_interval, double roi_padding );
+
+/**
+ * @brief Start a new frame
+ *
+ * @param tt the tracker
+ *
+ * @return 1 if this frame must be a full-frame scan (keyframe, nothing tracked or a tag was lost); 0 if ROIs can be used
+ */
+int tag_track_begin_frame ( t_tag_track *tt );
+
+/**
+ * @brief Regions of interest around the predicted corners of the tracked tags in the current frame; overlapping regions are merged
+ *
+ * @param tt the tracker
+ * @param width width of the image
+ * @param height height of the image
+ * @param rois where to write the regions (must hold TAG_TRACK_MAX regions)
+ *
+ * @return number of regions
+ */
+int tag_track_rois ( const t_tag_track *tt, int width, int height, t_tag_roi *rois );
+
+/**
+ * @brief Merge overlapping regions in place, so a tag is never split between two regions
+ *
+ * @param rois the regions
+ * @param n number of regions
+ *
+ * @return number of regions after merging
+ */
+int tag_track_merge_rois ( t_tag_roi *rois, int n );
+
+/**
+ * @brief Check if all tracked tags are in the detections of the current frame
+ *
+ * @param tt the tracker
+ * @param detections detections (apriltag_detection_t*) of the current frame
+ *
+ * @return 1 if all tracked tags were found; 0 otherwise
+ */
+int tag_track_all_found ( const t_tag_track *tt, const zarray_t *detections );
+
+/**
+ * @brief Update the tracks with the detections of the current frame
+ *
+ * Tags detected are added/updated; on a full-frame scan, tags not detected are dropped; otherwise they are marked lost
+ * so the next frame is a full-frame scan
+ *
+ * @param tt the tracker
+ * @param detections detections (apriltag_detection_t*) of the current frame
+ * @param full_frame if the detections come from a full-frame scan
+ */
+void tag_track_update ( t_tag_track *tt, const zarray_t *detections, int full_frame );
+
+#endif
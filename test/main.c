@@ -5,6 +5,16 @@
 #include <cmocka.h>
 
 #include "test_str_json.h"
+#include "test_frame_arena.h"
+#include "test_frame_stream.h"
+#include "test_tag_size.h"
+#include "test_decimate_ctl.h"
+#include "test_quad_rank.h"
+#include "test_tag_pose.h"
+#include "test_tag_decode_table.h"
+#include "test_regression.h"
+#include "test_heap_stats.h"
+#include "test_motion_gate.h"
 
 int main(void) {
 
@@ -15,14 +25,107 @@ int main(void) {
         cmocka_unit_test(when_called_str_json_destroy_destroys),
         cmocka_unit_test(when_called_str_clear_returns_an_empty_string),
         cmocka_unit_test(when_given_empty_inputs_str_json_concat_returns_a_valid_result),
-        cmocka_unit_test(when_given_too_large_inputs_str_json_concat_returns_a_valid_result),
+        cmocka_unit_test(when_given_too_large_inputs_str_json_concat_grows_the_string),
         cmocka_unit_test(when_concat_called_in_sequence_return_a_valid_result),
         cmocka_unit_test(when_clear_and_concat_called_in_sequence_return_a_valid_result),
         cmocka_unit_test(when_destroy_and_concat_called_in_sequence_return_a_valid_result),
         cmocka_unit_test(when_str_json_printf_called_returns_a_well_formatted_result),
-        cmocka_unit_test(when_given_too_large_inputs_str_json_printf_returns_a_well_formatted_result)
+        cmocka_unit_test(when_given_too_large_inputs_str_json_printf_grows_the_string),
+        cmocka_unit_test(when_str_json_reserve_called_appends_do_not_allocate),
+        cmocka_unit_test(when_str_json_int_called_returns_a_well_formatted_result),
+        cmocka_unit_test(when_str_json_fixed_called_returns_the_shortest_result),
+        cmocka_unit_test(when_str_json_double_called_returns_the_shortest_round_trip),
+        cmocka_unit_test(when_str_json_double_called_the_result_reads_back_as_the_same_double),
+        cmocka_unit_test(when_building_a_long_string_str_json_concat_grows_the_allocation_geometrically),
+        cmocka_unit_test(when_compared_to_snprintf_str_json_fixed_returns_the_same_value)
+    };
+
+    const struct CMUnitTest frame_arena_tests[] = {
+        cmocka_unit_test(when_called_frame_arena_alloc_returns_aligned_memory),
+        cmocka_unit_test(when_chunk_is_full_frame_arena_alloc_grows_and_keeps_earlier_allocations),
+        cmocka_unit_test(when_frames_repeat_frame_arena_does_not_allocate),
+        cmocka_unit_test(when_called_frame_arena_destroy_releases_the_arena),
+        cmocka_unit_test(when_detecting_the_same_frame_again_only_the_detector_allocates)
+    };
+
+    const struct CMUnitTest frame_stream_tests[] = {
+        cmocka_unit_test(when_reading_a_y4m_stream_frame_stream_returns_the_luma_of_each_frame),
+        cmocka_unit_test(when_reading_a_gray_stream_frame_stream_returns_each_frame),
+        cmocka_unit_test(when_given_an_invalid_stream_frame_stream_open_returns_error),
+        cmocka_unit_test(when_detection_falls_behind_frame_stream_drops_the_oldest_frames),
+        cmocka_unit_test(when_detection_falls_behind_frame_stream_waits_without_dropping)
+    };
+
+    const struct CMUnitTest tag_size_tests[] = {
+        cmocka_unit_test(when_size_was_set_tag_size_get_returns_it),
+        cmocka_unit_test(when_size_was_not_set_for_the_family_tag_size_get_returns_the_any_family_size),
+        cmocka_unit_test(when_size_was_not_set_tag_size_get_returns_the_default),
+        cmocka_unit_test(when_given_out_of_range_keys_tag_size_set_returns_error),
+        cmocka_unit_test(when_many_sizes_are_set_tag_size_table_grows_and_keeps_them),
+        cmocka_unit_test(when_called_tag_size_copy_copies_the_table)
+    };
+
+    const struct CMUnitTest decimate_ctl_tests[] = {
+        cmocka_unit_test(when_started_decimate_ctl_snaps_to_a_supported_decimation_in_range),
+        cmocka_unit_test(when_over_budget_decimate_ctl_raises_decimation_one_step_at_a_time),
+        cmocka_unit_test(when_under_budget_decimate_ctl_lowers_decimation_if_predicted_to_fit),
+        cmocka_unit_test(when_a_few_frames_are_slow_decimate_ctl_keeps_the_settings),
+        cmocka_unit_test(when_tags_are_small_decimate_ctl_turns_refine_edges_off_instead),
+        cmocka_unit_test(when_refine_edges_option_is_off_decimate_ctl_never_turns_it_on)
+    };
+
+    const struct CMUnitTest quad_rank_tests[] = {
+        cmocka_unit_test(when_quads_differ_in_contrast_quad_rank_score_ranks_the_sharper_first),
+        cmocka_unit_test(when_quads_differ_in_size_quad_rank_score_ranks_the_larger_first),
+        cmocka_unit_test(when_border_is_reversed_quad_rank_score_is_the_same),
+        cmocka_unit_test(when_quad_is_degenerate_or_flat_quad_rank_score_is_zero),
+        cmocka_unit_test(when_called_quad_rank_sort_orders_by_score_and_keeps_ties_in_order)
+    };
+
+    const struct CMUnitTest tag_pose_tests[] = {
+        cmocka_unit_test(when_starting_cold_tag_pose_estimate_runs_to_convergence),
+        cmocka_unit_test(when_tag_was_not_seen_in_the_last_frame_tag_pose_estimate_starts_cold)
+    };
+
+    const struct CMUnitTest tag_decode_table_tests[] = {
+        cmocka_unit_test(when_attached_tag_decode_table_decodes_every_code_and_the_codes_one_bit_away),
+        cmocka_unit_test(when_attached_again_tag_decode_table_shares_the_table),
+        cmocka_unit_test(when_no_table_was_generated_tag_decode_table_attach_returns_error)
+    };
+
+    const struct CMUnitTest heap_stats_tests[] = {
+        cmocka_unit_test(when_memory_is_allocated_heap_stats_sample_reports_it),
+        cmocka_unit_test(when_block_fits_heap_stats_probe_succeeds),
+        cmocka_unit_test(when_block_cannot_be_allocated_heap_stats_probe_returns_error),
+        cmocka_unit_test(when_the_heap_cannot_hold_a_frame_of_the_budget_detect_refuses_it),
+        cmocka_unit_test(when_a_buffer_is_allocated_between_frames_heap_used_and_heap_peak_rise)
+    };
+
+    const struct CMUnitTest motion_gate_tests[] = {
+        cmocka_unit_test(when_frame_is_unchanged_motion_gate_check_reuses_it),
+        cmocka_unit_test(when_a_small_region_changes_motion_gate_check_detects_it),
+        cmocka_unit_test(when_refresh_interval_is_reached_motion_gate_check_forces_a_detection),
+        cmocka_unit_test(when_size_changes_or_reference_is_invalidated_motion_gate_check_does_not_reuse),
+        cmocka_unit_test(when_frame_is_rgba_motion_gate_check_compares_luma)
+    };
+
+    const struct CMUnitTest regression_tests[] = {
+        cmocka_unit_test(when_detecting_rendered_tags_ids_and_corners_match_where_they_were_drawn),
+        cmocka_unit_test(when_detecting_the_test_images_ids_and_corners_match_the_golden_outputs),
+        cmocka_unit_test(when_detecting_the_test_images_latency_and_peak_heap_do_not_regress)
     };
 
     /* Run the tests */
-    return cmocka_run_group_tests(str_json_tests, NULL, NULL);
+    int failed = cmocka_run_group_tests(str_json_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(frame_arena_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(frame_stream_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(tag_size_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(decimate_ctl_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(quad_rank_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(tag_pose_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(tag_decode_table_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(heap_stats_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(motion_gate_tests, NULL, NULL);
+    failed += cmocka_run_group_tests(regression_tests, regression_setup, regression_teardown);
+    return failed;
 }
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "decimate_ctl.h"
+
+#define TARGET_US 20000.0
+
+/**
+ * Controller with a 20 ms budget, starting at the given decimation (edge refinement on)
+ */
+static t_decimate_ctl ctl(double min_decimate, double max_decimate, int adapt_refine, double decimate)
+{
+    t_decimate_ctl dc = DECIMATE_CTL_INITIALIZER;
+    decimate_ctl_reset(&dc, TARGET_US, min_decimate, max_decimate, adapt_refine);
+    decimate_ctl_start(&dc, decimate, 1);
+    return dc;
+}
+
+/**
+ * Feed frames of the same time until the settings change (or max frames); returns the frames fed
+ */
+static int run_frames(t_decimate_ctl *dc, double frame_us, double min_tag_px, int max)
+{
+    for (int i = 1; i <= max; i++) {
+        if (decimate_ctl_update(dc, frame_us, min_tag_px)) return i;
+    }
+    return max;
+}
+
+void when_started_decimate_ctl_snaps_to_a_supported_decimation_in_range()
+{
+    t_decimate_ctl dc = ctl(1.0, 4.0, 0, 2.5);
+    assert_true(dc.decimate == 2.0);  // the detector truncates 2.5 to 2
+
+    dc = ctl(1.0, 4.0, 0, 1.5);
+    assert_true(dc.decimate == 1.5);
+
+    dc = ctl(2.0, 4.0, 0, 1.0);
+    assert_true(dc.decimate == 2.0);
+
+    dc = ctl(1.0, 3.0, 0, 8.0);
+    assert_true(dc.decimate == 3.0);
+
+    // invalid range is made valid
+    dc = ctl(0.0, 0.5, 0, 2.0);
+    assert_true(dc.min_decimate == 1.0);
+    assert_true(dc.decimate == 1.0);
+}
+
+void when_over_budget_decimate_ctl_raises_decimation_one_step_at_a_time()
+{
+    t_decimate_ctl dc = ctl(1.0, 4.0, 0, 1.0);
+
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, 0, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 1.5);
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, 0, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 2.0);
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, 0, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 3.0);
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, 0, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 4.0);
+
+    // at the largest decimation; nothing else to change
+    assert_int_equal(decimate_ctl_update(&dc, 2 * TARGET_US, 0), 0);
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, 0, 10), 10);
+    assert_true(dc.decimate == 4.0);
+    assert_int_equal(dc.refine_edges, 1);
+}
+
+void when_under_budget_decimate_ctl_lowers_decimation_if_predicted_to_fit()
+{
+    t_decimate_ctl dc = ctl(1.0, 4.0, 0, 4.0);
+
+    // 4 -> 3 predicts (4/3)^2 * 10 ms = 17.8 ms: over the headroom; stays
+    assert_int_equal(run_frames(&dc, 0.5 * TARGET_US, 0, 10), 10);
+    assert_true(dc.decimate == 4.0);
+
+    // 4 -> 3 predicts (4/3)^2 * 5 ms = 8.9 ms: fits (as soon as the smoothed time is low enough)
+    assert_true(run_frames(&dc, 0.25 * TARGET_US, 0, 10) < 10);
+    assert_true(dc.decimate == 3.0);
+
+    // all the way down to the smallest decimation
+    run_frames(&dc, 0.01 * TARGET_US, 0, 10);
+    run_frames(&dc, 0.01 * TARGET_US, 0, 10);
+    run_frames(&dc, 0.01 * TARGET_US, 0, 10);
+    assert_true(dc.decimate == 1.0);
+    assert_int_equal(run_frames(&dc, 0.01 * TARGET_US, 0, 10), 10);
+}
+
+void when_a_few_frames_are_slow_decimate_ctl_keeps_the_settings()
+{
+    t_decimate_ctl dc = ctl(1.0, 4.0, 0, 2.0);
+
+    // frames at 90% of the budget, with a few 3x over budget; the median time stays within budget
+    for (int i = 0; i < 20; i++) {
+        assert_int_equal(decimate_ctl_update(&dc, (i == 10 || i == 12) ? 3 * TARGET_US : 0.9 * TARGET_US, 0), 0);
+    }
+    assert_true(dc.decimate == 2.0);
+}
+
+void when_tags_are_small_decimate_ctl_turns_refine_edges_off_instead()
+{
+    // the smallest tag is 40 pixels: 20 at decimation 2, 13.3 at 3, 10 at 4
+    double tag_px = 40;
+    t_decimate_ctl dc = ctl(1.0, 8.0, 1, 2.0);
+
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, tag_px, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 3.0);
+    assert_int_equal(dc.refine_edges, 1);
+
+    // decimation 4 would lose the tag
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, tag_px, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 3.0);
+    assert_int_equal(dc.refine_edges, 0);
+
+    // nothing left to change
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, tag_px, 10), 10);
+    assert_true(dc.decimate == 3.0);
+
+    // with time to spare, edge refinement comes back first
+    assert_true(run_frames(&dc, 0.5 * TARGET_US, tag_px, 10) < 10);
+    assert_true(dc.decimate == 3.0);
+    assert_int_equal(dc.refine_edges, 1);
+
+    // without adapt_refine, edge refinement is left on
+    dc = ctl(1.0, 8.0, 0, 3.0);
+    assert_int_equal(run_frames(&dc, 2 * TARGET_US, tag_px, 10), 10);
+    assert_true(dc.decimate == 3.0);
+    assert_int_equal(dc.refine_edges, 1);
+}
+
+void when_refine_edges_option_is_off_decimate_ctl_never_turns_it_on()
+{
+    t_decimate_ctl dc = DECIMATE_CTL_INITIALIZER;
+    decimate_ctl_reset(&dc, TARGET_US, 1.0, 4.0, 1);
+    decimate_ctl_start(&dc, 2.0, 0);
+
+    assert_int_equal(run_frames(&dc, 0.25 * TARGET_US, 0, 10), DECIMATE_CTL_WINDOW);
+    assert_true(dc.decimate == 1.5);
+    assert_int_equal(dc.refine_edges, 0);
+}
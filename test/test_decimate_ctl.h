@@ -0,0 +1,10 @@
+#ifndef TEST_DECIMATE_CTL_H
+#define TEST_DECIMATE_CTL_H
+
+void when_started_decimate_ctl_snaps_to_a_supported_decimation_in_range();
+void when_over_budget_decimate_ctl_raises_decimation_one_step_at_a_time();
+void when_under_budget_decimate_ctl_lowers_decimation_if_predicted_to_fit();
+void when_a_few_frames_are_slow_decimate_ctl_keeps_the_settings();
+void when_tags_are_small_decimate_ctl_turns_refine_edges_off_instead();
+void when_refine_edges_option_is_off_decimate_ctl_never_turns_it_on();
+#endif
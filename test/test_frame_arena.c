@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "frame_arena.h"
+#include "apriltag_js.h"
+#include "test_regression.h"
+#include "common/pjpeg.h"
+
+// image with one tag, relative to where the tests run (make tests)
+#define TEST_TAG_IMAGE "test/tag-imgs/single_tag_0_1.jpg"
+
+void when_called_frame_arena_alloc_returns_aligned_memory()
+{
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+
+    for (size_t size = 1; size < 100; size += 7) {
+        void *p = frame_arena_alloc(&fa, size);
+        assert_non_null(p);
+        assert_int_equal((uintptr_t)p % FRAME_ARENA_ALIGN, 0);
+    }
+    assert_int_equal(fa.nallocs, 1);
+
+    frame_arena_destroy(&fa);
+}
+
+void when_chunk_is_full_frame_arena_alloc_grows_and_keeps_earlier_allocations()
+{
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+
+    char *a = frame_arena_alloc(&fa, 1000);
+    memset(a, 'a', 1000);
+    char *b = frame_arena_alloc(&fa, 4 * FRAME_ARENA_MIN_CHUNK);
+    assert_non_null(b);
+    memset(b, 'b', 4 * FRAME_ARENA_MIN_CHUNK);
+    assert_int_equal(fa.nallocs, 2);
+
+    // memory allocated before the arena grew is still valid
+    for (int i = 0; i < 1000; i++) assert_int_equal(a[i], 'a');
+
+    frame_arena_destroy(&fa);
+}
+
+void when_frames_repeat_frame_arena_does_not_allocate()
+{
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+
+    int nallocs[5];
+    for (int frame = 0; frame < 5; frame++) {
+        frame_arena_reset(&fa);
+        for (int i = 0; i < 200; i++) assert_non_null(frame_arena_alloc(&fa, 24 + i % 5 * 40));
+        nallocs[frame] = fa.nallocs;
+    }
+    assert_true(nallocs[0] > 1);
+    assert_int_equal(nallocs[3], 0);
+    assert_int_equal(nallocs[4], 0);
+
+    frame_arena_destroy(&fa);
+}
+
+void when_called_frame_arena_destroy_releases_the_arena()
+{
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+
+    frame_arena_alloc(&fa, 100);
+    frame_arena_destroy(&fa);
+    assert_null(fa.chunk);
+    assert_int_equal(fa.nallocs, 0);
+
+    // can be used again
+    assert_non_null(frame_arena_alloc(&fa, 100));
+    frame_arena_destroy(&fa);
+}
+
+void when_detecting_the_same_frame_again_only_the_detector_allocates()
+{
+    int err = 0;
+    pjpeg_t *pjpeg = pjpeg_create_from_file(TEST_TAG_IMAGE, 0, &err);
+    assert_non_null(pjpeg);
+    image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+    pjpeg_destroy(pjpeg);
+
+    atagjs_ctx_t *ctx = atagjs_ctx_create();
+    assert_non_null(ctx);
+    atagjs_ctx_set_detector_options(ctx, 2.0, 0.0, 1, 1, 0, ATAGJS_POSE_FULL, 1);
+    uint8_t *buf = atagjs_ctx_set_img_buffer(ctx, im->width, im->height, im->width);
+    assert_non_null(buf);
+    for (int y = 0; y < im->height; y++) memcpy(buf + y * im->width, im->buf + y * im->stride, im->width);
+
+    // heap allocations of each call, counted by the allocator wrappers of the test runner (test_regression.c)
+    long long nallocs[3];
+    for (int frame = 0; frame < 3; frame++) {
+        long long before = regression_heap_nallocs();
+        assert_non_null(atagjs_ctx_detect(ctx));
+        nallocs[frame] = regression_heap_nallocs() - before;
+        const t_atagjs_frame_stats *stats = atagjs_ctx_get_frame_stats(ctx);
+        assert_int_equal(stats->ndetections, 1);
+        if (frame > 0) assert_int_equal(stats->nallocs, 0); // the context buffers do not grow
+    }
+    assert_true(nallocs[2] == nallocs[1]);
+
+    // the apriltag detector allocates its intermediates and detections on each frame; pose estimation (warm started),
+    // the records and the json output do not: the frame allocates as many times without them
+    atagjs_ctx_set_detector_options(ctx, 2.0, 0.0, 1, 1, 0, ATAGJS_POSE_NONE, 0);
+    assert_non_null(atagjs_ctx_detect(ctx));
+    long long before = regression_heap_nallocs();
+    assert_non_null(atagjs_ctx_detect(ctx));
+    assert_true(regression_heap_nallocs() - before == nallocs[2]);
+
+    atagjs_ctx_destroy(ctx);
+    image_u8_destroy(im);
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_FRAME_ARENA_H
+#define TEST_FRAME_ARENA_H
+
+void when_called_frame_arena_alloc_returns_aligned_memory();
+void when_chunk_is_full_frame_arena_alloc_grows_and_keeps_earlier_allocations();
+void when_frames_repeat_frame_arena_does_not_allocate();
+void when_called_frame_arena_destroy_releases_the_arena();
+void when_detecting_the_same_frame_again_only_the_detector_allocates();
+#endif
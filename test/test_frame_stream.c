@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "frame_stream.h"
+
+/**
+ * Write a stream of nframes frames to a temporary file; the pixels of frame i are all i
+ * header: Y4M stream header (e.g. "YUV4MPEG2 W5 H3 C420jpeg"); NULL for a raw grayscale stream
+ * chroma: bytes after the luma plane of each frame (Y4M)
+ */
+static FILE *write_stream(const char *header, int width, int height, size_t chroma, int nframes)
+{
+    FILE *f = tmpfile();
+    assert_non_null(f);
+    if (header != NULL) fprintf(f, "%s\n", header);
+    for (int i = 0; i < nframes; i++) {
+        if (header != NULL) fprintf(f, "FRAME\n");
+        for (int p = 0; p < width * height; p++) fputc(i, f);
+        for (size_t p = 0; p < chroma; p++) fputc(128, f);
+    }
+    rewind(f);
+    return f;
+}
+
+static void assert_frame(const t_stream_frame *frame, int width, int height, int number)
+{
+    assert_non_null(frame);
+    assert_int_equal(frame->number, number);
+    assert_true(frame->read_us > 0);
+    for (int p = 0; p < width * height; p++) assert_int_equal(frame->buf[p], number);
+}
+
+void when_reading_a_y4m_stream_frame_stream_returns_the_luma_of_each_frame()
+{
+    // odd size: chroma planes are 3x2
+    FILE *f = write_stream("YUV4MPEG2 W5 H3 F30:1 Ip A1:1 C420jpeg XYSCSS=420JPEG", 5, 3, 2 * 3 * 2, 3);
+    t_frame_stream *fs = frame_stream_open(f, FRAME_STREAM_Y4M, 0, 0, 4, FRAME_STREAM_BLOCK);
+    assert_non_null(fs);
+    assert_int_equal(frame_stream_width(fs), 5);
+    assert_int_equal(frame_stream_height(fs), 3);
+
+    for (int i = 0; i < 3; i++) assert_frame(frame_stream_next(fs), 5, 3, i);
+    assert_null(frame_stream_next(fs));
+    assert_int_equal(frame_stream_dropped(fs), 0);
+
+    frame_stream_close(fs);
+    fclose(f);
+
+    // mono frames have no chroma planes
+    f = write_stream("YUV4MPEG2 W4 H2 Cmono", 4, 2, 0, 2);
+    fs = frame_stream_open(f, FRAME_STREAM_Y4M, 0, 0, 2, FRAME_STREAM_BLOCK);
+    assert_non_null(fs);
+    for (int i = 0; i < 2; i++) assert_frame(frame_stream_next(fs), 4, 2, i);
+    assert_null(frame_stream_next(fs));
+    frame_stream_close(fs);
+    fclose(f);
+}
+
+void when_reading_a_gray_stream_frame_stream_returns_each_frame()
+{
+    FILE *f = write_stream(NULL, 8, 6, 0, 5);
+    t_frame_stream *fs = frame_stream_open(f, FRAME_STREAM_GRAY, 8, 6, 3, FRAME_STREAM_BLOCK);
+    assert_non_null(fs);
+
+    for (int i = 0; i < 5; i++) assert_frame(frame_stream_next(fs), 8, 6, i);
+    assert_null(frame_stream_next(fs));
+
+    frame_stream_close(fs);
+    fclose(f);
+}
+
+void when_given_an_invalid_stream_frame_stream_open_returns_error()
+{
+    const char *headers[] = {
+        "YUV4MPEG W5 H3",            // not a Y4M header
+        "YUV4MPEG2 W5 C420jpeg",     // no height
+        "YUV4MPEG2 W5 H3 C420p10"    // not 8-bit
+    };
+    for (size_t i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+        FILE *f = write_stream(headers[i], 5, 3, 0, 1);
+        assert_null(frame_stream_open(f, FRAME_STREAM_Y4M, 0, 0, 4, FRAME_STREAM_BLOCK));
+        fclose(f);
+    }
+
+    // gray streams need the frame size, and there must be room for a frame being read and one held
+    FILE *f = write_stream(NULL, 8, 6, 0, 1);
+    assert_null(frame_stream_open(f, FRAME_STREAM_GRAY, 0, 6, 4, FRAME_STREAM_BLOCK));
+    assert_null(frame_stream_open(f, FRAME_STREAM_GRAY, 8, 6, FRAME_STREAM_MIN_BUFFERS - 1, FRAME_STREAM_BLOCK));
+    fclose(f);
+}
+
+void when_detection_falls_behind_frame_stream_drops_the_oldest_frames()
+{
+    FILE *f = write_stream(NULL, 8, 6, 0, 10);
+    t_frame_stream *fs = frame_stream_open(f, FRAME_STREAM_GRAY, 8, 6, 3, FRAME_STREAM_DROP_OLDEST);
+    assert_non_null(fs);
+
+    // do not consume until the reader is done: the 3 buffers keep the 3 newest frames
+    for (int wait = 0; wait < 500 && frame_stream_dropped(fs) < 7; wait++) usleep(10000);
+    assert_int_equal(frame_stream_dropped(fs), 7);
+
+    for (int i = 7; i < 10; i++) assert_frame(frame_stream_next(fs), 8, 6, i);
+    assert_null(frame_stream_next(fs));
+
+    frame_stream_close(fs);
+    fclose(f);
+}
+
+void when_detection_falls_behind_frame_stream_waits_without_dropping()
+{
+    FILE *f = write_stream(NULL, 8, 6, 0, 10);
+    t_frame_stream *fs = frame_stream_open(f, FRAME_STREAM_GRAY, 8, 6, FRAME_STREAM_MIN_BUFFERS, FRAME_STREAM_BLOCK);
+    assert_non_null(fs);
+
+    usleep(50000); // the reader fills the buffers and waits
+    for (int i = 0; i < 10; i++) assert_frame(frame_stream_next(fs), 8, 6, i);
+    assert_null(frame_stream_next(fs));
+    assert_int_equal(frame_stream_dropped(fs), 0);
+
+    frame_stream_close(fs);
+    fclose(f);
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_FRAME_STREAM_H
+#define TEST_FRAME_STREAM_H
+
+void when_reading_a_y4m_stream_frame_stream_returns_the_luma_of_each_frame();
+void when_reading_a_gray_stream_frame_stream_returns_each_frame();
+void when_given_an_invalid_stream_frame_stream_open_returns_error();
+void when_detection_falls_behind_frame_stream_drops_the_oldest_frames();
+void when_detection_falls_behind_frame_stream_waits_without_dropping();
+#endif
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "heap_stats.h"
+#include "apriltag_js.h"
+#include "test_regression.h"
+#include "common/pjpeg.h"
+
+// image with one tag, relative to where the tests run (make tests)
+#define TEST_TAG_IMAGE "test/tag-imgs/single_tag_0_1.jpg"
+
+#define BLOCK_SIZE (4 * 1024 * 1024)
+#define LARGE_BLOCK_SIZE (64 * 1024 * 1024)
+
+void when_memory_is_allocated_heap_stats_sample_reports_it()
+{
+    t_heap_stats hs = HEAP_STATS_INITIALIZER;
+    heap_stats_sample(&hs);
+    size_t used = hs.used;
+
+    uint8_t *block = malloc(BLOCK_SIZE);
+    assert_non_null(block);
+    memset(block, 1, BLOCK_SIZE);
+    heap_stats_sample(&hs);
+    assert_true(hs.used >= used + BLOCK_SIZE);
+    assert_true(hs.footprint >= hs.used);
+    assert_true(hs.peak >= hs.footprint);
+    size_t peak = hs.peak;
+
+    free(block);
+    heap_stats_sample(&hs);
+    assert_true(hs.used < used + BLOCK_SIZE);
+    assert_true(hs.peak >= peak); // the peak is kept
+}
+
+void when_block_fits_heap_stats_probe_succeeds()
+{
+    assert_int_equal(heap_stats_probe(BLOCK_SIZE), 0);
+}
+
+void when_block_cannot_be_allocated_heap_stats_probe_returns_error()
+{
+    assert_int_equal(heap_stats_probe(SIZE_MAX / 2), -1);
+}
+
+void when_the_heap_cannot_hold_a_frame_of_the_budget_detect_refuses_it()
+{
+    int err = 0;
+    pjpeg_t *pjpeg = pjpeg_create_from_file(TEST_TAG_IMAGE, 0, &err);
+    assert_non_null(pjpeg);
+    image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+    pjpeg_destroy(pjpeg);
+
+    atagjs_ctx_t *ctx = atagjs_ctx_create();
+    assert_non_null(ctx);
+    atagjs_ctx_set_detector_options(ctx, 2.0, 0.0, 1, 1, 0, ATAGJS_POSE_FULL, 0);
+    assert_int_equal(atagjs_ctx_set_heap_budget(ctx, im->width, im->height, 4), 0);
+    const t_atagjs_frame_stats *stats = atagjs_ctx_get_frame_stats(ctx);
+
+    // fits; the pose arena of the context grows, so the next frame probes the heap again
+    assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+    assert_int_equal(stats->ndetections, 1);
+    assert_int_equal(stats->over_budget, 0);
+    assert_true(stats->nallocs > 0);
+
+    // heap full, as in the fixed-heap build: blocks of 8 bytes per pixel (less than the frame needs) cannot be allocated
+    regression_heap_fail_from((size_t)im->width * im->height * 8);
+    for (int frame = 0; frame < 2; frame++) {
+        assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+        assert_int_equal(stats->over_budget, 1);
+        assert_int_equal(stats->ndetections, 0);
+    }
+
+    // room again: the probe succeeds and the frame is detected
+    regression_heap_fail_from(0);
+    assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+    assert_int_equal(stats->over_budget, 0);
+    assert_int_equal(stats->ndetections, 1);
+    assert_int_equal(stats->nallocs, 0);
+
+    // the buffers did not grow since that probe: the next frame is not probed (it detects with the heap full; what the
+    // detector allocates for it is smaller than the blocks that fail)
+    regression_heap_fail_from((size_t)im->width * im->height * 8);
+    assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+    regression_heap_fail_from(0);
+    assert_int_equal(stats->over_budget, 0);
+    assert_int_equal(stats->ndetections, 1);
+
+    atagjs_ctx_destroy(ctx);
+    image_u8_destroy(im);
+}
+
+void when_a_buffer_is_allocated_between_frames_heap_used_and_heap_peak_rise()
+{
+    int err = 0;
+    pjpeg_t *pjpeg = pjpeg_create_from_file(TEST_TAG_IMAGE, 0, &err);
+    assert_non_null(pjpeg);
+    image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+    pjpeg_destroy(pjpeg);
+
+    atagjs_ctx_t *ctx = atagjs_ctx_create();
+    assert_non_null(ctx);
+    atagjs_ctx_set_frame_stats(ctx, 1);
+    const t_atagjs_frame_stats *stats = atagjs_ctx_get_frame_stats(ctx);
+
+    // the context samples the heap after each call
+    assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+    double used = stats->heap_used, peak = stats->heap_peak;
+    assert_true(used > 0);
+    assert_true(peak >= used);
+
+    // larger than the largest block glibc takes from its arena (32 MiB on 64 bits), so the heap must grow for it
+    uint8_t *block = malloc(LARGE_BLOCK_SIZE);
+    assert_non_null(block);
+    memset(block, 1, LARGE_BLOCK_SIZE);
+    assert_non_null(atagjs_ctx_detect_image(ctx, im->buf, im->width, im->height, im->stride));
+    assert_true(stats->heap_used >= used + LARGE_BLOCK_SIZE / 2);
+    assert_true(stats->heap_peak >= peak + LARGE_BLOCK_SIZE / 2);
+    assert_true(stats->heap_peak >= stats->heap_used);
+
+    free(block);
+    atagjs_ctx_destroy(ctx);
+    image_u8_destroy(im);
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_HEAP_STATS_H
+#define TEST_HEAP_STATS_H
+
+void when_memory_is_allocated_heap_stats_sample_reports_it();
+void when_block_fits_heap_stats_probe_succeeds();
+void when_block_cannot_be_allocated_heap_stats_probe_returns_error();
+void when_the_heap_cannot_hold_a_frame_of_the_budget_detect_refuses_it();
+void when_a_buffer_is_allocated_between_frames_heap_used_and_heap_peak_rise();
+#endif
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "motion_gate.h"
+
+#define WIDTH 640
+#define HEIGHT 480
+
+/**
+ * Gray frame with a horizontal gradient, a black square (side pixels) at x, y, and uniform noise of +-noise gray levels
+ */
+static uint8_t *frame(int x, int y, int side, int noise, unsigned seed)
+{
+    uint8_t *buf = malloc(WIDTH * HEIGHT);
+    srand(seed);
+    for (int j = 0; j < HEIGHT; j++) {
+        for (int i = 0; i < WIDTH; i++) {
+            int v = 64 + i * 128 / WIDTH;
+            if (i >= x && i < x + side && j >= y && j < y + side) v = 0;
+            if (noise > 0) v += rand() % (2 * noise + 1) - noise;
+            buf[j * WIDTH + i] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+    }
+    return buf;
+}
+
+/**
+ * Change detector with a reference frame committed
+ */
+static t_motion_gate *gate_with_reference(const uint8_t *ref, int refresh_interval)
+{
+    t_motion_gate *mg = malloc(sizeof(t_motion_gate));
+    *mg = (t_motion_gate) MOTION_GATE_INITIALIZER;
+    motion_gate_reset(mg, 6, refresh_interval);
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 0); // no reference yet
+    motion_gate_commit(mg, WIDTH, HEIGHT);
+    return mg;
+}
+
+void when_frame_is_unchanged_motion_gate_check_reuses_it()
+{
+    uint8_t *ref = frame(100, 100, 24, 3, 1);
+    uint8_t *noisy = frame(100, 100, 24, 3, 2); // same scene, other sensor noise
+    t_motion_gate *mg = gate_with_reference(ref, 0);
+
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 1);
+    assert_int_equal(mg->change, 0);
+    assert_int_equal(motion_gate_check(mg, noisy, WIDTH, HEIGHT, WIDTH, 1), 1);
+    assert_true(mg->change <= 6);
+    assert_int_equal(mg->nreused, 2);
+
+    free(mg);
+    free(ref);
+    free(noisy);
+}
+
+void when_a_small_region_changes_motion_gate_check_detects_it()
+{
+    uint8_t *ref = frame(300, 200, 16, 0, 1);
+    uint8_t *moved = frame(306, 200, 16, 0, 1); // a small tag moved by 6 pixels
+    t_motion_gate *mg = gate_with_reference(ref, 0);
+
+    assert_int_equal(motion_gate_check(mg, moved, WIDTH, HEIGHT, WIDTH, 1), 0);
+    assert_true(mg->change > 6);
+
+    // the frame detected becomes the reference
+    motion_gate_commit(mg, WIDTH, HEIGHT);
+    assert_int_equal(motion_gate_check(mg, moved, WIDTH, HEIGHT, WIDTH, 1), 1);
+
+    free(mg);
+    free(ref);
+    free(moved);
+}
+
+void when_refresh_interval_is_reached_motion_gate_check_forces_a_detection()
+{
+    uint8_t *ref = frame(100, 100, 24, 0, 1);
+    t_motion_gate *mg = gate_with_reference(ref, 3);
+
+    for (int i = 0; i < 3; i++) assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 1);
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 0);
+    motion_gate_commit(mg, WIDTH, HEIGHT);
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 1);
+
+    free(mg);
+    free(ref);
+}
+
+void when_size_changes_or_reference_is_invalidated_motion_gate_check_does_not_reuse()
+{
+    uint8_t *ref = frame(100, 100, 24, 0, 1);
+    t_motion_gate *mg = gate_with_reference(ref, 0);
+
+    // same pixels seen as a smaller frame
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH / 2, HEIGHT, WIDTH, 1), 0);
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 1);
+
+    motion_gate_invalidate(mg);
+    assert_int_equal(motion_gate_check(mg, ref, WIDTH, HEIGHT, WIDTH, 1), 0);
+
+    free(mg);
+    free(ref);
+}
+
+void when_frame_is_rgba_motion_gate_check_compares_luma()
+{
+    uint8_t *gray = frame(100, 100, 24, 0, 1);
+    uint8_t *moved = frame(130, 100, 24, 0, 1);
+    uint8_t *rgba = malloc(WIDTH * HEIGHT * 4);
+    uint8_t *rgba_moved = malloc(WIDTH * HEIGHT * 4);
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        memset(rgba + 4 * i, gray[i], 3);
+        memset(rgba_moved + 4 * i, moved[i], 3);
+        rgba[4 * i + 3] = rgba_moved[4 * i + 3] = 255;
+    }
+
+    // the reference is the grayscale frame; the same scene in RGBA is unchanged
+    t_motion_gate *mg = gate_with_reference(gray, 0);
+    assert_int_equal(motion_gate_check(mg, rgba, WIDTH, HEIGHT, WIDTH, 4), 1);
+    assert_int_equal(mg->change, 0);
+    assert_int_equal(motion_gate_check(mg, rgba_moved, WIDTH, HEIGHT, WIDTH, 4), 0);
+
+    free(mg);
+    free(gray);
+    free(moved);
+    free(rgba);
+    free(rgba_moved);
+}
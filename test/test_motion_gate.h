@@ -0,0 +1,9 @@
+#ifndef TEST_MOTION_GATE_H
+#define TEST_MOTION_GATE_H
+
+void when_frame_is_unchanged_motion_gate_check_reuses_it();
+void when_a_small_region_changes_motion_gate_check_detects_it();
+void when_refresh_interval_is_reached_motion_gate_check_forces_a_detection();
+void when_size_changes_or_reference_is_invalidated_motion_gate_check_does_not_reuse();
+void when_frame_is_rgba_motion_gate_check_compares_luma();
+#endif
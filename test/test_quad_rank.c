@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "quad_rank.h"
+
+#define IMG_SIZE 64
+
+static uint8_t pixels[IMG_SIZE * IMG_SIZE];
+static image_u8_t img = { .width = IMG_SIZE, .height = IMG_SIZE, .stride = IMG_SIZE, .buf = pixels };
+
+/**
+ * Fill the image with a background value and draw a filled square (x0 <= x < x1, y0 <= y < y1)
+ */
+static void draw_square(uint8_t background, uint8_t value, int x0, int y0, int x1, int y1)
+{
+    memset(pixels, background, sizeof(pixels));
+    for (int y = y0; y < y1; y++)
+        for (int x = x0; x < x1; x++) pixels[y * IMG_SIZE + x] = value;
+}
+
+/**
+ * Score of the quad with corners on the square (x0 <= x < x1, y0 <= y < y1)
+ */
+static double square_score(int x0, int y0, int x1, int y1)
+{
+    const float p[4][2] = { { x0, y0 }, { x1, y0 }, { x1, y1 }, { x0, y1 } };
+    return quad_rank_score(&img, p);
+}
+
+void when_quads_differ_in_contrast_quad_rank_score_ranks_the_sharper_first()
+{
+    draw_square(255, 0, 16, 16, 48, 48);
+    double sharp = square_score(16, 16, 48, 48);
+    assert_true(sharp == 32.0 * 32.0 * 255);
+
+    draw_square(140, 100, 16, 16, 48, 48);
+    double faint = square_score(16, 16, 48, 48);
+    assert_true(faint == 32.0 * 32.0 * 40);
+    assert_true(sharp > faint);
+}
+
+void when_quads_differ_in_size_quad_rank_score_ranks_the_larger_first()
+{
+    draw_square(255, 0, 16, 16, 48, 48);
+    double large = square_score(16, 16, 48, 48);
+
+    draw_square(255, 0, 24, 24, 40, 40);
+    double small = square_score(24, 24, 40, 40);
+    assert_true(small > 0);
+    assert_true(large > small);
+}
+
+void when_border_is_reversed_quad_rank_score_is_the_same()
+{
+    draw_square(255, 0, 16, 16, 48, 48);
+    double dark = square_score(16, 16, 48, 48);
+
+    draw_square(0, 255, 16, 16, 48, 48);
+    double light = square_score(16, 16, 48, 48);
+    assert_true(dark == light);
+}
+
+void when_quad_is_degenerate_or_flat_quad_rank_score_is_zero()
+{
+    draw_square(255, 0, 16, 16, 48, 48);
+    const float point[4][2] = { { 20, 20 }, { 20, 20 }, { 20, 20 }, { 20, 20 } };
+    assert_true(quad_rank_score(&img, point) == 0);
+    const float line[4][2] = { { 10, 10 }, { 20, 20 }, { 30, 30 }, { 40, 40 } };
+    assert_true(quad_rank_score(&img, line) == 0);
+
+    // no edge under the quad
+    memset(pixels, 128, sizeof(pixels));
+    assert_true(square_score(16, 16, 48, 48) == 0);
+
+    // corners outside the image are sampled at its border
+    draw_square(255, 0, 16, 16, 48, 48);
+    const float outside[4][2] = { { -100, -100 }, { 200, -100 }, { 200, 200 }, { -100, 200 } };
+    assert_true(quad_rank_score(&img, outside) == 0);
+}
+
+void when_called_quad_rank_sort_orders_by_score_and_keeps_ties_in_order()
+{
+    t_quad_rank ranks[] = {
+        { .score = 1, .index = 0 }, { .score = 5, .index = 1 }, { .score = 3, .index = 2 },
+        { .score = 5, .index = 3 }, { .score = 0, .index = 4 }, { .score = 3, .index = 5 } };
+    int expected[] = { 1, 3, 2, 5, 0, 4 };
+
+    quad_rank_sort(ranks, 6);
+    for (int i = 0; i < 6; i++) assert_int_equal(ranks[i].index, expected[i]);
+
+    // nothing to sort
+    quad_rank_sort(ranks, 0);
+}
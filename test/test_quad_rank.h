@@ -0,0 +1,9 @@
+#ifndef TEST_QUAD_RANK_H
+#define TEST_QUAD_RANK_H
+
+void when_quads_differ_in_contrast_quad_rank_score_ranks_the_sharper_first();
+void when_quads_differ_in_size_quad_rank_score_ranks_the_larger_first();
+void when_border_is_reversed_quad_rank_score_is_the_same();
+void when_quad_is_degenerate_or_flat_quad_rank_score_is_zero();
+void when_called_quad_rank_sort_orders_by_score_and_keeps_ties_in_order();
+#endif
@@ -0,0 +1,582 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <malloc.h>
+#include <dirent.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "apriltag_js.h"
+#include "common/pjpeg.h"
+#include "common/time_util.h"
+
+// images, golden outputs and baseline, relative to where the tests run (make tests)
+#define REGRESSION_IMG_DIR "test/tag-imgs"
+#define REGRESSION_GOLDEN "test/regression/golden.txt"
+#define REGRESSION_BASELINE "test/regression/baseline.txt"
+
+// scenes of rendered tags: the ids and corners of the tags, which are drawn where the corners say (see render_scene())
+#define REGRESSION_RENDERED "test/regression/rendered.txt"
+#define REGRESSION_TAG_IMG "test/tag-imgs/tag36h11_all/tag36_11_%05d.jpg"
+#define REGRESSION_SCENE_WIDTH 640
+#define REGRESSION_SCENE_HEIGHT 480
+
+// when set in the environment, the golden outputs (and, with REGRESSION_PERF_ENV, the baseline) are written instead
+// of checked (make tests-record, make bench-regression-record)
+#define REGRESSION_RECORD_ENV "ATAGJS_REGRESSION_RECORD"
+
+// when set in the environment, detections are timed and checked against the baseline (make bench-regression); wall
+// time depends on the machine, so make tests does not check it
+#define REGRESSION_PERF_ENV "ATAGJS_REGRESSION_PERF"
+
+// timed detections of each image (after one untimed); the median is compared against the baseline
+#define REGRESSION_ITERS 7
+
+// corners may move this much (pixels) from the golden outputs
+#define REGRESSION_CORNER_TOLERANCE 0.1
+
+// corners of rendered tags may be this far (pixels) from where they were drawn (where the detector puts a corner
+// within its pixel)
+#define REGRESSION_RENDERED_CORNER_TOLERANCE 1.0
+
+// latency fails when above baseline * REGRESSION_TIME_TOLERANCE + REGRESSION_TIME_SLACK_US (timing noise of short frames)
+#define REGRESSION_TIME_TOLERANCE 1.25
+#define REGRESSION_TIME_SLACK_US 500.0
+
+// peak heap fails when above baseline * REGRESSION_HEAP_TOLERANCE
+#define REGRESSION_HEAP_TOLERANCE 1.10
+
+#define REGRESSION_MAX_IMAGES 64
+#define REGRESSION_MAX_DETECTIONS 64
+#define REGRESSION_NAME_LEN 128
+
+typedef struct {
+    int id;
+    double corners[4][2];
+} t_regression_det;
+
+/**
+ * Results of one image
+ */
+typedef struct {
+    char name[REGRESSION_NAME_LEN];
+    int ndets;
+    t_regression_det dets[REGRESSION_MAX_DETECTIONS];
+    double time_us;       // median atagjs_detect() wall time
+    long long peak_heap;  // peak heap above what was allocated before atagjs_init(), in bytes
+} t_regression_image;
+
+// results of the run (group setup) and the golden outputs/baseline they are checked against; scenes of rendered tags
+// and their results
+static t_regression_image g_run[REGRESSION_MAX_IMAGES];
+static int g_nrun = 0;
+static t_regression_image g_ref[REGRESSION_MAX_IMAGES];
+static int g_nref = 0;
+static t_regression_image g_scene_run[REGRESSION_MAX_IMAGES];
+static t_regression_image g_scenes[REGRESSION_MAX_IMAGES];
+static int g_nscenes = 0;
+static int g_record = 0;
+static int g_perf = 0;
+
+/*
+ * Heap accounting: the test runner is linked with -Wl,--wrap=malloc,... (see the Makefile), so allocations of the
+ * detector and of the apriltag library go through these and the bytes in use (and their peak) are tracked, and the
+ * allocations counted (see regression_heap_nallocs())
+ */
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+static long long g_heap_inuse = 0;
+static long long g_heap_peak = 0;
+static long long g_heap_nallocs = 0;
+static size_t g_heap_fail_size = 0;
+
+static void heap_add(long long bytes)
+{
+    long long inuse = __atomic_add_fetch(&g_heap_inuse, bytes, __ATOMIC_RELAXED);
+    long long peak = __atomic_load_n(&g_heap_peak, __ATOMIC_RELAXED);
+    while (inuse > peak && !__atomic_compare_exchange_n(&g_heap_peak, &peak, inuse, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void *__wrap_malloc(size_t size)
+{
+    if (g_heap_fail_size > 0 && size >= g_heap_fail_size) return NULL;
+    void *p = __real_malloc(size);
+    __atomic_add_fetch(&g_heap_nallocs, 1, __ATOMIC_RELAXED);
+    if (p != NULL) heap_add(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    if (g_heap_fail_size > 0 && nmemb * size >= g_heap_fail_size) return NULL;
+    void *p = __real_calloc(nmemb, size);
+    __atomic_add_fetch(&g_heap_nallocs, 1, __ATOMIC_RELAXED);
+    if (p != NULL) heap_add(malloc_usable_size(p));
+    return p;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (g_heap_fail_size > 0 && size >= g_heap_fail_size) return NULL;
+    long long old = ptr != NULL ? (long long)malloc_usable_size(ptr) : 0;
+    void *p = __real_realloc(ptr, size);
+    if (size > 0) __atomic_add_fetch(&g_heap_nallocs, 1, __ATOMIC_RELAXED);
+    if (p != NULL) heap_add((long long)malloc_usable_size(p) - old);
+    else if (size == 0) heap_add(-old);
+    return p;
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL) heap_add(-(long long)malloc_usable_size(ptr));
+    __real_free(ptr);
+}
+
+/**
+ * Heap allocations so far (malloc, calloc and realloc calls), of the whole test runner; other tests count the
+ * allocations of a call by sampling this before and after it
+ */
+long long regression_heap_nallocs()
+{
+    return __atomic_load_n(&g_heap_nallocs, __ATOMIC_RELAXED);
+}
+
+/**
+ * Make allocations of at least this many bytes fail (return NULL), as they do when a heap that cannot grow is full;
+ * 0 to allocate normally again
+ */
+void regression_heap_fail_from(size_t bytes)
+{
+    g_heap_fail_size = bytes;
+}
+
+/**
+ * Start measuring the peak from the bytes in use now; returns them
+ */
+static long long heap_reset_peak()
+{
+    long long inuse = __atomic_load_n(&g_heap_inuse, __ATOMIC_RELAXED);
+    __atomic_store_n(&g_heap_peak, inuse, __ATOMIC_RELAXED);
+    return inuse;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static int cmp_det(const void *a, const void *b)
+{
+    const t_regression_det *da = a, *db = b;
+    if (da->id != db->id) return (da->id > db->id) - (da->id < db->id);
+    return cmp_double(&da->corners[0][0], &db->corners[0][0]);
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+    return strcmp(a, b);
+}
+
+/**
+ * Parse the detections of the json output (ids and corners); sorted by id, then by the x of the first corner
+ */
+static int parse_detections(const char *json, t_regression_det *dets)
+{
+    int n = 0;
+    const char *p = json;
+    while ((p = strstr(p, "{\"id\":")) != NULL) {
+        if (n == REGRESSION_MAX_DETECTIONS) return -1;
+        t_regression_det *d = &dets[n];
+        d->id = (int)strtol(p + strlen("{\"id\":"), NULL, 10);
+        p = strstr(p, "\"corners\": [");
+        if (p == NULL) return -1;
+        p += strlen("\"corners\": [");
+        for (int c = 0; c < 4; c++) {
+            int len = 0;
+            if (sscanf(p, "{\"x\":%lf,\"y\":%lf}%n", &d->corners[c][0], &d->corners[c][1], &len) != 2 || len == 0) return -1;
+            p += len + (c < 3);  // skip the comma
+        }
+        n++;
+    }
+    qsort(dets, n, sizeof(t_regression_det), cmp_det);
+    return n;
+}
+
+/**
+ * Load a jpg image as grayscale
+ */
+static image_u8_t *load_jpg(const char *path)
+{
+    int err = 0;
+    pjpeg_t *pjpeg = pjpeg_create_from_file(path, 0, &err);
+    if (pjpeg == NULL) return NULL;
+    image_u8_t *im = pjpeg_to_u8_baseline(pjpeg);
+    pjpeg_destroy(pjpeg);
+    return im;
+}
+
+/**
+ * Detect on an image with the atagjs_init()/atagjs_set_img_buffer()/atagjs_detect() path; fills the detections and,
+ * when timing (g_perf), the median time and peak heap of the result
+ */
+static int run_image(image_u8_t *im, t_regression_image *res)
+{
+    long long heap_base = heap_reset_peak();
+    int ret = atagjs_init();
+    if (ret == 0) ret = atagjs_set_detector_options(2.0, 0.0, 1, 1, 0, ATAGJS_POSE_FULL, 1);
+    uint8_t *buf = ret == 0 ? atagjs_set_img_buffer(im->width, im->height, im->width) : NULL;
+    if (buf == NULL) ret = -1;
+
+    double times[REGRESSION_ITERS];
+    for (int i = -1; ret == 0 && i < (g_perf ? REGRESSION_ITERS : 0); i++) {
+        // the frame is copied in every time, as javascript does before calling detect
+        for (int y = 0; y < im->height; y++) memcpy(buf + y * im->width, im->buf + y * im->stride, im->width);
+        int64_t start = utime_now();
+        t_str_json *json = atagjs_detect();
+        int64_t end = utime_now();
+        if (json == NULL) ret = -1;
+        else if (i < 0) {
+            res->ndets = parse_detections(json->str, res->dets);
+            if (res->ndets < 0) ret = -1;
+        }
+        else times[i] = (double)(end - start);
+    }
+    res->peak_heap = __atomic_load_n(&g_heap_peak, __ATOMIC_RELAXED) - heap_base;
+    atagjs_destroy();
+    if (ret != 0 || !g_perf) return ret;
+
+    qsort(times, REGRESSION_ITERS, sizeof(double), cmp_double);
+    res->time_us = times[REGRESSION_ITERS / 2];
+    return 0;
+}
+
+/**
+ * Render a scene: each tag is drawn axis-aligned on a white image, from its image in test/tag-imgs/tag36h11_all
+ * (10x10 cells: the white border, the black border and the data bits), scaled so the outer corners of its black
+ * border are the corners of the scene
+ *
+ * @return the image; NULL if a tag image could not be loaded, or a tag is not a square of whole cells in the scene
+ */
+static image_u8_t *render_scene(const t_regression_image *scene)
+{
+    image_u8_t *im = image_u8_create(REGRESSION_SCENE_WIDTH, REGRESSION_SCENE_HEIGHT);
+    if (im == NULL) return NULL;
+    for (int y = 0; y < im->height; y++) memset(im->buf + y * im->stride, 255, im->width);
+
+    for (int i = 0; i < scene->ndets; i++) {
+        const t_regression_det *d = &scene->dets[i];
+        double x0 = HUGE_VAL, y0 = HUGE_VAL, x1 = -HUGE_VAL, y1 = -HUGE_VAL;
+        for (int c = 0; c < 4; c++) {
+            x0 = fmin(x0, d->corners[c][0]);
+            x1 = fmax(x1, d->corners[c][0]);
+            y0 = fmin(y0, d->corners[c][1]);
+            y1 = fmax(y1, d->corners[c][1]);
+        }
+        // the black border is 8 cells; the white border one more cell on each side
+        int cell = (int)(x1 - x0) / 8;
+        int left = (int)x0 - cell, top = (int)y0 - cell;
+        if (cell < 1 || x1 - x0 != 8 * cell || y1 - y0 != 8 * cell || left < 0 || top < 0 ||
+            left + 10 * cell > im->width || top + 10 * cell > im->height) {
+            image_u8_destroy(im);
+            return NULL;
+        }
+
+        char path[sizeof(REGRESSION_TAG_IMG) + 16];
+        snprintf(path, sizeof(path), REGRESSION_TAG_IMG, d->id);
+        image_u8_t *tag = load_jpg(path);
+        if (tag == NULL) {
+            image_u8_destroy(im);
+            return NULL;
+        }
+        for (int cy = 0; cy < 10; cy++) {
+            for (int cx = 0; cx < 10; cx++) {
+                // the center of the cell in the tag image
+                uint8_t v = tag->buf[(cy * tag->height / 10 + tag->height / 20) * tag->stride + cx * tag->width / 10 + tag->width / 20] < 128 ? 0 : 255;
+                for (int y = 0; y < cell; y++) memset(im->buf + (top + cy * cell + y) * im->stride + left + cx * cell, v, cell);
+            }
+        }
+        image_u8_destroy(tag);
+    }
+    return im;
+}
+
+/**
+ * Read a file of golden outputs: "<image> <ndetections>" followed by a "<id> <x0> <y0> .. <x3> <y3>" line per
+ * detection, for each image; lines starting with # are comments
+ *
+ * @return number of images; -1 if the file could not be read
+ */
+static int read_golden(const char *path, t_regression_image *refs)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int n = 0;
+    t_regression_image *r;
+    int ch;
+    while (n < REGRESSION_MAX_IMAGES) {
+        // skip comments and blank lines
+        while ((ch = fgetc(f)) == '#' || isspace(ch))
+            if (ch == '#') while ((ch = fgetc(f)) != '\n' && ch != EOF);
+        if (ch == EOF) break;
+        ungetc(ch, f);
+        r = &refs[n];
+        if (fscanf(f, "%127s %d", r->name, &r->ndets) != 2) break;
+        if (r->ndets < 0 || r->ndets > REGRESSION_MAX_DETECTIONS) break;
+        int ok = 1;
+        for (int i = 0; ok && i < r->ndets; i++) {
+            t_regression_det *d = &r->dets[i];
+            ok = fscanf(f, "%d %lf %lf %lf %lf %lf %lf %lf %lf", &d->id, &d->corners[0][0], &d->corners[0][1],
+                &d->corners[1][0], &d->corners[1][1], &d->corners[2][0], &d->corners[2][1], &d->corners[3][0], &d->corners[3][1]) == 9;
+        }
+        if (!ok) break;
+        r->time_us = -1;
+        r->peak_heap = -1;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+/**
+ * Read the golden outputs and, when timing (g_perf), the baseline: "<image> <median time us> <peak heap bytes>" for
+ * each image
+ */
+static int read_reference()
+{
+    g_nref = read_golden(REGRESSION_GOLDEN, g_ref);
+    if (g_nref <= 0) {
+        g_nref = 0;
+        return -1;
+    }
+    if (!g_perf) return 0;
+
+    FILE *f = fopen(REGRESSION_BASELINE, "r");
+    if (f == NULL) return 0; // images without a baseline fail the latency test
+    char name[REGRESSION_NAME_LEN];
+    double time_us;
+    long long peak_heap;
+    while (fscanf(f, "%127s %lf %lld", name, &time_us, &peak_heap) == 3) {
+        for (int i = 0; i < g_nref; i++) {
+            if (strcmp(g_ref[i].name, name) != 0) continue;
+            g_ref[i].time_us = time_us;
+            g_ref[i].peak_heap = peak_heap;
+        }
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * Write the results of the run as the golden outputs and, when timing (g_perf), the baseline
+ */
+static int write_reference()
+{
+    FILE *golden = fopen(REGRESSION_GOLDEN, "w");
+    FILE *baseline = g_perf ? fopen(REGRESSION_BASELINE, "w") : NULL;
+    if (golden == NULL || (g_perf && baseline == NULL)) {
+        if (golden != NULL) fclose(golden);
+        if (baseline != NULL) fclose(baseline);
+        return -1;
+    }
+    for (int i = 0; i < g_nrun; i++) {
+        const t_regression_image *r = &g_run[i];
+        fprintf(golden, "%s %d\n", r->name, r->ndets);
+        for (int j = 0; j < r->ndets; j++) {
+            const t_regression_det *d = &r->dets[j];
+            fprintf(golden, "%d %.2f %.2f %.2f %.2f %.2f %.2f %.2f %.2f\n", d->id, d->corners[0][0], d->corners[0][1],
+                d->corners[1][0], d->corners[1][1], d->corners[2][0], d->corners[2][1], d->corners[3][0], d->corners[3][1]);
+        }
+        if (baseline != NULL) fprintf(baseline, "%s %.0f %lld\n", r->name, r->time_us, r->peak_heap);
+    }
+    fclose(golden);
+    if (baseline != NULL) fclose(baseline);
+    return 0;
+}
+
+/**
+ * Group setup: run the scenes of rendered tags, and the images of the golden outputs (or, when recording, all the jpg
+ * images) once for all tests
+ */
+int regression_setup(void **state)
+{
+    (void)state;
+    g_record = getenv(REGRESSION_RECORD_ENV) != NULL;
+    g_perf = getenv(REGRESSION_PERF_ENV) != NULL;
+    g_nrun = 0;
+    g_nref = 0;
+
+    g_nscenes = read_golden(REGRESSION_RENDERED, g_scenes);
+    if (g_nscenes <= 0) {
+        print_message("regression: could not read the rendered scenes (%s)\n", REGRESSION_RENDERED);
+        g_nscenes = 0;
+        return -1;
+    }
+    for (int i = 0; i < g_nscenes; i++) {
+        t_regression_image *r = &g_scene_run[i];
+        snprintf(r->name, sizeof(r->name), "%s", g_scenes[i].name);
+        image_u8_t *im = render_scene(&g_scenes[i]);
+        int ret = (im != NULL) ? run_image(im, r) : -1;
+        if (im != NULL) image_u8_destroy(im);
+        if (ret != 0) {
+            print_message("regression: failed to render or detect on scene %s\n", r->name);
+            return -1;
+        }
+    }
+
+    char names[REGRESSION_MAX_IMAGES][REGRESSION_NAME_LEN];
+    int nnames = 0;
+    if (g_record) {
+        DIR *dir = opendir(REGRESSION_IMG_DIR);
+        if (dir == NULL) return -1;
+        struct dirent *e;
+        while ((e = readdir(dir)) != NULL && nnames < REGRESSION_MAX_IMAGES) {
+            size_t len = strlen(e->d_name);
+            if (len < 4 || len >= REGRESSION_NAME_LEN || strcmp(e->d_name + len - 4, ".jpg") != 0) continue;
+            memcpy(names[nnames++], e->d_name, len + 1);
+        }
+        closedir(dir);
+        qsort(names, nnames, REGRESSION_NAME_LEN, cmp_name);
+    } else {
+        // nothing to check against: the tests are skipped
+        if (read_reference() != 0) return 0;
+        for (int i = 0; i < g_nref; i++) memcpy(names[nnames++], g_ref[i].name, REGRESSION_NAME_LEN);
+    }
+
+    int ret = 0;
+    for (int i = 0; i < nnames; i++) {
+        char path[sizeof(REGRESSION_IMG_DIR) + REGRESSION_NAME_LEN];
+        snprintf(path, sizeof(path), "%s/%s", REGRESSION_IMG_DIR, names[i]);
+        t_regression_image *r = &g_run[g_nrun];
+        snprintf(r->name, sizeof(r->name), "%s", names[i]);
+        image_u8_t *im = load_jpg(path);
+        if (im == NULL || run_image(im, r) != 0) {
+            print_message("regression: failed to detect on %s\n", path);
+            ret = -1;
+        } else {
+            if (g_perf) print_message("regression: %s %d tags %.0f us, peak heap %lld bytes\n", r->name, r->ndets, r->time_us, r->peak_heap);
+            g_nrun++;
+        }
+        if (im != NULL) image_u8_destroy(im);
+    }
+
+    if (ret == 0 && g_record) {
+        ret = write_reference();
+        if (ret == 0) print_message("regression: recorded %s%s\n", REGRESSION_GOLDEN, g_perf ? " and " REGRESSION_BASELINE : "");
+    }
+    return ret;
+}
+
+/**
+ * Group teardown
+ */
+int regression_teardown(void **state)
+{
+    (void)state;
+    g_nrun = 0;
+    g_nref = 0;
+    g_nscenes = 0;
+    return 0;
+}
+
+/**
+ * Check detections against golden outputs: same ids, and corners within tolerance; with any_start, the corners may
+ * start at any corner of the golden outputs (in the same order around the tag)
+ *
+ * @return 1 if they match; 0 otherwise
+ */
+static int detections_match(const t_regression_image *r, const t_regression_image *ref, double tolerance, int any_start)
+{
+    if (r->ndets != ref->ndets) return 0;
+    for (int j = 0; j < r->ndets; j++) {
+        if (r->dets[j].id != ref->dets[j].id) return 0;
+        int ok = 0;
+        for (int s = 0; !ok && s < (any_start ? 4 : 1); s++) {
+            ok = 1;
+            for (int c = 0; ok && c < 4; c++) {
+                ok = fabs(r->dets[j].corners[(c + s) % 4][0] - ref->dets[j].corners[c][0]) <= tolerance &&
+                     fabs(r->dets[j].corners[(c + s) % 4][1] - ref->dets[j].corners[c][1]) <= tolerance;
+            }
+        }
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+void when_detecting_rendered_tags_ids_and_corners_match_where_they_were_drawn()
+{
+    assert_true(g_nscenes > 0);
+
+    // the corner a tag starts at is the detector's convention; the rendered scenes only fix where the corners are
+    int failed = 0;
+    for (int i = 0; i < g_nscenes; i++) {
+        if (!detections_match(&g_scene_run[i], &g_scenes[i], REGRESSION_RENDERED_CORNER_TOLERANCE, 1)) {
+            print_message("regression: scene %s detections differ from the tags drawn (%d tags, drawn %d)\n", g_scenes[i].name,
+                g_scene_run[i].ndets, g_scenes[i].ndets);
+            failed++;
+        }
+    }
+    assert_int_equal(failed, 0);
+}
+
+/**
+ * Skip the test when recording, or when there are no golden outputs to check against
+ */
+static void skip_without_reference()
+{
+    if (g_record) skip();
+    if (g_nref == 0) {
+        print_message("regression: no golden outputs (%s); record them with make tests-record\n", REGRESSION_GOLDEN);
+        skip();
+    }
+    assert_int_equal(g_nrun, g_nref);
+}
+
+void when_detecting_the_test_images_ids_and_corners_match_the_golden_outputs()
+{
+    skip_without_reference();
+
+    int failed = 0;
+    for (int i = 0; i < g_nrun; i++) {
+        const t_regression_image *r = &g_run[i], *ref = &g_ref[i];
+        if (!detections_match(r, ref, REGRESSION_CORNER_TOLERANCE, 0)) {
+            print_message("regression: %s detections differ from the golden outputs (%d tags, golden %d)\n", r->name, r->ndets, ref->ndets);
+            failed++;
+        }
+    }
+    assert_int_equal(failed, 0);
+}
+
+void when_detecting_the_test_images_latency_and_peak_heap_do_not_regress()
+{
+    // timed by make bench-regression only
+    if (!g_perf) skip();
+    skip_without_reference();
+
+    int failed = 0;
+    for (int i = 0; i < g_nrun; i++) {
+        const t_regression_image *r = &g_run[i], *ref = &g_ref[i];
+        if (ref->time_us < 0) {
+            print_message("regression: %s has no baseline\n", r->name);
+            failed++;
+            continue;
+        }
+        if (r->time_us > ref->time_us * REGRESSION_TIME_TOLERANCE + REGRESSION_TIME_SLACK_US) {
+            print_message("regression: %s latency %.0f us, baseline %.0f us\n", r->name, r->time_us, ref->time_us);
+            failed++;
+        }
+        if (r->peak_heap > ref->peak_heap * REGRESSION_HEAP_TOLERANCE) {
+            print_message("regression: %s peak heap %lld bytes, baseline %lld bytes\n", r->name, r->peak_heap, ref->peak_heap);
+            failed++;
+        }
+    }
+    assert_int_equal(failed, 0);
+}
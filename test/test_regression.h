@@ -0,0 +1,11 @@
+#ifndef TEST_REGRESSION_H
+#define TEST_REGRESSION_H
+
+int regression_setup(void **state);
+int regression_teardown(void **state);
+long long regression_heap_nallocs();
+void regression_heap_fail_from(size_t bytes);
+void when_detecting_rendered_tags_ids_and_corners_match_where_they_were_drawn();
+void when_detecting_the_test_images_ids_and_corners_match_the_golden_outputs();
+void when_detecting_the_test_images_latency_and_peak_heap_do_not_regress();
+#endif
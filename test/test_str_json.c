@@ -1,4 +1,9 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
 #include <stdarg.h>
 #include <stddef.h>
 #include <setjmp.h>
@@ -98,22 +103,22 @@ void when_given_empty_inputs_str_json_concat_returns_a_valid_result()
     str_json_destroy(&str_json);
 }
 
-void when_given_too_large_inputs_str_json_concat_returns_a_valid_result()
+void when_given_too_large_inputs_str_json_concat_grows_the_string()
 {
     t_str_json str_json = STR_JSON_INITIALIZER, str_json1 = STR_JSON_INITIALIZER;
     str_json_create(&str_json, 10);
 
     int r = str_json_concat( &str_json, "A large input!");
-    assert_int_equal(r, 10);
-    assert_int_equal(str_json.alloc_size, 10);
-    assert_int_equal(str_json.len, 10);
-    assert_string_equal(str_json.str, "A large in");
+    assert_int_equal(r, 14);
+    assert_int_equal(str_json.alloc_size, 20);
+    assert_int_equal(str_json.len, 14);
+    assert_string_equal(str_json.str, "A large input!");
 
     r = str_json_concat( &str_json, "Lets try again!");
-    assert_int_equal(r, 10);
-    assert_int_equal(str_json.alloc_size, 10);
-    assert_int_equal(str_json.len, 10);
-    assert_string_equal(str_json.str, "A large in");
+    assert_int_equal(r, 29);
+    assert_int_equal(str_json.alloc_size, 40);
+    assert_int_equal(str_json.len, 29);
+    assert_string_equal(str_json.str, "A large input!Lets try again!");
 
     str_json_create(&str_json1, 10);
 
@@ -137,9 +142,9 @@ void when_concat_called_in_sequence_return_a_valid_result()
     str_json_concat( &str_json, "Two");
     assert_string_equal(str_json.str, "OneTwo");
     str_json_concat( &str_json, "Three");
-    assert_string_equal(str_json.str, "OneTwoThre");
-    assert_int_equal(str_json.alloc_size, 10);
-    assert_int_equal(str_json.len, 10);
+    assert_string_equal(str_json.str, "OneTwoThree");
+    assert_int_equal(str_json.alloc_size, 20);
+    assert_int_equal(str_json.len, 11);
 
     str_json_destroy(&str_json);
 }
@@ -152,22 +157,24 @@ void when_clear_and_concat_called_in_sequence_return_a_valid_result()
     str_json_concat( &str_json, "One");
     str_json_concat( &str_json, "Two");
     str_json_concat( &str_json, "Three");
-    assert_string_equal(str_json.str, "OneTwoThre");
+    assert_string_equal(str_json.str, "OneTwoThree");
+    char *ptr = str_json.str;
 
     str_json_clear(&str_json);
-    assert_int_equal(str_json.alloc_size, 10);
+    assert_int_equal(str_json.alloc_size, 20);
     assert_int_equal(str_json.len, 0);
     assert_string_equal(str_json.str, "");
 
     str_json_concat( &str_json, "One");
     str_json_concat( &str_json, "Two");
     str_json_concat( &str_json, "Three");
-    assert_string_equal(str_json.str, "OneTwoThre");
-    assert_int_equal(str_json.alloc_size, 10);
-    assert_int_equal(str_json.len, 10);
+    assert_string_equal(str_json.str, "OneTwoThree");
+    assert_int_equal(str_json.alloc_size, 20);
+    assert_int_equal(str_json.len, 11);
+    assert_ptr_equal(ptr, str_json.str); // cleared string is reused without allocating
 
     str_json_clear(&str_json);
-    assert_int_equal(str_json.alloc_size, 10);
+    assert_int_equal(str_json.alloc_size, 20);
     assert_int_equal(str_json.len, 0);
     assert_string_equal(str_json.str, "");
 
@@ -182,7 +189,7 @@ void when_destroy_and_concat_called_in_sequence_return_a_valid_result()
     str_json_concat( &str_json, "One");
     str_json_concat( &str_json, "Two");
     str_json_concat( &str_json, "Three");
-    assert_string_equal(str_json.str, "OneTwoThre");
+    assert_string_equal(str_json.str, "OneTwoThree");
 
     str_json_destroy(&str_json);
     str_json_create(&str_json, 20);
@@ -216,16 +223,262 @@ void when_str_json_printf_called_returns_a_well_formatted_result()
     assert_int_equal(str_json.alloc_size, 100);
     assert_int_equal(str_json.len, 10);
 
+    // appends
+    str_json_printf(&str_json, ", another: %s", "six");
+    assert_string_equal(str_json.str, "A value: 5, another: six");
+    assert_int_equal(str_json.len, 24);
+
     str_json_destroy(&str_json);
 }
 
-void when_given_too_large_inputs_str_json_printf_returns_a_well_formatted_result()
+void when_given_too_large_inputs_str_json_printf_grows_the_string()
 {
     t_str_json str_json = STR_JSON_INITIALIZER;
     str_json_create(&str_json, 30);
 
     str_json_printf(&str_json, "A value: %s", "this is a long string");
-    assert_string_equal(str_json.str, "A value: this is a long strin");
+    assert_string_equal(str_json.str, "A value: this is a long string");
+    assert_int_equal(str_json.len, 30);
+
+    str_json_printf(&str_json, " (%d)", 1234);
+    assert_string_equal(str_json.str, "A value: this is a long string (1234)");
+    assert_int_equal(str_json.alloc_size, 60);
+    assert_int_equal(str_json.len, 37);
+
+    str_json_destroy(&str_json);
+}
+
+void when_str_json_reserve_called_appends_do_not_allocate()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 10);
+
+    int r = str_json_reserve(&str_json, 1000);
+    assert_int_equal(r, 0);
+    assert_int_equal(str_json.alloc_size, 1000);
+    char *ptr = str_json.str;
+
+    for (int i = 0; i < 100; i++) str_json_concat(&str_json, "0123456789");
+    assert_int_equal(str_json.len, 1000);
+    assert_int_equal(str_json.alloc_size, 1000);
+    assert_ptr_equal(ptr, str_json.str);
+
+    str_json_destroy(&str_json);
+
+    // not created
+    r = str_json_reserve(&str_json, 10);
+    assert_int_equal(r, -1);
+}
+
+void when_str_json_int_called_returns_a_well_formatted_result()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 4);
+
+    str_json_int(&str_json, 0);
+    str_json_concat(&str_json, ",");
+    str_json_int(&str_json, 586);
+    str_json_concat(&str_json, ",");
+    str_json_int(&str_json, -42);
+    str_json_concat(&str_json, ",");
+    str_json_int(&str_json, -2147483647L - 1);
+    assert_string_equal(str_json.str, "0,586,-42,-2147483648");
+
+    str_json_destroy(&str_json);
+}
+
+void when_str_json_fixed_called_returns_the_shortest_result()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 4);
+
+    // trailing zeros are dropped
+    str_json_fixed(&str_json, 1.5, 2);
+    assert_string_equal(str_json.str, "1.5");
+    str_json_clear(&str_json);
+    str_json_fixed(&str_json, 2.0, 6);
+    assert_string_equal(str_json.str, "2");
+    str_json_clear(&str_json);
+
+    // rounded to the decimal places
+    str_json_fixed(&str_json, 123.456789, 2);
+    assert_string_equal(str_json.str, "123.46");
+    str_json_clear(&str_json);
+    str_json_fixed(&str_json, 3.14159265358979, 6);
+    assert_string_equal(str_json.str, "3.141593");
+    str_json_clear(&str_json);
+    str_json_fixed(&str_json, -0.006, 2);
+    assert_string_equal(str_json.str, "-0.01");
+    str_json_clear(&str_json);
+
+    // no negative zero
+    str_json_fixed(&str_json, -0.001, 2);
+    assert_string_equal(str_json.str, "0");
+    str_json_clear(&str_json);
+
+    // large values, and values json cannot represent
+    str_json_fixed(&str_json, 1e20, 2);
+    assert_string_equal(str_json.str, "100000000000000000000");
+    str_json_clear(&str_json);
+    str_json_fixed(&str_json, 0.0/0.0, 2);
+    assert_string_equal(str_json.str, "null");
+    str_json_clear(&str_json);
+
+    // same value as printf at the same decimal places
+    char buf[64];
+    for (int i = 0; i < 1000; i++) {
+        double v = (i - 500) * 0.7071067811865476;
+        str_json_clear(&str_json);
+        str_json_fixed(&str_json, v, 6);
+        snprintf(buf, sizeof(buf), "%.6f", v);
+        assert_true(strtod(str_json.str, NULL) == strtod(buf, NULL));
+    }
+
+    str_json_destroy(&str_json);
+}
+
+void when_str_json_double_called_returns_the_shortest_round_trip()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 4);
+
+    str_json_double(&str_json, 0.1);
+    assert_string_equal(str_json.str, "0.1");
+    str_json_clear(&str_json);
+    str_json_double(&str_json, 2.0);
+    assert_string_equal(str_json.str, "2");
+    str_json_clear(&str_json);
+    str_json_double(&str_json, -1.0 / 3.0);
+    assert_string_equal(str_json.str, "-0.3333333333333333"); // 16 digits
+    str_json_clear(&str_json);
+    str_json_double(&str_json, 0.1 + 0.2); // 0.30000000000000004 (0.3 is another double)
+    assert_string_equal(str_json.str, "0.30000000000000004");
+    str_json_clear(&str_json);
+    str_json_double(&str_json, 1e20);
+    assert_string_equal(str_json.str, "1e+20");
+    str_json_clear(&str_json);
+    str_json_double(&str_json, 1.0 / 0.0);
+    assert_string_equal(str_json.str, "null");
+
+    str_json_destroy(&str_json);
+}
+
+void when_str_json_double_called_the_result_reads_back_as_the_same_double()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 4);
+
+    // pseudo-random bit patterns: all exponents, subnormals included (not finite values are skipped)
+    uint64_t x = 88172645463325252ull;
+    for (int i = 0; i < 100000; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double v;
+        memcpy(&v, &x, sizeof(v));
+        if (!isfinite(v)) continue;
+
+        str_json_clear(&str_json);
+        str_json_double(&str_json, v);
+        double back = strtod(str_json.str, NULL);
+        if (memcmp(&back, &v, sizeof(v)) != 0) {
+            print_message("str_json_double(%a): %s reads back as %a\n", v, str_json.str, back);
+            fail();
+        }
+    }
+
+    str_json_destroy(&str_json);
+}
+
+void when_building_a_long_string_str_json_concat_grows_the_allocation_geometrically()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    const char *det = "{\"id\":5, \"corners\": [{\"x\":1.5,\"y\":2},{\"x\":3.46,\"y\":4},{\"x\":5,\"y\":6},{\"x\":7,\"y\":8}], \"center\": {\"x\":4,\"y\":5} }";
+    const int n = 10000;
+    str_json_create(&str_json, 16);
+
+    // each reallocation at least doubles the size, so building the string takes a logarithmic number of them (and
+    // copies less than twice its final length): time linear in the length, not quadratic
+    int reallocs = 0;
+    size_t copied = 0, size = str_json.alloc_size;
+    str_json_concat(&str_json, "[ ");
+    for (int i = 0; i < n; i++) {
+        if (i > 0) str_json_concat(&str_json, ", ");
+        size_t len = str_json.len;
+        str_json_concat(&str_json, det);
+        if (str_json.alloc_size != size) {
+            assert_true(str_json.alloc_size >= 2 * size);
+            copied += len;
+            size = str_json.alloc_size;
+            reallocs++;
+        }
+    }
+    str_json_concat(&str_json, " ]");
+
+    size_t len = 4 + n * strlen(det) + (n - 1) * 2;
+    assert_int_equal(str_json.len, len);
+    assert_true(str_json.alloc_size < 2 * len);
+    assert_true(copied < 2 * len);
+    int max_reallocs = 1;
+    for (size_t s = 16; s < len; s *= 2) max_reallocs++;
+    assert_true(reallocs <= max_reallocs);
+
+    str_json_destroy(&str_json);
+}
+
+/**
+ * @brief Check str_json_fixed() against printf "%.*f" (trailing zeros dropped, no negative zero)
+ *
+ * Halves round away from zero; printf rounds the exact binary value (ties to even), so on values at, or within a few
+ * ulps of, a tie the two may differ by one unit in the last decimal place
+ */
+static void check_str_json_fixed(t_str_json *str_json, double value, int decimals)
+{
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+    size_t len = strlen(buf);
+    if (strchr(buf, '.') != NULL) {
+        while (buf[len - 1] == '0') len--;
+        if (buf[len - 1] == '.') len--;
+        buf[len] = '\0';
+    }
+    if (strcmp(buf, "-0") == 0) strcpy(buf, "0");
+
+    str_json_clear(str_json);
+    str_json_fixed(str_json, value, decimals);
+    if (strcmp(str_json->str, buf) == 0) return;
+
+    double scaled = fabs(value) * pow(10, decimals), unit = pow(10, -decimals);
+    double units_apart = fabs(strtod(str_json->str, NULL) - strtod(buf, NULL)) / unit;
+    if (units_apart < 0.5 || units_apart > 1.5 || fabs(scaled - floor(scaled) - 0.5) > 2 * DBL_EPSILON * scaled) {
+        print_message("str_json_fixed(%.17g, %d): %s; printf: %s\n", value, decimals, str_json->str, buf);
+        fail();
+    }
+}
+
+void when_compared_to_snprintf_str_json_fixed_returns_the_same_value()
+{
+    t_str_json str_json = STR_JSON_INITIALIZER;
+    str_json_create(&str_json, 4);
+
+    // ties
+    check_str_json_fixed(&str_json, 0.5, 0);
+    check_str_json_fixed(&str_json, 2.5, 0);
+    check_str_json_fixed(&str_json, -0.125, 2);
+    check_str_json_fixed(&str_json, 193664550.78125, 4);
+
+    // pseudo-random values of 1e-6 to 1e9, at all decimal places (while the scaled value is exact in the rounding)
+    uint32_t x = 12345;
+    for (int decimals = 0; decimals <= STR_JSON_MAX_DECIMALS; decimals++) {
+        for (int i = 0; i < 20000; i++) {
+            x = x * 1664525u + 1013904223u;
+            double v = (x >> 8) / 8388608.0 - 1.0;
+            x = x * 1664525u + 1013904223u;
+            v *= pow(10, (int)(x % 16) - 6);
+            if (fabs(v) * pow(10, decimals) >= 1099511627776.0) continue; // 2^40
+            check_str_json_fixed(&str_json, v, decimals);
+        }
+    }
 
     str_json_destroy(&str_json);
 }
@@ -7,10 +7,17 @@ void when_called_repeatedly_str_json_create_returns_error();
 void when_called_str_json_destroy_destroys();
 void when_called_str_clear_returns_an_empty_string();
 void when_given_empty_inputs_str_json_concat_returns_a_valid_result();
-void when_given_too_large_inputs_str_json_concat_returns_a_valid_result();
+void when_given_too_large_inputs_str_json_concat_grows_the_string();
 void when_concat_called_in_sequence_return_a_valid_result();
 void when_clear_and_concat_called_in_sequence_return_a_valid_result();
 void when_destroy_and_concat_called_in_sequence_return_a_valid_result();
 void when_str_json_printf_called_returns_a_well_formatted_result();
-void when_given_too_large_inputs_str_json_printf_returns_a_well_formatted_result();
+void when_given_too_large_inputs_str_json_printf_grows_the_string();
+void when_str_json_reserve_called_appends_do_not_allocate();
+void when_str_json_int_called_returns_a_well_formatted_result();
+void when_str_json_fixed_called_returns_the_shortest_result();
+void when_str_json_double_called_returns_the_shortest_round_trip();
+void when_str_json_double_called_the_result_reads_back_as_the_same_double();
+void when_building_a_long_string_str_json_concat_grows_the_allocation_geometrically();
+void when_compared_to_snprintf_str_json_fixed_returns_the_same_value();
 #endif
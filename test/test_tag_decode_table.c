@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tag36h11.h"
+#include "tag_decode_table.h"
+
+/**
+ * Look a code up in a decode table, as the detector does (linear probing from code % nentries)
+ *
+ * @return the entry; NULL if the code is not in the table
+ */
+static const t_qd_entry *lookup(const t_qd_table *qd, uint64_t rcode)
+{
+    for (uint32_t bucket = rcode % qd->nentries; qd->entries[bucket].rcode != UINT64_MAX; bucket = (bucket + 1) % qd->nentries)
+        if (qd->entries[bucket].rcode == rcode) return &qd->entries[bucket];
+    return NULL;
+}
+
+void when_attached_tag_decode_table_decodes_every_code_and_the_codes_one_bit_away()
+{
+    apriltag_family_t *tf = tag36h11_create();
+    assert_int_equal(tag_decode_table_attach(tf, 1), 0);
+    const t_qd_table *qd = tf->impl;
+    assert_non_null(qd);
+
+    // one entry per code and per code one bit away
+    int n = 0;
+    for (int i = 0; i < qd->nentries; i++) n += (qd->entries[i].rcode != UINT64_MAX);
+    assert_int_equal(n, tf->ncodes * (1 + tf->nbits));
+
+    for (uint32_t i = 0; i < tf->ncodes; i++)
+    {
+        const t_qd_entry *e = lookup(qd, tf->codes[i]);
+        assert_non_null(e);
+        assert_int_equal(e->id, i);
+        assert_int_equal(e->hamming, 0);
+
+        e = lookup(qd, tf->codes[i] ^ (1ULL << (i % tf->nbits)));
+        assert_non_null(e);
+        assert_int_equal(e->id, i);
+        assert_int_equal(e->hamming, 1);
+    }
+
+    tag_decode_table_detach(tf);
+    assert_null(tf->impl);
+    tag36h11_destroy(tf);
+}
+
+void when_attached_again_tag_decode_table_shares_the_table()
+{
+    apriltag_family_t *tf1 = tag36h11_create();
+    apriltag_family_t *tf2 = tag36h11_create();
+    assert_int_equal(tag_decode_table_attach(tf1, 1), 0);
+    assert_int_equal(tag_decode_table_attach(tf2, 1), 0);
+    assert_ptr_equal(tf1->impl, tf2->impl);
+
+    // a family already using a table
+    assert_int_equal(tag_decode_table_attach(tf1, 1), -1);
+
+    tag_decode_table_detach(tf1);
+    tag_decode_table_detach(tf2);
+    tag36h11_destroy(tf1);
+    tag36h11_destroy(tf2);
+}
+
+void when_no_table_was_generated_tag_decode_table_attach_returns_error()
+{
+    apriltag_family_t *tf = tag36h11_create();
+    assert_int_equal(tag_decode_table_attach(tf, 3), -1);
+    assert_null(tf->impl);
+    tag36h11_destroy(tf);
+}
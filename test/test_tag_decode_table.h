@@ -0,0 +1,7 @@
+#ifndef TEST_TAG_DECODE_TABLE_H
+#define TEST_TAG_DECODE_TABLE_H
+
+void when_attached_tag_decode_table_decodes_every_code_and_the_codes_one_bit_away();
+void when_attached_again_tag_decode_table_shares_the_table();
+void when_no_table_was_generated_tag_decode_table_attach_returns_error();
+#endif
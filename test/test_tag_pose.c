@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "common/homography.h"
+#include "tag_pose.h"
+#include "test_regression.h"
+
+#define TAG_SIZE 0.2
+
+// tag corners in tag coordinates (same order as the detector corners)
+static const double corners[4][2] = { { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+
+// corner noise, in pixels (so the homography pose is not the solution orthogonal iteration converges to)
+static const double noise[4][2] = { { 0.8, -0.5 }, { -0.6, 0.7 }, { 0.4, 0.9 }, { -0.9, -0.3 } };
+
+static apriltag_detection_t det;
+static apriltag_detection_info_t info = { .det = &det, .tagsize = TAG_SIZE, .fx = 800, .fy = 800, .cx = 320, .cy = 240 };
+
+/**
+ * Detection of a tag seen at an angle, 0.6 m away: the corners are projected, with noise, and the homography is
+ * computed from them, as the detector does
+ */
+static void make_detection()
+{
+    const double ax = 0.3, ay = 0.5;
+    const double R[3][3] = {
+        { cos(ay), sin(ay) * sin(ax), sin(ay) * cos(ax) },
+        { 0, cos(ax), -sin(ax) },
+        { -sin(ay), cos(ay) * sin(ax), cos(ay) * cos(ax) } };
+    const double t[3] = { 0.03, -0.02, 0.6 };
+    double corr[4][4];
+
+    det = (apriltag_detection_t) { .family = NULL, .id = 7 };
+    for (int i = 0; i < 4; i++)
+    {
+        double x[3];
+        for (int r = 0; r < 3; r++) x[r] = (R[r][0] * corners[i][0] + R[r][1] * corners[i][1]) * TAG_SIZE / 2 + t[r];
+        det.p[i][0] = info.fx * x[0] / x[2] + info.cx + noise[i][0];
+        det.p[i][1] = info.fy * x[1] / x[2] + info.cy + noise[i][1];
+        corr[i][0] = corners[i][0];
+        corr[i][1] = corners[i][1];
+        corr[i][2] = det.p[i][0];
+        corr[i][3] = det.p[i][1];
+    }
+    det.H = homography_compute2(corr);
+}
+
+static void destroy_pose(apriltag_pose_t *pose)
+{
+    if (pose->R != NULL) matd_destroy(pose->R);
+    if (pose->t != NULL) matd_destroy(pose->t);
+}
+
+void when_starting_cold_tag_pose_estimate_runs_to_convergence()
+{
+    make_detection();
+    t_tag_pose_cache pc = TAG_POSE_CACHE_INITIALIZER;
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+
+    // the pose of the apriltag library (TAG_POSE_MAX_ITERS steps from the homography pose)
+    double ref_err1, ref_err2;
+    apriltag_pose_t ref1, ref2;
+    estimate_tag_pose_orthogonal_iteration(&info, &ref_err1, &ref1, &ref_err2, &ref2, TAG_POSE_MAX_ITERS);
+
+    // nothing cached: starts from the homography pose and iterates until the error converges, not for a single step
+    double err1, err2;
+    apriltag_pose_t pose1, pose2; // in the arena
+    tag_pose_begin_frame(&pc);
+    int cold_iters = tag_pose_estimate(&pc, &fa, &info, &err1, &pose1, &err2, &pose2);
+    assert_true(err1 <= ref_err1 * 1.001 + 1e-12);
+    for (int i = 0; i < 3; i++) assert_true(fabs(pose1.t->data[i] - ref1.t->data[i]) < 1e-4);
+    double cold_err1 = err1;
+
+    // seen in the last frame: starts from the converged pose, so it converges in fewer steps, to the same pose
+    // and does not allocate: the arena kept its memory, and the iteration runs on the stack
+    frame_arena_reset(&fa);
+    tag_pose_begin_frame(&pc);
+    long long nallocs = regression_heap_nallocs();
+    int warm_iters = tag_pose_estimate(&pc, &fa, &info, &err1, &pose1, &err2, &pose2);
+    assert_true(regression_heap_nallocs() == nallocs);
+    assert_true(warm_iters < cold_iters);
+    assert_true(err1 <= cold_err1 * 1.001 + 1e-12);
+
+    destroy_pose(&ref1);
+    destroy_pose(&ref2);
+    frame_arena_destroy(&fa);
+    matd_destroy(det.H);
+}
+
+void when_tag_was_not_seen_in_the_last_frame_tag_pose_estimate_starts_cold()
+{
+    make_detection();
+    t_tag_pose_cache pc = TAG_POSE_CACHE_INITIALIZER;
+    t_frame_arena fa = FRAME_ARENA_INITIALIZER;
+    double err1, err2;
+    apriltag_pose_t pose1, pose2;
+
+    tag_pose_begin_frame(&pc);
+    int cold_iters = tag_pose_estimate(&pc, &fa, &info, &err1, &pose1, &err2, &pose2);
+
+    // a frame without the tag, then the tag again: same steps as the first time
+    tag_pose_begin_frame(&pc);
+    tag_pose_begin_frame(&pc);
+    frame_arena_reset(&fa);
+    assert_int_equal(tag_pose_estimate(&pc, &fa, &info, &err1, &pose1, &err2, &pose2), cold_iters);
+
+    // reset (e.g. a new image): same steps as the first time
+    tag_pose_cache_reset(&pc);
+    tag_pose_begin_frame(&pc);
+    frame_arena_reset(&fa);
+    assert_int_equal(tag_pose_estimate(&pc, &fa, &info, &err1, &pose1, &err2, &pose2), cold_iters);
+
+    frame_arena_destroy(&fa);
+    matd_destroy(det.H);
+}
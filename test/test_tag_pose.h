@@ -0,0 +1,6 @@
+#ifndef TEST_TAG_POSE_H
+#define TEST_TAG_POSE_H
+
+void when_starting_cold_tag_pose_estimate_runs_to_convergence();
+void when_tag_was_not_seen_in_the_last_frame_tag_pose_estimate_starts_cold();
+#endif
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "tag_size.h"
+
+#define DEFAULT_SIZE 0.15
+
+void when_size_was_set_tag_size_get_returns_it()
+{
+    t_tag_size_table ts = TAG_SIZE_TABLE_INITIALIZER;
+
+    assert_int_equal(tag_size_set(&ts, 0, 5, 0.1), 0);
+    assert_int_equal(tag_size_set(&ts, 3, 5, 0.2), 0);
+    assert_int_equal(ts.len, 2);
+    assert_true(tag_size_get(&ts, 0, 5, DEFAULT_SIZE) == 0.1);
+    assert_true(tag_size_get(&ts, 3, 5, DEFAULT_SIZE) == 0.2);
+
+    // setting again replaces the size
+    assert_int_equal(tag_size_set(&ts, 0, 5, 0.3), 0);
+    assert_int_equal(ts.len, 2);
+    assert_true(tag_size_get(&ts, 0, 5, DEFAULT_SIZE) == 0.3);
+
+    tag_size_destroy(&ts);
+    assert_null(ts.keys);
+    assert_int_equal(ts.nslots, 0);
+}
+
+void when_size_was_not_set_for_the_family_tag_size_get_returns_the_any_family_size()
+{
+    t_tag_size_table ts = TAG_SIZE_TABLE_INITIALIZER;
+
+    assert_int_equal(tag_size_set(&ts, TAG_SIZE_ANY_FAMILY, 7, 0.5), 0);
+    assert_int_equal(tag_size_set(&ts, 2, 7, 0.25), 0);
+    assert_true(tag_size_get(&ts, 0, 7, DEFAULT_SIZE) == 0.5);
+    assert_true(tag_size_get(&ts, 4, 7, DEFAULT_SIZE) == 0.5);
+    assert_true(tag_size_get(&ts, 2, 7, DEFAULT_SIZE) == 0.25);
+
+    tag_size_destroy(&ts);
+}
+
+void when_size_was_not_set_tag_size_get_returns_the_default()
+{
+    t_tag_size_table ts = TAG_SIZE_TABLE_INITIALIZER;
+
+    // empty table
+    assert_true(tag_size_get(&ts, 0, 1, DEFAULT_SIZE) == DEFAULT_SIZE);
+
+    assert_int_equal(tag_size_set(&ts, 0, 1, 0.1), 0);
+    assert_true(tag_size_get(&ts, 0, 2, DEFAULT_SIZE) == DEFAULT_SIZE);
+    assert_true(tag_size_get(&ts, 1, 1, DEFAULT_SIZE) == DEFAULT_SIZE);
+    assert_true(tag_size_get(&ts, 0, -1, DEFAULT_SIZE) == DEFAULT_SIZE);
+
+    tag_size_destroy(&ts);
+}
+
+void when_given_out_of_range_keys_tag_size_set_returns_error()
+{
+    t_tag_size_table ts = TAG_SIZE_TABLE_INITIALIZER;
+
+    assert_int_equal(tag_size_set(&ts, -1, 0, 0.1), -1);
+    assert_int_equal(tag_size_set(&ts, TAG_SIZE_ANY_FAMILY + 1, 0, 0.1), -1);
+    assert_int_equal(tag_size_set(&ts, 0, -1, 0.1), -1);
+    assert_int_equal(tag_size_set(&ts, 0, TAG_SIZE_MAX_ID + 1, 0.1), -1);
+    assert_int_equal(ts.len, 0);
+
+    // largest keys are valid
+    assert_int_equal(tag_size_set(&ts, TAG_SIZE_ANY_FAMILY, TAG_SIZE_MAX_ID, 0.1), 0);
+    assert_true(tag_size_get(&ts, 0, TAG_SIZE_MAX_ID, DEFAULT_SIZE) == 0.1);
+
+    tag_size_destroy(&ts);
+}
+
+void when_many_sizes_are_set_tag_size_table_grows_and_keeps_them()
+{
+    t_tag_size_table ts = TAG_SIZE_TABLE_INITIALIZER;
+
+    // more ids than tagStandard41h12 has, in two families
+    for (int id = 0; id < 3000; id++) {
+        assert_int_equal(tag_size_set(&ts, 0, id, id * 0.001), 0);
+        assert_int_equal(tag_size_set(&ts, 4, id, id * 0.002), 0);
+    }
+    assert_int_equal(ts.len, 6000);
+    assert_true(ts.len * 4 <= ts.nslots * 3);
+    assert_int_equal(ts.nslots & (ts.nslots - 1), 0);
+
+    for (int id = 0; id < 3000; id++) {
+        assert_true(tag_size_get(&ts, 0, id, DEFAULT_SIZE) == id * 0.001);
+        assert_true(tag_size_get(&ts, 4, id, DEFAULT_SIZE) == id * 0.002);
+        assert_true(tag_size_get(&ts, 1, id, DEFAULT_SIZE) == DEFAULT_SIZE);
+    }
+
+    tag_size_destroy(&ts);
+}
+
+void when_called_tag_size_copy_copies_the_table()
+{
+    t_tag_size_table src = TAG_SIZE_TABLE_INITIALIZER;
+    t_tag_size_table dest = TAG_SIZE_TABLE_INITIALIZER;
+
+    // copy of an empty table
+    assert_int_equal(tag_size_copy(&dest, &src), 0);
+    assert_int_equal(dest.len, 0);
+
+    for (int id = 0; id < 100; id++) assert_int_equal(tag_size_set(&src, 1, id, id * 0.01), 0);
+    assert_int_equal(tag_size_copy(&dest, &src), 0);
+    assert_int_equal(dest.len, src.len);
+    assert_ptr_not_equal(dest.keys, src.keys);
+
+    // copying again reuses the memory of the destination
+    uint32_t *keys = dest.keys;
+    assert_int_equal(tag_size_set(&src, 1, 0, 1.0), 0);
+    assert_int_equal(tag_size_copy(&dest, &src), 0);
+    assert_ptr_equal(dest.keys, keys);
+    assert_true(tag_size_get(&dest, 1, 0, DEFAULT_SIZE) == 1.0);
+    for (int id = 1; id < 100; id++) assert_true(tag_size_get(&dest, 1, id, DEFAULT_SIZE) == id * 0.01);
+
+    // the copy is independent of the source
+    tag_size_destroy(&src);
+    assert_true(tag_size_get(&dest, 1, 50, DEFAULT_SIZE) == 0.5);
+
+    tag_size_destroy(&dest);
+}
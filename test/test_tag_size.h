@@ -0,0 +1,10 @@
+#ifndef TEST_TAG_SIZE_H
+#define TEST_TAG_SIZE_H
+
+void when_size_was_set_tag_size_get_returns_it();
+void when_size_was_not_set_for_the_family_tag_size_get_returns_the_any_family_size();
+void when_size_was_not_set_tag_size_get_returns_the_default();
+void when_given_out_of_range_keys_tag_size_set_returns_error();
+void when_many_sizes_are_set_tag_size_table_grows_and_keeps_them();
+void when_called_tag_size_copy_copies_the_table();
+#endif